@@ -6,9 +6,177 @@
 #include <iostream>
 #include <sstream>
 #include <regex>
+#include <unordered_map>
+#include <map>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace csv
 {
+  REGISTER_ENUM(Aggregation,
+                ([]()
+                 { return std::vector<std::pair<std::string, unsigned>>{
+                       {"None", (unsigned)Aggregation::None},
+                       {"Mean", (unsigned)Aggregation::Mean},
+                       {"Min", (unsigned)Aggregation::Min},
+                       {"Max", (unsigned)Aggregation::Max},
+                       {"Median", (unsigned)Aggregation::Median},
+                       {"StdDev", (unsigned)Aggregation::StdDev},
+                       {"Count", (unsigned)Aggregation::Count},
+                   }; })());
+
+  void Bitmap::resize(int _size, bool value)
+  {
+    bit_count = _size;
+    words.assign((bit_count + 63) / 64, value ? ~uint64_t(0) : uint64_t(0));
+    if (value && (bit_count & 63))
+      words.back() = (uint64_t(1) << (bit_count & 63)) - 1;
+  }
+
+  int Bitmap::count() const
+  {
+    int cnt = 0;
+    for (uint64_t w : words)
+      cnt += __builtin_popcountll(w);
+    return cnt;
+  }
+
+  std::vector<int> Bitmap::toIndices() const
+  {
+    std::vector<int> indices;
+    indices.reserve(count());
+    for (int w_id = 0; w_id < words.size(); w_id++)
+    {
+      uint64_t w = words[w_id];
+      while (w)
+      {
+        indices.push_back(64 * w_id + __builtin_ctzll(w));
+        w &= w - 1;
+      }
+    }
+    return indices;
+  }
+
+  // plain word loops, the compiler vectorizes them
+  Bitmap &Bitmap::operator&=(const Bitmap &rhs)
+  {
+    assert(words.size() == rhs.words.size());
+    for (int i = 0; i < words.size(); i++)
+      words[i] &= rhs.words[i];
+    return *this;
+  }
+
+  Bitmap &Bitmap::operator|=(const Bitmap &rhs)
+  {
+    assert(words.size() == rhs.words.size());
+    for (int i = 0; i < words.size(); i++)
+      words[i] |= rhs.words[i];
+    return *this;
+  }
+
+  Bitmap &Bitmap::andNot(const Bitmap &rhs)
+  {
+    assert(words.size() == rhs.words.size());
+    for (int i = 0; i < words.size(); i++)
+      words[i] &= ~rhs.words[i];
+    return *this;
+  }
+
+  void Table::encode(int first_row)
+  {
+    if (first_row <= 0 || encoded.size() != columns.size())
+    {
+      first_row = 0;
+      encoded.clear();
+      encoded.resize(columns.size());
+    }
+    for (int col = 0; col < columns.size(); col++)
+    {
+      EncodedColumn &enc = encoded[col];
+      std::unordered_map<std::string, uint32_t> value_to_code;
+      for (uint32_t code = 0; code < enc.dictionary.size(); code++)
+        value_to_code.emplace(enc.dictionary[code], code);
+      int first_code = enc.dictionary.size();
+
+      enc.codes.resize(columns[col].size());
+      for (int row = first_row; row < columns[col].size(); row++)
+      {
+        auto it = value_to_code.find(columns[col][row]);
+        if (it == value_to_code.end())
+        {
+          it = value_to_code.emplace(columns[col][row], enc.dictionary.size()).first;
+          enc.dictionary.push_back(columns[col][row]);
+        }
+        enc.codes[row] = it->second;
+      }
+
+      // every distinct value is parsed only once
+      enc.dictionary_numbers.resize(enc.dictionary.size());
+      for (int i = first_code; i < enc.dictionary.size(); i++)
+      {
+        const char *str = enc.dictionary[i].c_str();
+        char *end_c = nullptr;
+        double value = strtod(str, &end_c);
+        enc.dictionary_numbers[i] = (end_c == str) ? NAN : value;
+      }
+
+      enc.owned_numbers.resize(enc.codes.size());
+      for (int row = first_row; row < enc.codes.size(); row++)
+        enc.owned_numbers[row] = enc.dictionary_numbers[enc.codes[row]];
+      enc.has_dictionary = true;
+    }
+  }
+
+  // dictionary of a numeric column is built from distinct values, only they are converted to strings
+  // text of numbers in dictionaries built from numeric columns
+  static std::string format_number(double value)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.15g", value);
+    return buf;
+  }
+
+  static void build_number_dictionary(const Table::EncodedColumn &enc, int row_count)
+  {
+    const double *numbers = enc.numbers();
+    std::unordered_map<uint64_t, uint32_t> value_to_code;
+    enc.codes.resize(row_count);
+    for (int row = 0; row < row_count; row++)
+    {
+      uint64_t bits;
+      memcpy(&bits, &numbers[row], sizeof(bits));
+      auto it = value_to_code.find(bits);
+      if (it == value_to_code.end())
+      {
+        it = value_to_code.emplace(bits, enc.dictionary_numbers.size()).first;
+        enc.dictionary_numbers.push_back(numbers[row]);
+      }
+      enc.codes[row] = it->second;
+    }
+
+    enc.dictionary.resize(enc.dictionary_numbers.size());
+    for (int i = 0; i < enc.dictionary_numbers.size(); i++)
+      enc.dictionary[i] = format_number(enc.dictionary_numbers[i]);
+    enc.has_dictionary = true;
+  }
+
+  const Table::EncodedColumn &Table::coded(int col) const
+  {
+    const EncodedColumn &enc = encoded[col];
+    if (!enc.has_dictionary)
+      build_number_dictionary(enc, row_count);
+    return enc;
+  }
+
   void save_csv(const std::string &filename, const Table &data, bool in_quotes)
   {
     std::ofstream fs(filename);
@@ -30,9 +198,9 @@ namespace csv
         if (j > 0)
           fs << ",";
         if (in_quotes)
-          fs << "\"" << data.columns[j][i] << "\"";
+          fs << "\"" << data.value(j, i) << "\"";
         else
-          fs << data.columns[j][i];
+          fs << data.value(j, i);
       }
       fs << "\n";
     }
@@ -41,12 +209,9 @@ namespace csv
     fs.close();
   }
 
-  std::shared_ptr<Table> load_csv(const std::string &filename)
+  // parses one line of csv file into data, the first parsed line is the header
+  static void parse_csv_line(std::string &line, Table &data)
   {
-    std::shared_ptr<Table> data = std::make_shared<Table>();
-
-    std::ifstream fs(filename);
-    std::string line;
     std::string default_str = "NaN";
 
     constexpr int STATE_BASE = 0;
@@ -56,80 +221,502 @@ namespace csv
     
     char buf[8192];
 
-    int expected_columns_count = -1;
-    while (std::getline(fs, line))
+    line += ",";
+    int col = 0;
+    int n = 0;
+    int p = 0;
+    int state = STATE_SPACE;
+    for (int i = 0; i < line.size(); i++)
     {
-      line += ",";
-      int col = 0;
-      int n = 0;
-      int p = 0;
-      int state = STATE_SPACE;
-      for (int i = 0; i < line.size(); i++)
+      if (col == data.columns.size())
+        data.columns.push_back(std::vector<std::string>());
+      if (state == STATE_SPACE || state == STATE_BASE || state == STATE_QQ)
       {
-        if (col == data->columns.size())
-          data->columns.push_back(std::vector<std::string>());
-        if (state == STATE_SPACE || state == STATE_BASE || state == STATE_QQ)
+        if (state == STATE_SPACE)
         {
-          if (state == STATE_SPACE)
-          {
-            if (line[i] == ' ')
-              continue;
-            else
-              state = STATE_BASE;
-          }
-          
-          if (line[i] == ',')
-          {
-            state = STATE_SPACE;
-            buf[p] = 0;
-            data->columns[col].push_back(std::string(buf));
-            col++;
-            p = 0;
-          }
-          else if (line[i] == '"')
-          {
-            state = STATE_QUOTE;
-            if (state == STATE_QQ)
-              buf[p++] = line[i];
-          }
-          else 
-          {
-            buf[p++] = line[i];
-          }
+          if (line[i] == ' ')
+            continue;
+          else
+            state = STATE_BASE;
         }
-        else if (state == STATE_QUOTE)
+        
+        if (line[i] == ',')
         {
-          if (line[i] == '"')
-          {
-            state = STATE_QQ;
-          }
-          else
-          {
+          state = STATE_SPACE;
+          buf[p] = 0;
+          data.columns[col].push_back(std::string(buf));
+          col++;
+          p = 0;
+        }
+        else if (line[i] == '"')
+        {
+          state = STATE_QUOTE;
+          if (state == STATE_QQ)
             buf[p++] = line[i];
-          }
         }
+        else 
+        {
+          buf[p++] = line[i];
+        }
+      }
+      else if (state == STATE_QUOTE)
+      {
+        if (line[i] == '"')
+        {
+          state = STATE_QQ;
+        }
+        else
+        {
+          buf[p++] = line[i];
+        }
+      }
+    }
+
+    if (data.header.empty())
+    {
+      int expected_columns_count = col;
+      for (int i=0;i<expected_columns_count;i++)
+      {
+        data.header.push_back(data.columns[i][0]);
+        data.columns[i].erase(data.columns[i].begin());
+      }
+    }
+    else
+    {
+      for (int i = col; i < data.header.size(); i++)
+      {
+        data.columns[i].push_back(default_str);
+      }
+    }
+  }
+
+  // parses lines starting from the given byte offset, returns offset after the last parsed line
+  static uint64_t read_csv_lines(const std::string &filename, uint64_t offset, Table &data,
+                                 bool *ends_with_newline = nullptr)
+  {
+    std::ifstream fs(filename, std::ios::binary);
+    fs.seekg(offset);
+    std::string line;
+    bool newline = true;
+    while (std::getline(fs, line))
+    {
+      newline = !fs.eof();
+      offset += line.size() + (newline ? 1 : 0);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      parse_csv_line(line, data);
+    }
+    if (ends_with_newline)
+      *ends_with_newline = newline;
+    return offset;
+  }
+
+  std::shared_ptr<Table> load_csv(const std::string &filename)
+  {
+    std::shared_ptr<Table> data = std::make_shared<Table>();
+    read_csv_lines(filename, 0, *data);
+    data->row_count = data->columns.empty() ? 0 : data->columns[0].size();
+    data->encode();
+
+    return data;
+  }
+
+  // FNV-1a hash of the first and the last (up to 4 KB each) of parsed_size bytes of the file.
+  // Appended rows are parsed only if it is unchanged, otherwise the file was rewritten
+  static uint64_t hash_parsed_bytes(const std::string &filename, uint64_t parsed_size)
+  {
+    constexpr uint64_t HASHED_BYTES = 4096;
+    uint64_t head = std::min(parsed_size, HASHED_BYTES);
+    uint64_t tail = std::min(parsed_size - head, HASHED_BYTES);
+    std::vector<char> bytes(head + tail);
+    std::ifstream fs(filename, std::ios::binary);
+    fs.read(bytes.data(), head);
+    fs.seekg(parsed_size - tail);
+    fs.read(bytes.data() + head, tail);
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : bytes)
+      hash = (hash ^ uint8_t(c)) * 1099511628211ull;
+    return hash;
+  }
+
+  struct CachedTable
+  {
+    std::filesystem::file_time_type mtime;
+    uintmax_t size = 0;            // bytes parsed
+    bool ends_with_newline = true; // new rows can be appended only after a complete line
+    uint64_t parsed_hash = 0;      // hash_parsed_bytes of the parsed part
+    std::shared_ptr<const Table> table;
+  };
+
+  static std::map<std::string, CachedTable> &csv_cache()
+  {
+    static std::map<std::string, CachedTable> cache;
+    return cache;
+  }
+
+  static uint64_t next_table_lineage()
+  {
+    static uint64_t lineage = 0;
+    return ++lineage;
+  }
+
+  std::shared_ptr<const Table> load_csv_cached(const std::string &filename)
+  {
+    std::error_code ec;
+    std::string key = std::filesystem::weakly_canonical(filename, ec).string();
+    if (ec)
+      key = filename;
+    auto mtime = std::filesystem::last_write_time(filename, ec);
+    if (ec)
+      return load_csv(filename);
+    uintmax_t size = std::filesystem::file_size(filename, ec);
+
+    auto &cache = csv_cache();
+    auto it = cache.find(key);
+    if (it != cache.end() && it->second.mtime == mtime && it->second.size == size)
+      return it->second.table;
+
+    std::shared_ptr<Table> table;
+    CachedTable &entry = cache[key];
+    if (is_columnar_file(filename))
+    {
+      // columnar files are always reloaded as a whole
+      table = load_columnar(filename);
+      entry.size = size;
+      entry.ends_with_newline = false;
+      if (!table)
+      {
+        cache.erase(key);
+        return nullptr;
       }
+      table->lineage = next_table_lineage();
+    }
+    else if (it != cache.end() && entry.table && entry.ends_with_newline && size > entry.size &&
+             hash_parsed_bytes(filename, entry.size) == entry.parsed_hash)
+    {
+      // file has grown, only appended rows are parsed. Tables handed out before are shared
+      // and stay as they are, new rows go to a copy that replaces the cached table
+      table = std::make_shared<Table>(*entry.table);
+      int old_row_count = table->row_count;
+      entry.size = read_csv_lines(filename, entry.size, *table, &entry.ends_with_newline);
+      table->row_count = table->columns.empty() ? 0 : table->columns[0].size();
+      table->encode(old_row_count);
+    }
+    else
+    {
+      table = std::make_shared<Table>();
+      entry.size = read_csv_lines(filename, 0, *table, &entry.ends_with_newline);
+      table->row_count = table->columns.empty() ? 0 : table->columns[0].size();
+      table->encode();
+      table->lineage = next_table_lineage();
+    }
+    entry.mtime = mtime;
+    entry.parsed_hash = hash_parsed_bytes(filename, entry.size);
+    entry.table = table;
+    return entry.table;
+  }
 
-      if (expected_columns_count == -1)
+  // read-only view of the whole file, memory-mapped where possible
+  class MappedFile
+  {
+  public:
+    MappedFile(const std::string &filename)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+        return;
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
       {
-        expected_columns_count = col;
-        for (int i=0;i<expected_columns_count;i++)
+        void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
         {
-          data->header.push_back(data->columns[i][0]);
-          data->columns[i].erase(data->columns[i].begin());
+          mapped = (const char *)ptr;
+          bytes = st.st_size;
         }
       }
+      close(fd);
+#else
+      std::ifstream fs(filename, std::ios::binary);
+      buffer.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+      mapped = buffer.data();
+      bytes = buffer.size();
+#endif
+    }
+    ~MappedFile()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      if (mapped)
+        munmap((void *)mapped, bytes);
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return mapped; }
+    size_t size() const { return bytes; }
+
+  private:
+    const char *mapped = nullptr;
+    size_t bytes = 0;
+    std::vector<char> buffer;
+  };
+
+  static constexpr char COLUMNAR_MAGIC[8] = {'L', 'F', 'C', 'O', 'L', '0', '1', '\0'};
+
+  // bounds-checked sequential reader over mapped file
+  struct ByteReader
+  {
+    const char *data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+
+    template <typename T>
+    T get()
+    {
+      T value = T();
+      if (pos + sizeof(T) > size)
+        ok = false;
       else
+        memcpy(&value, data + pos, sizeof(T));
+      pos += sizeof(T);
+      return value;
+    }
+    std::string get_string(uint32_t length)
+    {
+      if (pos + length > size)
       {
-        for (int i = col; i < expected_columns_count; i++)
+        ok = false;
+        return "";
+      }
+      std::string str(data + pos, length);
+      pos += length;
+      return str;
+    }
+  };
+
+  bool is_columnar_file(const std::string &filename)
+  {
+    char magic[sizeof(COLUMNAR_MAGIC)] = {};
+    std::ifstream fs(filename, std::ios::binary);
+    fs.read(magic, sizeof(magic));
+    return fs.gcount() == sizeof(magic) && memcmp(magic, COLUMNAR_MAGIC, sizeof(magic)) == 0;
+  }
+
+  // Float64 values are used in place if they are aligned, other types are converted to double
+  template <typename T>
+  static void numeric_column_to_encoded(const char *src, int row_count, Table::EncodedColumn &enc)
+  {
+    if (std::is_same<T, double>::value && reinterpret_cast<uintptr_t>(src) % alignof(double) == 0)
+    {
+      enc.mapped_numbers = reinterpret_cast<const double *>(src);
+      return;
+    }
+    enc.owned_numbers.resize(row_count);
+    for (int row = 0; row < row_count; row++)
+    {
+      T value;
+      memcpy(&value, src + row * sizeof(T), sizeof(T));
+      enc.owned_numbers[row] = value;
+    }
+  }
+
+  static bool string_column_to_encoded(ByteReader reader, int row_count, Table::EncodedColumn &enc)
+  {
+    uint32_t dictionary_size = reader.get<uint32_t>();
+    if (!reader.ok || dictionary_size > reader.size)
+      return false;
+    enc.dictionary.resize(dictionary_size);
+    enc.dictionary_numbers.resize(dictionary_size);
+    for (int i = 0; i < dictionary_size && reader.ok; i++)
+    {
+      enc.dictionary[i] = reader.get_string(reader.get<uint32_t>());
+      const char *str = enc.dictionary[i].c_str();
+      char *end_c = nullptr;
+      double value = strtod(str, &end_c);
+      enc.dictionary_numbers[i] = (end_c == str) ? NAN : value;
+    }
+
+    enc.codes.resize(row_count);
+    enc.owned_numbers.resize(row_count);
+    for (int row = 0; row < row_count && reader.ok; row++)
+    {
+      uint32_t code = reader.get<uint32_t>();
+      if (code >= dictionary_size)
+        return false;
+      enc.codes[row] = code;
+      enc.owned_numbers[row] = enc.dictionary_numbers[code];
+    }
+    enc.has_dictionary = true;
+    return reader.ok;
+  }
+
+  std::shared_ptr<Table> load_columnar(const std::string &filename)
+  {
+    std::shared_ptr<const MappedFile> mapped_file = std::make_shared<MappedFile>(filename);
+    const MappedFile &file = *mapped_file;
+    if (!file.data() || file.size() < sizeof(COLUMNAR_MAGIC) || 
+        memcmp(file.data(), COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0)
+    {
+      fprintf(stderr, "unable to read columnar file \"%s\"\n", filename.c_str());
+      return nullptr;
+    }
+
+    ByteReader reader{file.data(), file.size(), sizeof(COLUMNAR_MAGIC)};
+    uint32_t column_count = reader.get<uint32_t>();
+    reader.get<uint32_t>(); // reserved
+    uint64_t row_count = reader.get<uint64_t>();
+    if (!reader.ok || row_count > file.size())
+    {
+      fprintf(stderr, "columnar file \"%s\" has invalid header\n", filename.c_str());
+      return nullptr;
+    }
+
+    std::shared_ptr<Table> data = std::make_shared<Table>();
+    data->row_count = row_count;
+    data->columns.resize(column_count); // strings are kept only in dictionaries
+    data->encoded.resize(column_count);
+    for (int col = 0; col < column_count; col++)
+    {
+      ColumnType type = (ColumnType)reader.get<uint32_t>();
+      uint32_t name_length = reader.get<uint32_t>();
+      uint64_t data_offset = reader.get<uint64_t>();
+      uint64_t data_size = reader.get<uint64_t>();
+      data->header.push_back(reader.get_string(name_length));
+      if (!reader.ok || data_offset > file.size() || data_size > file.size() - data_offset)
+      {
+        fprintf(stderr, "columnar file \"%s\" has invalid column %d\n", filename.c_str(), col);
+        return nullptr;
+      }
+
+      const char *column_data = file.data() + data_offset;
+      Table::EncodedColumn &enc = data->encoded[col];
+      size_t value_size = 0;
+      switch (type)
+      {
+      case ColumnType::Float64: value_size = sizeof(double); break;
+      case ColumnType::Float32: value_size = sizeof(float); break;
+      case ColumnType::Int64:   value_size = sizeof(int64_t); break;
+      case ColumnType::Int32:   value_size = sizeof(int32_t); break;
+      default: break;
+      }
+      if (value_size > 0 && data_size < value_size * row_count)
+      {
+        fprintf(stderr, "columnar file \"%s\", column \"%s\" is too short\n", filename.c_str(), data->header.back().c_str());
+        return nullptr;
+      }
+
+      bool column_ok = true;
+      switch (type)
+      {
+      case ColumnType::Float64: numeric_column_to_encoded<double>(column_data, row_count, enc); break;
+      case ColumnType::Float32: numeric_column_to_encoded<float>(column_data, row_count, enc); break;
+      case ColumnType::Int64:   numeric_column_to_encoded<int64_t>(column_data, row_count, enc); break;
+      case ColumnType::Int32:   numeric_column_to_encoded<int32_t>(column_data, row_count, enc); break;
+      case ColumnType::String:
+        column_ok = string_column_to_encoded(ByteReader{column_data, data_size}, row_count, enc);
+        break;
+      default:
+        column_ok = false;
+        break;
+      }
+      if (!column_ok)
+      {
+        fprintf(stderr, "columnar file \"%s\", column \"%s\" is invalid\n", filename.c_str(), data->header.back().c_str());
+        return nullptr;
+      }
+      if (enc.mapped_numbers)
+        data->mapped_file = mapped_file;
+    }
+
+    return data;
+  }
+
+  template <typename T>
+  static void put(std::string &out, T value)
+  {
+    out.append((const char *)&value, sizeof(T));
+  }
+
+  bool save_columnar(const std::string &filename, const Table &data)
+  {
+    if (!data.is_encoded())
+    {
+      fprintf(stderr, "unable to save table to \"%s\", table is not encoded\n", filename.c_str());
+      return false;
+    }
+
+    std::vector<std::string> column_data(data.columns.size());
+    std::vector<ColumnType> types(data.columns.size());
+    for (int col = 0; col < data.columns.size(); col++)
+    {
+      // numbers are loaded with text from format_number, a column is saved as Float64 only if this
+      // text is the same as the original one. Values like "1.50" or "1e3" keep their column a String
+      // column, so filters and printed values see the same text as in the csv file
+      const Table::EncodedColumn &enc = data.coded(col);
+      bool numeric = true;
+      for (int i = 0; i < enc.dictionary.size() && numeric; i++)
+        numeric = !std::isnan(enc.dictionary_numbers[i]) && format_number(enc.dictionary_numbers[i]) == enc.dictionary[i];
+      types[col] = numeric ? ColumnType::Float64 : ColumnType::String;
+      if (numeric)
+      {
+        column_data[col].append((const char *)enc.numbers(), data.row_count * sizeof(double));
+      }
+      else
+      {
+        put<uint32_t>(column_data[col], enc.dictionary.size());
+        for (const auto &str : enc.dictionary)
         {
-          data->columns[i].push_back(default_str);
+          put<uint32_t>(column_data[col], str.size());
+          column_data[col] += str;
         }
+        column_data[col].append((const char *)enc.codes.data(), enc.codes.size() * sizeof(uint32_t));
       }
     }
-    data->row_count = data->columns[0].size();
 
-    return data;
+    std::string header(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+    put<uint32_t>(header, data.columns.size());
+    put<uint32_t>(header, 0);
+    put<uint64_t>(header, data.row_count);
+    uint64_t header_size = header.size();
+    for (int col = 0; col < data.columns.size(); col++)
+      header_size += 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + data.header[col].size();
+
+    // column data is 8-byte aligned
+    uint64_t offset = (header_size + 7) & ~uint64_t(7);
+    std::vector<uint64_t> offsets(data.columns.size());
+    for (int col = 0; col < data.columns.size(); col++)
+    {
+      offsets[col] = offset;
+      put<uint32_t>(header, (uint32_t)types[col]);
+      put<uint32_t>(header, data.header[col].size());
+      put<uint64_t>(header, offset);
+      put<uint64_t>(header, column_data[col].size());
+      header += data.header[col];
+      offset = (offset + column_data[col].size() + 7) & ~uint64_t(7);
+    }
+
+    std::ofstream fs(filename, std::ios::binary);
+    if (!fs)
+    {
+      fprintf(stderr, "unable to open file \"%s\" for writing\n", filename.c_str());
+      return false;
+    }
+    header.resize(offsets.empty() ? header.size() : offsets[0], '\0');
+    fs.write(header.data(), header.size());
+    for (int col = 0; col < data.columns.size(); col++)
+    {
+      column_data[col].resize((column_data[col].size() + 7) & ~size_t(7), '\0');
+      fs.write(column_data[col].data(), column_data[col].size());
+    }
+    return fs.good();
+  }
+
+  void clear_csv_cache()
+  {
+    csv_cache().clear();
   }
 
   void print_csv(const Table &data, int max_rows)
@@ -148,7 +735,7 @@ namespace csv
     {
       for (int j = 0; j < data.columns.size(); j++)
       {
-        printf("%s ", data.columns[j][i].c_str());
+        printf("%s ", data.value(j, i).c_str());
       }
       printf("\n");
     }
@@ -156,10 +743,42 @@ namespace csv
 
   int Slice::getRowCount() const
   {
-    int count = 0;
-    for (int i = 0; i < row_mask.size(); i++)
-      count += row_mask[i];
-    return count;
+    return row_mask.count();
+  }
+
+  static std::shared_ptr<const Table> encoded_table(const std::shared_ptr<Table> &table)
+  {
+    if (table && !table->is_encoded())
+      table->encode();
+    return table;
+  }
+
+  Slice::Slice(std::shared_ptr<const Table> _data) : data(_data)
+  {
+    if (!data)
+      return;
+    assert(data->is_encoded());
+    row_mask.resize(data->row_count, true);
+  }
+
+  Slice::Slice(std::shared_ptr<const Table> _data, int first_row) : data(_data)
+  {
+    if (!data)
+      return;
+    assert(data->is_encoded());
+    row_mask.resize(data->row_count, true);
+    // rows before first_row are cleared a word at a time
+    int cleared = std::min(std::max(first_row, 0), data->row_count);
+    std::fill(row_mask.words.begin(), row_mask.words.begin() + cleared / 64, uint64_t(0));
+    for (int row = cleared & ~63; row < cleared; row++)
+      row_mask.set(row, false);
+  }
+
+  Slice::Slice(const std::shared_ptr<Table> &_data) : Slice(encoded_table(_data)) {}
+
+  std::vector<int> Slice::getRowIndices() const
+  {
+    return row_mask.toIndices();
   }
 
   std::shared_ptr<Table> Slice::toTable() const
@@ -167,56 +786,80 @@ namespace csv
     if (!data)
       return nullptr;
 
+    std::vector<int> rows = getRowIndices();
     std::shared_ptr<Table> new_table = std::make_shared<Table>();
-    new_table->columns.resize(data->columns.size(), std::vector<std::string>(getRowCount()));
+    new_table->columns.resize(data->columns.size(), std::vector<std::string>(rows.size()));
     new_table->header = data->header;
-    new_table->row_count = getRowCount();
+    new_table->row_count = rows.size();
 
     for (int i = 0; i < data->columns.size(); i++)
     {
-      int idx = 0;
-      for (int j = 0; j < data->row_count; j++)
-      {
-        if (row_mask[j])
-          new_table->columns[i][idx++] = data->columns[i][j];
-      }
+      for (int j = 0; j < rows.size(); j++)
+        new_table->columns[i][j] = data->value(i, rows[j]);
     }
+    new_table->encode();
     return new_table;
   }
 
+  Bitmap Filter::match_codes(const Table::EncodedColumn &column, const std::vector<uint8_t> &code_matches,
+                             const Bitmap &active_rows)
+  {
+    Bitmap matched(active_rows.size(), false);
+    for (int w_id = 0; w_id < active_rows.words.size(); w_id++)
+    {
+      if (active_rows.words[w_id] == 0)
+        continue;
+      int row_0 = 64 * w_id;
+      int rows = std::min(64, active_rows.size() - row_0);
+      uint64_t w = 0;
+      for (int bit = 0; bit < rows; bit++)
+        w |= uint64_t(code_matches[column.codes[row_0 + bit]]) << bit;
+      matched.words[w_id] = w;
+    }
+    return matched;
+  }
+
+  void Filter::apply_match(Slice &slice, const Bitmap &matched, bool exclude)
+  {
+    if (exclude)
+      slice.row_mask.andNot(matched);
+    else
+      slice.row_mask &= matched;
+  }
+
   void FilterExactMatch::filter(Slice &slice) const
   {
     int col_id = slice.data->get_column_idx(column_name);
     if (col_id == -1)
       return;
-    for (int row = 0; row < slice.data->row_count; row++)
+    const Table::EncodedColumn &column = slice.data->coded(col_id);
+
+    std::vector<uint8_t> code_matches(column.dictionary.size(), 0);
+    for (int code = 0; code < column.dictionary.size(); code++)
     {
-      if (!slice.row_mask[row])
-        continue;
-      slice.row_mask[row] = exclude;
       for (int i = 0; i < values.size(); i++)
       {
-        if (slice.data->columns[col_id][row] == values[i])
+        if (column.dictionary[code] == values[i])
         {
-          slice.row_mask[row] = !exclude;
+          code_matches[code] = 1;
           break;
         }
       }
     }
+    apply_match(slice, match_codes(column, code_matches, slice.row_mask), exclude);
   }
 
   void FilterRegexMatch::filter(Slice &slice) const
   {
     int col_id = slice.data->get_column_idx(column_name);
-    std::regex RX(regex);
     if (col_id == -1)
       return;
-    for (int row = 0; row < slice.data->row_count; row++)
-    {
-      if (!slice.row_mask[row])
-        continue;
-      slice.row_mask[row] = std::regex_match(slice.data->columns[col_id][row], RX) ? !exclude : exclude;
-    }
+    const Table::EncodedColumn &column = slice.data->coded(col_id);
+
+    std::vector<uint8_t> code_matches(column.dictionary.size(), 0);
+    for (int code = 0; code < column.dictionary.size(); code++)
+      code_matches[code] = std::regex_match(column.dictionary[code], compiled_regex);
+    apply_match(slice, match_codes(column, code_matches, slice.row_mask), exclude);
   }
 
   void FilterRangeMatch::filter(Slice &slice) const
@@ -224,15 +867,16 @@ namespace csv
     int col_id = slice.data->get_column_idx(column_name);
     if (col_id == -1)
       return;
-    for (int row = 0; row < slice.data->row_count; row++)
+    const Table::EncodedColumn &column = slice.data->coded(col_id);
+
+    // NaN (not a number) never falls into the range
+    std::vector<uint8_t> code_matches(column.dictionary.size(), 0);
+    for (int code = 0; code < column.dictionary.size(); code++)
     {
-      if (!slice.row_mask[row])
-        continue;
-      slice.row_mask[row] = exclude;
-      double val = std::stod(slice.data->columns[col_id][row]);
-      if (val >= min && val <= max)
-        slice.row_mask[row] = !exclude;
+      double val = column.dictionary_numbers[code];
+      code_matches[code] = val >= min && val <= max;
     }
+    apply_match(slice, match_codes(column, code_matches, slice.row_mask), exclude);
   }
 
   std::shared_ptr<Filter> load_filter(const Block *blk)
@@ -267,7 +911,7 @@ namespace csv
     return nullptr;
   }
 
-  Slice load_csv_slice(const Block *blk)
+  Slice load_csv_slice(const Block *blk, int first_row)
   {
     std::string path = blk->get_string("path", "");
     if (path == "")
@@ -281,10 +925,11 @@ namespace csv
       return {};
     }
 
-    Slice slice = load_csv(path);
+    // plots over the same file share one parsed table, filters only build row masks
+    Slice slice(load_csv_cached(path), first_row);
     if (slice.data == nullptr || slice.data->row_count == 0 || slice.data->columns.size() == 0)
     {
-      fprintf(stderr, "unable to read datafrom csv file \"%s\"\n", path.c_str());
+      fprintf(stderr, "unable to read data from file \"%s\"\n", path.c_str());
       return {};
     }
     
@@ -305,6 +950,156 @@ namespace csv
     return slice;
   }
 
+  struct PointAccumulator
+  {
+    int series = 0;
+    int first_row = 0;
+    int count = 0;
+    int x_count = 0;
+    double x_sum = 0;
+    int y_count = 0;
+    double y_mean = 0; // running mean and sum of squared differences (Welford)
+    double y_m2 = 0;
+    double y_min = INFINITY;
+    double y_max = -INFINITY;
+    std::vector<double> y_values; // only for median
+
+    void add(double x, double y, bool keep_values)
+    {
+      count++;
+      if (!std::isnan(x))
+      {
+        x_count++;
+        x_sum += x;
+      }
+      if (std::isnan(y))
+        return;
+      y_count++;
+      double delta = y - y_mean;
+      y_mean += delta / y_count;
+      y_m2 += delta * (y - y_mean);
+      y_min = std::min(y_min, y);
+      y_max = std::max(y_max, y);
+      if (keep_values)
+        y_values.push_back(y);
+    }
+
+    double result(Aggregation aggregation)
+    {
+      if (aggregation == Aggregation::Count)
+        return count;
+      if (y_count == 0)
+        return NAN;
+      switch (aggregation)
+      {
+      case Aggregation::Min:
+        return y_min;
+      case Aggregation::Max:
+        return y_max;
+      case Aggregation::StdDev:
+        return std::sqrt(y_m2 / y_count);
+      case Aggregation::Median:
+      {
+        int mid = y_values.size() / 2;
+        std::nth_element(y_values.begin(), y_values.begin() + mid, y_values.end());
+        double median = y_values[mid];
+        if (y_values.size() % 2 == 0)
+          median = 0.5 * (median + *std::max_element(y_values.begin(), y_values.begin() + mid));
+        return median;
+      }
+      default:
+        return y_mean;
+      }
+    }
+  };
+
+  std::vector<GroupedSeries> group_and_aggregate(const Table &table, const std::vector<int> &rows,
+                                                 int group_col, int key_col, int x_col, int y_col,
+                                                 Aggregation aggregation)
+  {
+    assert(table.is_encoded());
+    assert(x_col >= 0 && y_col >= 0);
+    const Table::EncodedColumn *group_column = group_col >= 0 ? &table.coded(group_col) : nullptr;
+    // points are merged by codes of the key column, it is coded only if they are merged
+    const Table::EncodedColumn *key_column = aggregation == Aggregation::None ? nullptr :
+                                             key_col >= 0 ? &table.coded(key_col) : &table.coded(x_col);
+    const double *x_numbers = table.encoded[x_col].numbers();
+    const double *y_numbers = table.encoded[y_col].numbers();
+
+    // dictionary codes are dense, so they index series directly
+    std::vector<int> series_by_code(group_column ? group_column->dictionary.size() : 1, -1);
+    std::vector<uint32_t> series_codes;
+    std::vector<GroupedSeries> series;
+    std::vector<std::vector<int>> series_points; // indices in accumulators
+    std::vector<PointAccumulator> accumulators;
+    std::unordered_map<uint64_t, int> point_by_key; // (group code, key code) -> accumulator
+    bool keep_values = aggregation == Aggregation::Median;
+
+    for (int row : rows)
+    {
+      uint32_t group_code = group_column ? group_column->codes[row] : 0;
+      int s_id = series_by_code[group_code];
+      if (s_id == -1)
+      {
+        s_id = series.size();
+        series_by_code[group_code] = s_id;
+        series_codes.push_back(group_code);
+        series.emplace_back();
+        series.back().first_row = row;
+        series_points.emplace_back();
+      }
+
+      if (aggregation == Aggregation::None)
+      {
+        series[s_id].point_rows.push_back(row);
+        series[s_id].x.push_back(x_numbers[row]);
+        series[s_id].y.push_back(y_numbers[row]);
+        continue;
+      }
+
+      uint64_t key = (uint64_t(group_code) << 32) | key_column->codes[row];
+      auto it = point_by_key.find(key);
+      if (it == point_by_key.end())
+      {
+        it = point_by_key.emplace(key, accumulators.size()).first;
+        series_points[s_id].push_back(accumulators.size());
+        accumulators.emplace_back();
+        accumulators.back().series = s_id;
+        accumulators.back().first_row = row;
+      }
+      accumulators[it->second].add(x_numbers[row], y_numbers[row], keep_values);
+    }
+
+    if (aggregation != Aggregation::None)
+    {
+      for (int s_id = 0; s_id < series.size(); s_id++)
+      {
+        for (int a_id : series_points[s_id])
+        {
+          PointAccumulator &acc = accumulators[a_id];
+          series[s_id].point_rows.push_back(acc.first_row);
+          series[s_id].x.push_back(acc.x_count > 0 ? acc.x_sum / acc.x_count : NAN);
+          series[s_id].y.push_back(acc.result(aggregation));
+        }
+      }
+    }
+
+    if (group_column)
+    {
+      std::vector<int> order(series.size());
+      for (int i = 0; i < order.size(); i++)
+        order[i] = i;
+      std::sort(order.begin(), order.end(), [&](int a, int b)
+                { return group_column->dictionary[series_codes[a]] < group_column->dictionary[series_codes[b]]; });
+      std::vector<GroupedSeries> sorted_series(series.size());
+      for (int i = 0; i < order.size(); i++)
+        sorted_series[i] = std::move(series[order[i]]);
+      series = std::move(sorted_series);
+    }
+
+    return series;
+  }
+
   std::vector<int> toIntArray(const Table::BaseColumn &column, int default_value)
   {
     std::vector<int> result(column.size());
@@ -317,6 +1112,17 @@ namespace csv
     return result;
   }
 
+  std::vector<float> toFloatArray(const Table::EncodedColumn &column, const std::vector<int> &rows, float default_value)
+  {
+    std::vector<float> result(rows.size());
+    for (int i = 0; i < rows.size(); i++)
+    {
+      double value = column.numbers()[rows[i]];
+      result[i] = std::isnan(value) ? default_value : value;
+    }
+    return result;
+  }
+
   std::vector<float> toFloatArray(const Table::BaseColumn &column, float default_value)
   {
     std::vector<float> result(column.size());
@@ -2,15 +2,62 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <regex>
+#include <cstdint>
 
 #include "blk/blk.h"
 
 namespace csv
 {
+  // packed set of row flags, 64 rows per word. Bits past size() are always 0
+  struct Bitmap
+  {
+    Bitmap() = default;
+    Bitmap(int _size, bool value) { resize(_size, value); }
+
+    void resize(int _size, bool value);
+    int size() const { return bit_count; }
+    int count() const;
+    bool get(int idx) const { return (words[idx >> 6] >> (idx & 63)) & 1u; }
+    void set(int idx, bool value)
+    {
+      uint64_t bit = uint64_t(1) << (idx & 63);
+      words[idx >> 6] = value ? (words[idx >> 6] | bit) : (words[idx >> 6] & ~bit);
+    }
+    std::vector<int> toIndices() const;
+
+    Bitmap &operator&=(const Bitmap &rhs);
+    Bitmap &operator|=(const Bitmap &rhs);
+    Bitmap &andNot(const Bitmap &rhs); // this = this & ~rhs
+
+    std::vector<uint64_t> words;
+    int bit_count = 0;
+  };
+
+  class MappedFile;
+
   struct Table
   {
     using BaseColumn = std::vector<std::string>;
 
+    // typed view of a column, built once by encode()
+    // every distinct string is stored once in dictionary, rows keep only its index.
+    // Numeric columns of columnar files have no dictionary until it is asked for with
+    // Table::coded(), only grouped, filtered and printed columns need it
+    struct EncodedColumn
+    {
+      // per row numeric value, NaN if not a number
+      const double *numbers() const { return mapped_numbers ? mapped_numbers : owned_numbers.data(); }
+
+      mutable std::vector<uint32_t> codes;         // per row, index in dictionary
+      mutable std::vector<std::string> dictionary; // distinct values in order of first appearance
+      mutable std::vector<double> dictionary_numbers; // numeric value of each dictionary entry, NaN if not a number
+      mutable bool has_dictionary = false;
+
+      std::vector<double> owned_numbers;
+      const double *mapped_numbers = nullptr; // Float64 column read in place from the mapped file
+    };
+
     inline int get_column_idx(const std::string &name) const
     {
       for (int i = 0; i < header.size(); i++)
@@ -23,26 +70,48 @@ namespace csv
     BaseColumn &operator[](const std::string &name) { return operator[](get_column_idx(name)); }
     const BaseColumn &operator[](const std::string &name) const { return operator[](get_column_idx(name)); }
 
+    // string value of a cell, tables loaded from columnar files keep strings only in dictionaries
+    const std::string &value(int col, int row) const
+    {
+      return row < columns[col].size() ? columns[col][row] : coded(col).dictionary[encoded[col].codes[row]];
+    }
+    // encoded column with codes and dictionary, they are built on the first call if the column has none
+    const EncodedColumn &coded(int col) const;
+
+    // (re)builds encoded columns from string columns, must be called after table is modified
+    // if only rows were appended, encoding can start from the first new row
+    void encode(int first_row = 0);
+    bool is_encoded() const { return encoded.size() == columns.size(); }
+
     std::vector<std::string> header; // column names
     std::vector<BaseColumn> columns;
+    std::vector<EncodedColumn> encoded; // same order as columns
     BaseColumn empty_column;
     int row_count = 0;
+    // tables made by load_csv_cached from appended rows keep the lineage of the table they extend,
+    // their first rows are the same as in it. Different loads of a file have different lineages
+    uint64_t lineage = 0;
+    std::shared_ptr<const MappedFile> mapped_file; // memory that mapped_numbers of columns point to
   };
 
   struct Slice
   {
     Slice() = default;
     Slice(const Slice &rhs) = default;
-    Slice(const std::shared_ptr<Table> _data) : data(_data)
-    {
-      row_mask.resize(data->row_count, true);
-    }
+    // slices never modify the table, so one table can be shared by many slices
+    Slice(std::shared_ptr<const Table> _data);
+    // only rows starting from first_row are in the slice, e.g. rows appended since the last look
+    Slice(std::shared_ptr<const Table> _data, int first_row);
+    // encodes the table first if it was not encoded yet
+    Slice(const std::shared_ptr<Table> &_data);
 
     int getRowCount() const;
+    // indices of rows that passed all filters, in ascending order
+    std::vector<int> getRowIndices() const;
     std::shared_ptr<Table> toTable() const;
 
-    const std::shared_ptr<Table> data;
-    std::vector<bool> row_mask;
+    const std::shared_ptr<const Table> data;
+    Bitmap row_mask;
   };
 
   class Filter
@@ -50,15 +119,21 @@ namespace csv
   public:
     virtual ~Filter() = default;
     virtual void filter(Slice &slice) const = 0;
+  protected:
+    // expands per-dictionary-entry verdicts to a row bitmap, words where
+    // no row is active are skipped (filters are evaluated only on surviving rows)
+    static Bitmap match_codes(const Table::EncodedColumn &column, const std::vector<uint8_t> &code_matches,
+                              const Bitmap &active_rows);
+    static void apply_match(Slice &slice, const Bitmap &matched, bool exclude);
   };
 
   class FilterExactMatch : public Filter
   {
   public:
     FilterExactMatch(const std::string &_column_name, const std::string &_value, bool _exclude = false) : 
-      column_name(_column_name), values{ _value }, exclude(_exclude) {}
+      exclude(_exclude), column_name(_column_name), values{ _value } {}
     FilterExactMatch(const std::string &_column_name, const std::vector<std::string> &_values, bool _exclude = false) : 
-      column_name(_column_name), values(_values), exclude(_exclude) {}
+      exclude(_exclude), column_name(_column_name), values(_values) {}
     void filter(Slice &slice) const override;
   private:
     bool exclude; // if true, exclude matched rows
@@ -70,19 +145,20 @@ namespace csv
   {
   public:
     FilterRegexMatch(const std::string &_column_name, const std::string &_regex, bool _exclude = false) : 
-      column_name(_column_name), regex(_regex), exclude(_exclude) {}
+      exclude(_exclude), column_name(_column_name), regex(_regex), compiled_regex(_regex) {}
     void filter(Slice &slice) const override;
   private:
     bool exclude; // if true, exclude matched rows
     std::string column_name;
     std::string regex;
+    std::regex compiled_regex; // compiled once, matched once per distinct value
   };
 
   class FilterRangeMatch : public Filter
   {
   public:
     FilterRangeMatch(const std::string &_column_name, double _min, double _max, bool _exclude = false) : 
-      column_name(_column_name), min(_min), max(_max), exclude(_exclude) {}
+      exclude(_exclude), column_name(_column_name), min(_min), max(_max) {}
     void filter(Slice &slice) const override;
   private:
     bool exclude; // if true, exclude matched rows
@@ -91,13 +167,80 @@ namespace csv
     double max;
   };
 
+  enum class Aggregation
+  {
+    None,   // every row is a separate point
+    Mean,
+    Min,
+    Max,
+    Median,
+    StdDev, // population standard deviation
+    Count   // number of merged rows
+  };
+
+  // one group of rows turned into a sequence of points
+  struct GroupedSeries
+  {
+    int first_row = -1;          // first row of the group in table
+    std::vector<int> point_rows; // first row of every point
+    std::vector<double> x;
+    std::vector<double> y;
+  };
+
+  // groups rows by group_col (all rows are one group if it is -1), groups are sorted by their value.
+  // If aggregation is not None, rows of a group with the same value in key_col are merged
+  // into one point: y values are aggregated, x values are averaged. Points keep the order
+  // of their first row. Works in one pass over dictionary-encoded columns
+  std::vector<GroupedSeries> group_and_aggregate(const Table &table, const std::vector<int> &rows,
+                                                 int group_col, int key_col, int x_col, int y_col,
+                                                 Aggregation aggregation = Aggregation::None);
+
   std::shared_ptr<Table> load_csv(const std::string &filename);
+  // same as load_csv, but the parsed table is shared by all callers until
+  // the file's modification time or size changes. Returned tables are never modified.
+  // If the file has grown (e.g. a log that is still being written) and its start and the
+  // last parsed bytes are unchanged, only appended rows are parsed: the new table is a copy
+  // of the cached one with these rows added, it has the same lineage, existing rows and
+  // dictionary codes. Callers find new rows by comparing row_count with the one they have
+  // seen. Otherwise the file is parsed again into a table of a new lineage.
+  // Columnar files are detected by their magic and loaded with load_columnar
+  std::shared_ptr<const Table> load_csv_cached(const std::string &filename);
+  void clear_csv_cache();
   void save_csv(const std::string &filename, const Table &data, bool in_quotes = true);
   void print_csv(const Table &data, int max_rows = -1);
 
+  // Binary columnar tables (.lfc), all values are little-endian:
+  //   header:      char magic[8] = "LFCOL01", uint32 column_count, uint32 reserved, uint64 row_count
+  //   descriptors: column_count x {uint32 type, uint32 name_length, uint64 data_offset,
+  //                uint64 data_size, char name[name_length]}
+  //   column data, data_offset is counted from the start of file:
+  //     Float64, Float32, Int64, Int32: row_count values
+  //     String: uint32 dictionary_size, dictionary_size x {uint32 length, char str[length]},
+  //             row_count x uint32 code (index in dictionary)
+  // Files are memory-mapped and loaded straight into encoded columns, without text parsing.
+  // Float64 columns are not copied, the table keeps the file mapped, so files that are being
+  // read should be replaced (written to a new file and renamed), not rewritten in place
+  enum class ColumnType : uint32_t
+  {
+    Float64 = 0,
+    Float32 = 1,
+    Int64 = 2,
+    Int32 = 3,
+    String = 4
+  };
+
+  bool is_columnar_file(const std::string &filename);
+  std::shared_ptr<Table> load_columnar(const std::string &filename);
+  // columns where every value is a number written the way loaded Float64 values are printed ("%.15g")
+  // are saved as Float64, other ones as String. Loaded tables have the same text in every cell
+  bool save_columnar(const std::string &filename, const Table &data);
+
   std::shared_ptr<Filter> load_filter(const Block *blk);
-  Slice load_csv_slice(const Block *blk);
+  // rows of the table before first_row are left out of the slice and are not filtered
+  Slice load_csv_slice(const Block *blk, int first_row = 0);
 
   std::vector<int>   toIntArray(const Table::BaseColumn &column, int default_value = 0);
   std::vector<float> toFloatArray(const Table::BaseColumn &column, float default_value = 0);
+  // numeric values of the given rows of encoded column, without parsing strings again
+  std::vector<float> toFloatArray(const Table::EncodedColumn &column, const std::vector<int> &rows, float default_value = 0);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <cstdio>
 #include "figure.h"
 #include "ttf_reader.h"
+#include "csv/csv.h"
 
 int main(int argc, char *argv[]) 
 {
@@ -20,6 +21,21 @@ int main(int argc, char *argv[])
     return 0;
   }
   
+  if (argc > 3 && std::string(argv[1]) == "--csv_to_columnar")
+  {
+    auto table = csv::load_csv(argv[2]);
+    return csv::save_columnar(argv[3], *table) ? 0 : 1;
+  }
+
+  if (argc > 3 && std::string(argv[1]) == "--watch")
+  {
+    Block blk;
+    load_block_from_file(argv[2], blk);
+    int interval_ms = argc > 4 ? std::stoi(argv[4]) : 1000;
+    LiteFigure::watch_and_save_figure(blk, argv[3], interval_ms);
+    return 0;
+  }
+
   if (argc == 2)
   {
     Block blk;
@@ -36,6 +52,8 @@ int main(int argc, char *argv[])
   }
   {
     printf("Usage: %s input.blk [<output_image>]\n", argv[0]);
+    printf("       %s --watch input.blk <output_image> [<interval_ms>]\n", argv[0]);
+    printf("       %s --csv_to_columnar input.csv output.lfc\n", argv[0]);
     return 1;
   }
 
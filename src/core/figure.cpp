@@ -1,6 +1,17 @@
 #include "figure.h"
 #include "renderer.h"
+#include "image_writer.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
 #include <cstdio>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <filesystem>
+#include <map>
+#include <mutex>
 
 namespace LiteFigure
 {
@@ -31,9 +42,39 @@ namespace LiteFigure
                        {"Dotted", (unsigned)LineStyle::Dotted},
                    }; })());
 
+  REGISTER_ENUM(FillRule,
+                ([]()
+                 { return std::vector<std::pair<std::string, unsigned>>{
+                       {"EvenOdd", (unsigned)FillRule::EvenOdd},
+                       {"NonZero", (unsigned)FillRule::NonZero},
+                   }; })());
+
+  REGISTER_ENUM(LineJoin,
+                ([]()
+                 { return std::vector<std::pair<std::string, unsigned>>{
+                       {"Miter", (unsigned)LineJoin::Miter},
+                       {"Round", (unsigned)LineJoin::Round},
+                       {"Bevel", (unsigned)LineJoin::Bevel},
+                   }; })());
+
+  REGISTER_ENUM(FramebufferFormat,
+                ([]()
+                 { return std::vector<std::pair<std::string, unsigned>>{
+                       {"RGBA32F", (unsigned)FramebufferFormat::RGBA32F},
+                       {"RGBA16F", (unsigned)FramebufferFormat::RGBA16F},
+                       {"RGBA8", (unsigned)FramebufferFormat::RGBA8},
+                   }; })());
+
+  REGISTER_ENUM(PngCompression,
+                ([]()
+                 { return std::vector<std::pair<std::string, unsigned>>{
+                       {"Fast", (unsigned)PngCompression::Fast},
+                       {"Small", (unsigned)PngCompression::Small},
+                   }; })());
+
   FigurePtr create_error_figure_dummy()
   {
-    std::shared_ptr<PrimitiveFill> prim = std::make_shared<PrimitiveFill>();
+    std::shared_ptr<PrimitiveFill> prim = make_figure<PrimitiveFill>();
     prim->size = int2(64, 64);
     prim->color = float4(1, 0, 1, 1);
     return prim;
@@ -49,43 +90,43 @@ namespace LiteFigure
       fig = create_error_figure_dummy();
       break;
     case FigureType::Grid:
-      fig = std::make_shared<Grid>();
+      fig = make_figure<Grid>();
       break;
     case FigureType::Collage:
-      fig = std::make_shared<Collage>();
+      fig = make_figure<Collage>();
       break;
     case FigureType::Transform:
-      fig = std::make_shared<Transform>();
+      fig = make_figure<Transform>();
       break;
     case FigureType::PrimitiveImage:
-      fig = std::make_shared<PrimitiveImage>();
+      fig = make_figure<PrimitiveImage>();
       break;
     case FigureType::PrimitiveFill:
-      fig = std::make_shared<PrimitiveFill>();
+      fig = make_figure<PrimitiveFill>();
       break;
     case FigureType::Line:
-      fig = std::make_shared<Line>();
+      fig = make_figure<Line>();
       break;
     case FigureType::Circle:
-      fig = std::make_shared<Circle>();
+      fig = make_figure<Circle>();
       break;
     case FigureType::Polygon:
-      fig = std::make_shared<Polygon>();
+      fig = make_figure<Polygon>();
       break;
     case FigureType::Text:
-      fig = std::make_shared<Text>();
+      fig = make_figure<Text>();
       break;
     case FigureType::Glyph:
-      fig = std::make_shared<Glyph>();
+      fig = make_figure<Glyph>();
       break;
     case FigureType::LinePlot:
-      fig = std::make_shared<LinePlot>();
+      fig = make_figure<LinePlot>();
       break;
     case FigureType::LineGraph:
-      fig = std::make_shared<LineGraph>();
+      fig = make_figure<LineGraph>();
       break;
     case FigureType::Rectangle:
-      fig = std::make_shared<Rectangle>();
+      fig = make_figure<Rectangle>();
       break;
     default:
       printf("[create_figure] unsupported figure type %d\n", (int)blk->get_enum("type", (unsigned)FigureType::Unknown));
@@ -99,6 +140,51 @@ namespace LiteFigure
     return nullptr;
   }
 
+  thread_local const uint64_t *Figure::current_layout_epoch = nullptr;
+  thread_local std::shared_ptr<FigureArena> FigureArena::current_arena;
+
+  // epochs are unique among all trees, so a subtree laid out as a part of different trees
+  // never takes sizes remembered for another one
+  static uint64_t new_layout_epoch()
+  {
+    static std::atomic<uint64_t> next_epoch(1);
+    return next_epoch++;
+  }
+
+  void Figure::invalidate_layouts()
+  {
+    tree_layout_epoch = new_layout_epoch();
+  }
+
+  int2 Figure::layout(int2 force_size)
+  {
+    if (!current_layout_epoch)
+    {
+      // this figure is the root of the layout
+      if (tree_layout_epoch == 0)
+        tree_layout_epoch = new_layout_epoch();
+      current_layout_epoch = &tree_layout_epoch;
+      int2 root_size = layout(force_size);
+      current_layout_epoch = nullptr;
+      return root_size;
+    }
+
+    const uint64_t layout_epoch = *current_layout_epoch;
+    if (layout_valid_epoch == layout_epoch && equal(size, layout_size))
+    {
+      // figure is already laid out to its current size, and both its own
+      // size and current size lead to the same result
+      if (!is_valid_size(force_size) || equal(force_size, size) || equal(force_size, layout_force_size))
+        return size;
+    }
+
+    calculateSize(force_size);
+    layout_valid_epoch = layout_epoch;
+    layout_force_size = force_size;
+    layout_size = size;
+    return size;
+  }
+
   void get_elements_min_max(const std::vector<Collage::Element> &elements, int2 &min_val, int2 &max_val)
   {
     assert(elements.size() > 0);
@@ -131,7 +217,7 @@ namespace LiteFigure
     for (int i = 0; i < elements.size(); i++)
     {
       if (!is_valid_size(elements[i].size))
-        elements[i].size = elements[i].figure->calculateSize();
+        elements[i].size = elements[i].figure->layout();
     }
 
     // calculate proper size
@@ -152,7 +238,7 @@ namespace LiteFigure
       {
         elements[i].pos = int2(float2(elements[i].pos) * scale);
         int2 target_size = max(int2(1, 1), int2(float2(elements[i].size) * scale));
-        elements[i].size = elements[i].figure->calculateSize(target_size);
+        elements[i].size = elements[i].figure->layout(target_size);
         if (verbose)
           printf("[Collage] element %d (type %d), pos %d %d, target size %d %d -> size %d %d\n", i, (int)elements[i].figure->getType(),
                  elements[i].pos.x, elements[i].pos.y,
@@ -170,6 +256,16 @@ namespace LiteFigure
     return size;
   }
 
+  bool Collage::update()
+  {
+    bool changed = false;
+    for (auto &elem : elements)
+      changed |= elem.figure->update();
+    if (changed)
+      invalidate_layouts();
+    return changed;
+  }
+
   bool Collage::load(const Block *blk)
   {
     size = blk->get_ivec2("size", size);
@@ -211,7 +307,7 @@ namespace LiteFigure
       int row_height = 0;
       for (auto &figure : row)
       {
-        int2 figure_size = figure->calculateSize();
+        int2 figure_size = figure->layout();
         if (verbose)
           printf("[Grid] figure pos %d %d, size %d %d\n", cur_pos.x, cur_pos.y, figure_size.x, figure_size.y);
         row_height = std::max(row_height, figure_size.y);
@@ -241,7 +337,7 @@ namespace LiteFigure
       for (auto &figure : row)
       {
         int2 target_size = max(int2(1, 1), int2(float2(figure->size) * scale));
-        int2 figure_size = figure->calculateSize(target_size);
+        int2 figure_size = figure->layout(target_size);
         if (verbose)
           printf("[Grid] figure pos %d %d, target size %d %d, size %d %d\n", cur_pos.x, cur_pos.y,
                  target_size.x, target_size.y, figure_size.x, figure_size.y);
@@ -256,10 +352,24 @@ namespace LiteFigure
     return size;
   }
 
-  void Collage::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+  void Collage::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
   {
     for (int i = 0; i < elements.size(); i++)
-      elements[i].figure->prepareInstances(pos + elements[i].pos, out_instances);
+    {
+      int2 elem_pos = pos + elements[i].pos;
+      elements[i].figure->prepareInstances(elem_pos, clip.intersect(elem_pos, elem_pos + elements[i].figure->size), out_instances);
+    }
+  }
+
+  bool Grid::update()
+  {
+    bool changed = false;
+    for (auto &row : rows)
+      for (auto &figure : row)
+        changed |= figure->update();
+    if (changed)
+      invalidate_layouts();
+    return changed;
   }
 
   bool Grid::load(const Block *blk)
@@ -296,7 +406,7 @@ namespace LiteFigure
     return true;
   }
 
-  void Grid::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+  void Grid::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
   {
     int2 cur_pos = int2(0, 0); // local position in grid
     for (auto &row : rows)
@@ -306,7 +416,7 @@ namespace LiteFigure
       for (auto &figure : row)
       {
         row_height = std::max(row_height, figure->size.y);
-        figure->prepareInstances(pos + cur_pos, out_instances);
+        figure->prepareInstances(pos + cur_pos, clip.intersect(pos + cur_pos, pos + cur_pos + figure->size), out_instances);
         cur_pos.x += figure->size.x;
       }
       cur_pos.y += row_height;
@@ -320,8 +430,8 @@ namespace LiteFigure
     if (!is_valid_size(force_size) && is_valid_size(size))
       force_size = size;
 
-    int2 figure_size = figure->calculateSize();
-    int2 target_size = int2(scale * float2(crop.z - crop.x, crop.w - crop.y) * float2(figure->calculateSize()));
+    int2 figure_size = figure->layout();
+    int2 target_size = int2(scale * float2(crop.z - crop.x, crop.w - crop.y) * float2(figure_size));
 
     if (is_valid_size(force_size))
     {
@@ -334,11 +444,19 @@ namespace LiteFigure
     }
     
     if (frame)
-      size = frame->calculateSize(size);
+      size = frame->layout(size);
 
     return size;
   }
 
+  bool Transform::update()
+  {
+    bool changed = figure && figure->update();
+    if (changed)
+      invalidate_layouts();
+    return changed;
+  }
+
   bool Transform::load(const Block *blk)
   {
     size = blk->get_ivec2("size", size);
@@ -363,7 +481,7 @@ namespace LiteFigure
       Block fig_frame_blk;
       fig_frame_blk.copy(blk->get_block("frame"));
       fig_frame_blk.set_ivec2("size", int2(1,1)); //real size is the same as image, it will be set later
-      frame = std::make_shared<Rectangle>();
+      frame = make_figure<Rectangle>();
       bool frame_loaded = frame->load(&fig_frame_blk);
       if (!frame_loaded)
       {
@@ -375,8 +493,9 @@ namespace LiteFigure
     return true;
   }
 
-  void Transform::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+  void Transform::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
   {
+    const ClipRect own_clip = clip.intersect(pos, pos + size);
     auto child_type = figure->getType();
     if (child_type == FigureType::PrimitiveImage || child_type == FigureType::Transform)
     {
@@ -400,34 +519,129 @@ namespace LiteFigure
                                  0, mirror_y ? -1 : 1, mirror_y ? 1 : 0,
                                  0, 0, 1);
       std::vector<Instance> instances_to_transform;
-      figure->prepareInstances(pos, instances_to_transform);
+      figure->prepareInstances(pos, ClipRect(), instances_to_transform);
       float3x3 transform = mirror * rot * crop_trans;
       for (auto &inst : instances_to_transform)
       {
-        inst.prim->size = size;
+        // transform replaces geometry of the child, so its clip rect does not apply anymore.
+        // Glyphs are not clipped by containers, their outlines can slightly exceed text size
+        const ClipRect &inst_clip = inst.prim->getType() == FigureType::Glyph ? ClipRect{pos, pos + size} : own_clip;
+        inst.data.size = size;
+        inst.data.clip_min = inst_clip.p0;
+        inst.data.clip_max = inst_clip.p1;
         inst.data.uv_transform = transform * inst.data.uv_transform;
         out_instances.push_back(inst);
       }
     }
     else
     {
-      figure->prepareInstances(pos, out_instances);
+      figure->prepareInstances(pos, own_clip, out_instances);
     }
 
     if (frame)
     {
-      frame->prepareInstances(pos, out_instances);
+      frame->prepareInstances(pos, own_clip, out_instances);
     }
   }
 
   std::vector<Instance> prepare_instances(FigurePtr figure)
   {
-    int2 actual_size = figure->calculateSize(figure->size);
+    int2 actual_size = figure->layout(figure->size);
     std::vector<Instance> instances;
-    figure->prepareInstances(int2(0, 0), instances);
+    figure->prepareInstances(int2(0, 0), ClipRect(), instances);
     return instances;
   }
 
+  // instances that overwrite every pixel of their rect
+  static bool is_opaque_rect(const Instance &inst)
+  {
+    if (inst.prim->getType() == FigureType::PrimitiveFill)
+      return dynamic_cast<const PrimitiveFill *>(inst.prim)->color.w >= 1.0f;
+    if (inst.prim->getType() == FigureType::PrimitiveImage)
+    {
+      // image alpha is always 1 (see PrimitiveImage::load), only border color can be transparent
+      const PrimitiveImage *image = dynamic_cast<const PrimitiveImage *>(inst.prim);
+      bool has_border = image->sampler.addressU == LiteImage::Sampler::AddressMode::BORDER ||
+                        image->sampler.addressV == LiteImage::Sampler::AddressMode::BORDER;
+      return !has_border || image->sampler.borderColor.w >= 1.0f;
+    }
+    return false;
+  }
+
+  CullStats cull_instances(std::vector<Instance> &instances, int2 canvas_size)
+  {
+    constexpr int TILE = 16;
+    CullStats stats;
+    stats.total = instances.size();
+    if (canvas_size.x <= 0 || canvas_size.y <= 0)
+    {
+      stats.off_canvas = instances.size();
+      instances.clear();
+      return stats;
+    }
+
+    // tile is covered if some later opaque instance overwrites all its pixels
+    int2 tiles = int2((canvas_size.x + TILE - 1) / TILE, (canvas_size.y + TILE - 1) / TILE);
+    std::vector<bool> covered(tiles.x * tiles.y, false);
+    std::vector<bool> visible(instances.size(), false);
+
+    for (int i = (int)instances.size() - 1; i >= 0; i--)
+    {
+      Instance &inst = instances[i];
+      if (!inst.prim)
+        continue;
+      int2 p0 = max(max(inst.data.pos, inst.data.clip_min), int2(0, 0));
+      int2 p1 = min(min(inst.data.pos + inst.data.size, inst.data.clip_max), canvas_size);
+      if (p0.x >= p1.x || p0.y >= p1.y)
+      {
+        stats.off_canvas++;
+        continue;
+      }
+
+      int2 t0 = p0 / TILE;
+      int2 t1 = (p1 - int2(1, 1)) / TILE;
+      bool hidden = true;
+      for (int ty = t0.y; ty <= t1.y && hidden; ty++)
+        for (int tx = t0.x; tx <= t1.x && hidden; tx++)
+          hidden = covered[ty * tiles.x + tx];
+      if (hidden)
+      {
+        stats.occluded++;
+        continue;
+      }
+
+      visible[i] = true;
+      if (p0.x != inst.data.pos.x || p0.y != inst.data.pos.y ||
+          p1.x != inst.data.pos.x + inst.data.size.x || p1.y != inst.data.pos.y + inst.data.size.y)
+        stats.clipped++;
+      inst.data.clip_min = p0;
+      inst.data.clip_max = p1;
+
+      if (is_opaque_rect(inst))
+      {
+        for (int ty = t0.y; ty <= t1.y; ty++)
+        {
+          for (int tx = t0.x; tx <= t1.x; tx++)
+          {
+            int2 tile_min = int2(tx * TILE, ty * TILE);
+            int2 tile_max = min(tile_min + int2(TILE, TILE), canvas_size);
+            if (tile_min.x >= p0.x && tile_min.y >= p0.y && tile_max.x <= p1.x && tile_max.y <= p1.y)
+              covered[ty * tiles.x + tx] = true;
+          }
+        }
+      }
+    }
+
+    int count = 0;
+    for (int i = 0; i < instances.size(); i++)
+    {
+      if (visible[i])
+        instances[count++] = instances[i];
+    }
+    instances.resize(count);
+    return stats;
+  }
+
   FigurePtr create_figure_from_blk(const Block *blk)
   {
     const Block *figure_blk = nullptr;
@@ -440,34 +654,623 @@ namespace LiteFigure
       figure_blk = blk;
     }
 
+    // the whole tree lives in one arena, it is freed together with the figure
+    FigureArena::Scope arena_scope(std::make_shared<FigureArena>());
     return create_figure(figure_blk);
   }
 
-  LiteImage::Image2D<float4> render_figure_to_image(FigurePtr fig)
+  RenderSettings load_render_settings(const Block *blk)
   {
-    Renderer renderer;
+    RenderSettings settings;
+    settings.msaa_samples = blk->get_int("msaa_samples", settings.msaa_samples);
+    settings.band_height = blk->get_int("band_height", settings.band_height);
+    settings.framebuffer_format = (FramebufferFormat)blk->get_enum("framebuffer", (unsigned)settings.framebuffer_format);
+    settings.png_compression = (PngCompression)blk->get_enum("png_compression", (unsigned)settings.png_compression);
+    settings.jpeg_quality = blk->get_int("jpeg_quality", settings.jpeg_quality);
+    settings.verbose = blk->get_bool("verbose", settings.verbose);
+    settings.tile_format = blk->get_string("tile_format", settings.tile_format);
+    for (int i = 0; i < blk->size(); i++)
+    {
+      if (blk->get_type(i) != Block::ValueType::BLOCK || blk->get_name(i) != "output")
+        continue;
+      const Block *output_blk = blk->get_block(i);
+      ScaledOutput output;
+      output.path = output_blk->get_string("path");
+      output.scale = output_blk->get_double("scale", output.scale);
+      output.width = output_blk->get_int("width", output.width);
+      output.height = output_blk->get_int("height", output.height);
+      if (output.path == "")
+        printf("[load_render_settings] output %d has no path, skipping it\n", (int)settings.scaled_outputs.size());
+      else
+        settings.scaled_outputs.push_back(output);
+    }
+    return settings;
+  }
+
+  // lists instances whose visible part touches each cell of a grid that covers the canvas,
+  // every list keeps the drawing order
+  static std::vector<std::vector<int>> bucket_instances(const std::vector<Instance> &instances, int2 canvas_size,
+                                                        int2 cell_size, int2 grid_size)
+  {
+    std::vector<std::vector<int>> cells(grid_size.x * grid_size.y);
+    for (int i = 0; i < instances.size(); i++)
+    {
+      const InstanceData &data = instances[i].data;
+      int2 p0 = max(max(data.pos, data.clip_min), int2(0, 0));
+      int2 p1 = min(min(data.pos + data.size, data.clip_max), canvas_size);
+      if (p1.x <= p0.x || p1.y <= p0.y)
+        continue;
+      for (int y = p0.y / cell_size.y; y <= (p1.y - 1) / cell_size.y; y++)
+        for (int x = p0.x / cell_size.x; x <= (p1.x - 1) / cell_size.x; x++)
+          cells[y * grid_size.x + x].push_back(i);
+    }
+    return cells;
+  }
+
+  // renders listed instances into region [origin, origin+size) of the canvas, out holds the region
+  static void render_region(const std::vector<Instance> &instances, const std::vector<int> &ids, int2 origin, int2 size,
+                            const Renderer &renderer, LiteImage::Image2D<float4> &out)
+  {
+    // moves instances to region coordinates, region clip keeps them from drawing outside of it
+    std::vector<Instance> local_instances;
+    local_instances.reserve(ids.size());
+    for (int i : ids)
+    {
+      Instance inst = instances[i];
+      inst.data.pos -= origin;
+      inst.data.clip_min = max(inst.data.clip_min, origin) - origin;
+      inst.data.clip_max = min(inst.data.clip_max, origin + size) - origin;
+      local_instances.push_back(inst);
+    }
+
+    out.clear(float4(0, 0, 0, 0));
+    InstanceBuffer buffer;
+    buffer.build(local_instances);
+    renderer.render_instances(buffer, out);
+  }
+
+  // renders culled instances band by band into a float buffer and hands every band to store(band, first_row, rows)
+  static void render_in_bands(const std::vector<Instance> &instances, int2 size, const RenderSettings &settings, int band_height,
+                              const std::function<void(const LiteImage::Image2D<float4> &, int, int)> &store)
+  {
+    if (size.x <= 0 || size.y <= 0)
+      return;
+    band_height = std::min(std::max(band_height, 1), size.y);
+    const int band_count = (size.y + band_height - 1) / band_height;
+    std::vector<std::vector<int>> band_instances = bucket_instances(instances, size, int2(size.x, band_height),
+                                                                    int2(1, band_count));
+
+    Renderer renderer(settings);
+    LiteImage::Image2D<float4> band(size.x, band_height);
+    for (int b = 0; b < band_count; b++)
+    {
+      const int y0 = b * band_height;
+      const int rows = std::min(band_height, size.y - y0);
+      render_region(instances, band_instances[b], int2(0, y0), int2(size.x, rows), renderer, band);
+      store(band, y0, rows);
+    }
+  }
+
+  LiteImage::Image2D<float4> render_figure_to_image(FigurePtr fig, const RenderSettings &settings)
+  {
+    if (settings.framebuffer_format != FramebufferFormat::RGBA32F)
+      return render_figure_to_framebuffer(fig, settings).to_image();
+
+    Renderer renderer(settings);
     std::vector<Instance> instances = prepare_instances(fig);
     LiteImage::Image2D<float4> out = LiteImage::Image2D<float4>(fig->size.x, fig->size.y);
 
-    for (auto &inst : instances)
-      renderer.render_instance(inst, out);
+    CullStats stats = cull_instances(instances, fig->size);
+    if (fig->verbose)
+      printf("[render_figure_to_image] %d instances, %d off canvas, %d occluded, %d clipped\n",
+             stats.total, stats.off_canvas, stats.occluded, stats.clipped);
+
+    InstanceBuffer buffer;
+    buffer.build(instances);
+    renderer.render_instances(buffer, out);
 
     return out;
   }
 
-  void save_figure(FigurePtr fig, const std::string &filename)
+  Framebuffer render_figure_to_framebuffer(FigurePtr fig, const RenderSettings &settings)
+  {
+    // small enough for the float band to stay in cache on typical figures
+    constexpr int DEFAULT_BAND_HEIGHT = 32;
+
+    std::vector<Instance> instances = prepare_instances(fig);
+    CullStats stats = cull_instances(instances, fig->size);
+    if (fig->verbose)
+      printf("[render_figure_to_framebuffer] %d instances, %d off canvas, %d occluded, %d clipped\n",
+             stats.total, stats.off_canvas, stats.occluded, stats.clipped);
+
+    Framebuffer framebuffer(fig->size.x, fig->size.y, settings.framebuffer_format);
+    int band_height = settings.band_height > 0 ? settings.band_height : DEFAULT_BAND_HEIGHT;
+    render_in_bands(instances, fig->size, settings, band_height,
+                    [&framebuffer](const LiteImage::Image2D<float4> &band, int first_row, int rows)
+                    { framebuffer.store_rows(band, first_row, rows); });
+    return framebuffer;
+  }
+
+  static double milliseconds_since(std::chrono::steady_clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  std::unique_ptr<ImageEncoder> create_image_encoder(const std::string &extension, const RenderSettings &settings)
+  {
+    if (extension == "png")
+      return std::make_unique<PngStreamWriter>(settings.png_compression);
+    if (extension == "qoi")
+      return std::make_unique<QoiStreamWriter>();
+    if (extension == "jpg" || extension == "jpeg")
+      return std::make_unique<JpegWriter>(settings.jpeg_quality);
+    if (extension == "exr")
+      return std::make_unique<ExrWriter>();
+    return nullptr;
+  }
+
+  static std::unique_ptr<ImageEncoder> create_multi_resolution_writer(std::unique_ptr<ImageEncoder> main,
+                                                                      const RenderSettings &settings)
+  {
+    auto writer = std::make_unique<MultiResolutionWriter>(std::move(main));
+    for (const ScaledOutput &output : settings.scaled_outputs)
+    {
+      std::string ext = output.path.substr(output.path.find_last_of(".") + 1);
+      std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+      if (std::unique_ptr<ImageEncoder> encoder = create_image_encoder(ext, settings))
+        writer->add_output(output, std::move(encoder));
+      else
+        printf("[create_multi_resolution_writer] unsupported file format \"%s\" (%s)\n", ext.c_str(), output.path.c_str());
+    }
+    return writer;
+  }
+
+  static bool save_framebuffer(const Framebuffer &framebuffer, const std::string &filename, ImageEncoder &encoder)
+  {
+    constexpr int ROWS_PER_WRITE = 64;
+
+    if (!encoder.open(filename, framebuffer.width(), framebuffer.height()))
+      return false;
+    std::vector<uint8_t> rgba;
+    LiteImage::Image2D<float4> rows_image;
+    for (int y0 = 0; y0 < framebuffer.height(); y0 += ROWS_PER_WRITE)
+    {
+      int rows = std::min(ROWS_PER_WRITE, framebuffer.height() - y0);
+      if (encoder.is_hdr())
+      {
+        rows_image.resize(framebuffer.width(), rows);
+        framebuffer.load_rows(y0, rows, rows_image);
+        encoder.write_float_rows(rows_image.data(), rows);
+      }
+      else
+      {
+        framebuffer.encode_rows(y0, rows, rgba);
+        encoder.write_rows(rgba.data(), rows);
+      }
+    }
+    return encoder.close();
+  }
+
+  static bool save_image(const LiteImage::Image2D<float4> &image, const std::string &filename, ImageEncoder &encoder)
+  {
+    constexpr int ROWS_PER_WRITE = 64;
+
+    if (!encoder.open(filename, image.width(), image.height()))
+      return false;
+    for (int y0 = 0; y0 < image.height(); y0 += ROWS_PER_WRITE)
+      write_image_rows(encoder, image, y0, std::min<int>(ROWS_PER_WRITE, image.height() - y0));
+    return encoder.close();
+  }
+
+  bool render_figure_banded(FigurePtr fig, const std::string &filename, ImageEncoder &encoder,
+                            const RenderSettings &settings, double *encode_ms)
+  {
+    // sets figure size
+    std::vector<Instance> instances = prepare_instances(fig);
+    if (!encoder.open(filename, fig->size.x, fig->size.y))
+      return false;
+
+    CullStats stats = cull_instances(instances, fig->size);
+    if (fig->verbose)
+      printf("[render_figure_banded] %d instances, %d off canvas, %d occluded, %d clipped\n",
+             stats.total, stats.off_canvas, stats.occluded, stats.clipped);
+
+    double encode_time = 0;
+    render_in_bands(instances, fig->size, settings, settings.band_height,
+                    [&](const LiteImage::Image2D<float4> &band, int /*first_row*/, int rows)
+                    {
+                      auto start = std::chrono::steady_clock::now();
+                      write_image_rows(encoder, band, 0, rows);
+                      encode_time += milliseconds_since(start);
+                    });
+    auto start = std::chrono::steady_clock::now();
+    bool ok = encoder.close();
+    encode_time += milliseconds_since(start);
+    if (encode_ms)
+      *encode_ms = encode_time;
+    return ok;
+  }
+
+  // deep zoom level l is the image downscaled 2^(max_level-l) times (sizes rounded up),
+  // level 0 is a single pixel. Tile (l, col, row) is the parent of the 2x2 tiles
+  // (l+1, 2*col+i, 2*row+j), so levels are built as a quadtree, every tile from its children
+  class DziPyramidWriter
+  {
+  public:
+    static constexpr int TILE_SIZE = 256;
+
+    DziPyramidWriter(const std::vector<Instance> &instances, int2 size, const std::string &tiles_dir,
+                     const RenderSettings &settings)
+        : instances(instances), renderer(settings), settings(settings), tiles_dir(tiles_dir)
+    {
+      max_level = 0;
+      while ((1 << max_level) < std::max(size.x, size.y))
+        max_level++;
+      level_sizes.resize(max_level + 1);
+      for (int l = 0; l <= max_level; l++)
+        level_sizes[l] = int2(((size.x - 1) >> (max_level - l)) + 1, ((size.y - 1) >> (max_level - l)) + 1);
+      int2 grid = tile_grid(max_level);
+      tile_instances = bucket_instances(instances, size, int2(TILE_SIZE, TILE_SIZE), grid);
+    }
+
+    int2 tile_grid(int level) const
+    {
+      return (level_sizes[level] + int2(TILE_SIZE - 1, TILE_SIZE - 1)) / TILE_SIZE;
+    }
+
+    // writes all tiles, subtrees of the first level with enough tiles are built in parallel
+    bool write(int threads)
+    {
+      int split_level = 0;
+      while (split_level < max_level && tile_grid(split_level).x * tile_grid(split_level).y < 4 * threads)
+        split_level++;
+
+      int2 grid = tile_grid(split_level);
+      std::vector<LiteImage::Image2D<float4>> split_tiles(grid.x * grid.y);
+      std::vector<char> split_drawn(grid.x * grid.y, 0);
+      parallel_for(grid.x * grid.y, threads, [&](int i)
+                   { split_drawn[i] = build_tile(split_level, int2(i % grid.x, i / grid.x), split_tiles[i]); });
+      for (int i = 0; i < split_tiles.size(); i++)
+        if (!split_drawn[i])
+          split_tiles[i] = LiteImage::Image2D<float4>();
+
+      // the few coarser tiles are built from the stored ones
+      for (int level = split_level - 1; level >= 0; level--)
+      {
+        int2 child_grid = grid;
+        grid = tile_grid(level);
+        std::vector<LiteImage::Image2D<float4>> tiles(grid.x * grid.y);
+        for (int row = 0; row < grid.y; row++)
+          for (int col = 0; col < grid.x; col++)
+          {
+            LiteImage::Image2D<float4> &tile = tiles[row * grid.x + col];
+            bool drawn = false;
+            for (int j = 0; j < 2; j++)
+              for (int i = 0; i < 2; i++)
+              {
+                int2 child = int2(2 * col + i, 2 * row + j);
+                if (child.x >= child_grid.x || child.y >= child_grid.y)
+                  continue;
+                const LiteImage::Image2D<float4> &child_tile = split_tiles[child.y * child_grid.x + child.x];
+                if (child_tile.width() == 0)
+                  continue;
+                if (!drawn)
+                  clear_tile(level, int2(col, row), tile);
+                downscale_into(child_tile, int2(i, j), tile);
+                drawn = true;
+              }
+            if (drawn)
+              write_tile(level, int2(col, row), tile);
+            else
+              tile = LiteImage::Image2D<float4>();
+          }
+        split_tiles = std::move(tiles);
+      }
+      return ok;
+    }
+
+    int levels() const { return max_level + 1; }
+    int tiles_written() const { return written; }
+    int uniform_tiles_copied() const { return copied; }
+
+  private:
+    // uniform tiles of the same color and size are encoded once, the rest are copies of that file
+    struct UniformTile
+    {
+      float4 color;
+      int2 size;
+      bool operator<(const UniformTile &rhs) const { return memcmp(this, &rhs, sizeof(UniformTile)) < 0; }
+    };
+
+    // true if all pixels are equal to the first one, which is returned in color
+    static bool is_uniform(const LiteImage::Image2D<float4> &image, float4 &color)
+    {
+      const float4 *pixels = image.data();
+      const size_t count = size_t(image.width()) * image.height();
+      color = pixels[0];
+      for (size_t i = 1; i < count; i++)
+        if (memcmp(&pixels[i], &color, sizeof(float4)) != 0)
+          return false;
+      return true;
+    }
+
+    int2 tile_size(int level, int2 tile) const
+    {
+      return min(level_sizes[level] - tile * TILE_SIZE, int2(TILE_SIZE, TILE_SIZE));
+    }
+
+    void clear_tile(int level, int2 tile, LiteImage::Image2D<float4> &out) const
+    {
+      int2 size = tile_size(level, tile);
+      out.resize(size.x, size.y);
+      out.clear(float4(0, 0, 0, 0));
+    }
+
+    // builds and writes tile and all its descendants, returns false if nothing is drawn in it
+    bool build_tile(int level, int2 tile, LiteImage::Image2D<float4> &out)
+    {
+      if (level == max_level)
+      {
+        const std::vector<int> &ids = tile_instances[tile.y * tile_grid(level).x + tile.x];
+        if (ids.empty())
+          return false;
+        int2 size = tile_size(level, tile);
+        out.resize(size.x, size.y);
+        render_region(instances, ids, tile * TILE_SIZE, size, renderer, out);
+        float4 color;
+        if (is_uniform(out, color) && color.x == 0 && color.y == 0 && color.z == 0 && color.w == 0)
+          return false;
+        write_tile(level, tile, out);
+        return true;
+      }
+
+      int2 child_grid = tile_grid(level + 1);
+      LiteImage::Image2D<float4> child_tile;
+      bool drawn = false;
+      for (int j = 0; j < 2; j++)
+        for (int i = 0; i < 2; i++)
+        {
+          int2 child = int2(2 * tile.x + i, 2 * tile.y + j);
+          if (child.x >= child_grid.x || child.y >= child_grid.y || !build_tile(level + 1, child, child_tile))
+            continue;
+          if (!drawn)
+            clear_tile(level, tile, out);
+          downscale_into(child_tile, int2(i, j), out);
+          drawn = true;
+        }
+      if (drawn)
+        write_tile(level, tile, out);
+      return drawn;
+    }
+
+    // averages 2x2 blocks of child into its quadrant of parent, blocks cut by image border
+    // average only the pixels they have
+    static void downscale_into(const LiteImage::Image2D<float4> &child, int2 quadrant,
+                               LiteImage::Image2D<float4> &parent)
+    {
+      const int cw = child.width();
+      const int ch = child.height();
+      const int x0 = quadrant.x * TILE_SIZE / 2;
+      const int y0 = quadrant.y * TILE_SIZE / 2;
+      for (int y = 0; 2 * y < ch; y++)
+      {
+        const int rows = std::min(2, ch - 2 * y);
+        for (int x = 0; 2 * x < cw; x++)
+        {
+          const int cols = std::min(2, cw - 2 * x);
+          float4 sum = float4(0, 0, 0, 0);
+          for (int j = 0; j < rows; j++)
+            for (int i = 0; i < cols; i++)
+              sum += child.data()[(2 * y + j) * cw + 2 * x + i];
+          parent.data()[(y0 + y) * parent.width() + x0 + x] = sum / float(rows * cols);
+        }
+      }
+    }
+
+    void write_tile(int level, int2 tile, const LiteImage::Image2D<float4> &image)
+    {
+      std::string dir = tiles_dir + "/" + std::to_string(level);
+      std::string path = dir + "/" + std::to_string(tile.x) + "_" + std::to_string(tile.y) + "." + settings.tile_format;
+      std::error_code ec;
+      std::filesystem::create_directories(dir, ec);
+
+      // a uniform tile that was already encoded is copied, the file is in the map only when it is complete
+      UniformTile uniform;
+      bool is_uniform_tile = is_uniform(image, uniform.color);
+      if (is_uniform_tile)
+      {
+        uniform.size = int2(image.width(), image.height());
+        std::string encoded_path;
+        {
+          std::lock_guard<std::mutex> lock(uniform_mutex);
+          auto it = uniform_tiles.find(uniform);
+          if (it != uniform_tiles.end())
+            encoded_path = it->second;
+        }
+        if (!encoded_path.empty() &&
+            std::filesystem::copy_file(encoded_path, path, std::filesystem::copy_options::overwrite_existing, ec))
+        {
+          written++;
+          copied++;
+          return;
+        }
+      }
+
+      // tiles are written in parallel, so every tile is compressed on one thread
+      std::unique_ptr<ImageEncoder> encoder;
+      if (settings.tile_format == "png")
+        encoder = std::make_unique<PngStreamWriter>(settings.png_compression, 1);
+      else
+        encoder = create_image_encoder(settings.tile_format, settings);
+      bool tile_ok = encoder && save_image(image, path, *encoder);
+      if (!tile_ok)
+        printf("[save_figure_to_dzi] failed to write tile %s\n", path.c_str());
+      ok = ok && tile_ok;
+      written++;
+      if (tile_ok && is_uniform_tile)
+      {
+        std::lock_guard<std::mutex> lock(uniform_mutex);
+        uniform_tiles.emplace(uniform, path);
+      }
+    }
+
+    const std::vector<Instance> &instances;
+    Renderer renderer;
+    RenderSettings settings;
+    std::string tiles_dir;
+    int max_level = 0;
+    std::vector<int2> level_sizes;
+    std::vector<std::vector<int>> tile_instances; // for every tile of max_level
+    std::atomic<bool> ok{true};
+    std::atomic<int> written{0};
+    std::atomic<int> copied{0};
+    std::mutex uniform_mutex;
+    std::map<UniformTile, std::string> uniform_tiles; // encoded file of every uniform tile kind
+  };
+
+  // tiles directory is cleared before export, tiles of a previous one would show through
+  // the skipped ones. Only level directories with tiles are removed, returns false and
+  // removes nothing if the directory holds anything else
+  static bool clear_tiles_dir(const std::string &tiles_dir)
+  {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::exists(tiles_dir, ec))
+      return true;
+    if (!fs::is_directory(tiles_dir, ec))
+    {
+      printf("[save_figure_to_dzi] %s exists and is not a directory\n", tiles_dir.c_str());
+      return false;
+    }
+
+    auto is_number = [](const std::string &str)
+    { return !str.empty() && std::all_of(str.begin(), str.end(), [](unsigned char c) { return std::isdigit(c); }); };
+    std::vector<fs::path> levels;
+    for (const fs::directory_entry &level : fs::directory_iterator(tiles_dir, ec))
+    {
+      bool is_level = level.is_directory(ec) && is_number(level.path().filename().string());
+      if (is_level)
+        for (const fs::directory_entry &tile : fs::directory_iterator(level.path(), ec))
+        {
+          // tiles are named col_row.format
+          std::string name = tile.path().stem().string();
+          size_t sep = name.find('_');
+          is_level = is_level && tile.is_regular_file(ec) && sep != std::string::npos &&
+                     is_number(name.substr(0, sep)) && is_number(name.substr(sep + 1));
+        }
+      if (!is_level)
+      {
+        printf("[save_figure_to_dzi] %s is not a tile of a previous export, %s is left as is\n",
+               level.path().string().c_str(), tiles_dir.c_str());
+        return false;
+      }
+      levels.push_back(level.path());
+    }
+    for (const fs::path &level : levels)
+      fs::remove_all(level, ec);
+    return true;
+  }
+
+  bool save_figure_to_dzi(FigurePtr fig, const std::string &filename, const RenderSettings &settings)
+  {
+    // sets figure size
+    std::vector<Instance> instances = prepare_instances(fig);
+    CullStats stats = cull_instances(instances, fig->size);
+    if (fig->verbose)
+      printf("[save_figure_to_dzi] %d instances, %d off canvas, %d occluded, %d clipped\n",
+             stats.total, stats.off_canvas, stats.occluded, stats.clipped);
+    if (!is_valid_size(fig->size))
+    {
+      printf("[save_figure_to_dzi] figure has invalid size %dx%d\n", fig->size.x, fig->size.y);
+      return false;
+    }
+    if (settings.tile_format != "png" && !create_image_encoder(settings.tile_format, settings))
+    {
+      printf("[save_figure_to_dzi] unsupported tile format \"%s\"\n", settings.tile_format.c_str());
+      return false;
+    }
+
+    std::string base = filename.substr(0, filename.find_last_of("."));
+    std::string tiles_dir = base + "_files";
+    if (!clear_tiles_dir(tiles_dir))
+      return false;
+
+    FILE *file = fopen(filename.c_str(), "w");
+    if (!file)
+    {
+      printf("[save_figure_to_dzi] failed to open file %s\n", filename.c_str());
+      return false;
+    }
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                  "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"%s\" Overlap=\"0\" TileSize=\"%d\">\n"
+                  "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+                  "</Image>\n",
+            settings.tile_format.c_str(), DziPyramidWriter::TILE_SIZE, fig->size.x, fig->size.y);
+    fclose(file);
+
+    DziPyramidWriter writer(instances, fig->size, tiles_dir, settings);
+    bool ok = writer.write(std::max(1u, std::thread::hardware_concurrency()));
+    if (fig->verbose)
+      printf("[save_figure_to_dzi] %d levels, %d tiles written, %d of them copies of uniform tiles\n",
+             writer.levels(), writer.tiles_written(), writer.uniform_tiles_copied());
+    return ok;
+  }
+
+  void save_figure(FigurePtr fig, const std::string &filename, const RenderSettings &settings)
   {
     std::string ext = filename.substr(filename.find_last_of(".") + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
 
-    if (ext == "bmp" || ext == "png")
+    if (ext == "bmp")
     {
-      LiteImage::Image2D<float4> out = render_figure_to_image(fig);
+      LiteImage::Image2D<float4> out = render_figure_to_image(fig, settings);
       LiteImage::SaveImage(filename.c_str(), out);
     }
     else if (ext == "pdf")
     {
       save_figure_to_pdf(fig, filename);
     }
+    else if (ext == "svg")
+    {
+      save_figure_to_svg(fig, filename);
+    }
+    else if (ext == "dzi")
+    {
+      save_figure_to_dzi(fig, filename, settings);
+    }
+    else if (std::unique_ptr<ImageEncoder> encoder = create_image_encoder(ext, settings))
+    {
+      if (!settings.scaled_outputs.empty())
+        encoder = create_multi_resolution_writer(std::move(encoder), settings);
+      auto start = std::chrono::steady_clock::now();
+      double encode_ms = 0;
+      if (settings.band_height > 0)
+      {
+        render_figure_banded(fig, filename, *encoder, settings, &encode_ms);
+      }
+      else if (settings.framebuffer_format != FramebufferFormat::RGBA32F)
+      {
+        Framebuffer framebuffer = render_figure_to_framebuffer(fig, settings);
+        auto encode_start = std::chrono::steady_clock::now();
+        save_framebuffer(framebuffer, filename, *encoder);
+        encode_ms = milliseconds_since(encode_start);
+      }
+      else
+      {
+        LiteImage::Image2D<float4> out = render_figure_to_image(fig, settings);
+        auto encode_start = std::chrono::steady_clock::now();
+        save_image(out, filename, *encoder);
+        encode_ms = milliseconds_since(encode_start);
+      }
+      if (settings.verbose)
+        printf("[save_figure] %s: render %.1f ms, encode %.1f ms\n",
+               filename.c_str(), milliseconds_since(start) - encode_ms, encode_ms);
+    }
+    else
+    {
+      printf("[save_figure] unsupported file format \"%s\" (%s), supported are png, qoi, jpg, exr, bmp, pdf, svg and dzi\n",
+             ext.c_str(), filename.c_str());
+    }
   }
 
   void create_and_save_figure(const Block &blk, const std::string &filename)
@@ -480,7 +1283,27 @@ namespace LiteFigure
       return;
     }
 
-    save_figure(fig, filename);
+    save_figure(fig, filename, load_render_settings(&blk));
+  }
+
+  void watch_and_save_figure(const Block &blk, const std::string &filename, int interval_ms)
+  {
+    FigurePtr fig = create_figure_from_blk(&blk);
+
+    if (fig->getType() == FigureType::Unknown)
+    {
+      printf("[watch_and_save_figure] top level figure type is unknown, probably invalid blk\n");
+      return;
+    }
+
+    RenderSettings settings = load_render_settings(&blk);
+    save_figure(fig, filename, settings);
+    while (true)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+      if (fig->update())
+        save_figure(fig, filename, settings);
+    }
   }
 
   void create_and_save_multiple_figures(const Block &blk)
@@ -500,7 +1323,7 @@ namespace LiteFigure
       }
 
       FigurePtr fig = create_figure_from_blk(fig_blk);
-      save_figure(fig, filename);
+      save_figure(fig, filename, load_render_settings(fig_blk));
 
       fig_n++;
     }
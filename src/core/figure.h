@@ -1,10 +1,19 @@
 #pragma once
+#include <climits>
 #include <memory>
+#include <memory_resource>
 #include <vector>
 #include <string>
 
 #include "LiteMath/Image2d.h"
 #include "blk/blk.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+
+namespace csv
+{
+  struct Table;
+}
 
 namespace LiteFigure
 {
@@ -26,6 +35,15 @@ namespace LiteFigure
     Rectangle
   };
   
+  // pixels outside [p0, p1) are not written, in canvas pixels
+  struct ClipRect
+  {
+    int2 p0 = int2(0, 0);
+    int2 p1 = int2(INT_MAX, INT_MAX);
+
+    ClipRect intersect(int2 rect_min, int2 rect_max) const { return ClipRect{max(p0, rect_min), min(p1, rect_max)}; }
+  };
+
   struct Instance;
   struct Figure
   {
@@ -39,22 +57,98 @@ namespace LiteFigure
     // due to rounding errors or other constaints
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) = 0;
 
+    // memoized calculateSize, containers size their children only through it.
+    // A figure that was laid out and not changed since returns the remembered size
+    // if it is asked again for the same force_size, for its current size or for
+    // its own size (-1,-1), so nested containers are laid out in linear time.
+    // Remembered sizes belong to the layout epoch of the tree root, the outermost
+    // call passes it down to the nested ones
+    int2 layout(int2 force_size = int2(-1,-1));
+    // makes remembered sizes of the tree with this figure as a root invalid, must be
+    // called if the tree was changed after it was laid out. Containers call it when
+    // their children change, so the call reaches the root
+    void invalidate_layouts();
+
     // recursively prepares a set to instances (primitives + positions) to 
-    // render or somehow display this figure
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) = 0;
+    // render or somehow display this figure. Figure is not modified, everything
+    // that depends on placement (position, size, uv transform) goes to InstanceData.
+    // clip is the rect given by the containers above, it is set to instances when they are created
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) = 0;
 
     // loads figure data from blk, returns true on success
     virtual bool load(const Block *blk) = 0;
+
+    // reloads external data (e.g. csv files) that has changed since load,
+    // returns true if the figure has changed and should be rendered again
+    virtual bool update() { return false; }
     int2 size = int2(-1,-1);
     bool verbose = false;
+  private:
+    static thread_local const uint64_t *current_layout_epoch; // epoch of the tree being laid out
+    uint64_t tree_layout_epoch = 0;  // epoch of the tree if this figure is its root, 0 if not set yet
+    uint64_t layout_valid_epoch = 0; // epoch of remembered sizes, 0 if none
+    int2 layout_force_size = int2(-1,-1);
+    int2 layout_size = int2(-1,-1);
   };
   using FigurePtr = std::shared_ptr<Figure>;
 
+  // contiguous storage for nodes of one figure tree. Nodes are bump-allocated together
+  // with their reference counters, and memory is freed at once when the last node
+  // allocated from the arena is destroyed
+  class FigureArena
+  {
+  public:
+    template <typename T>
+    struct Allocator
+    {
+      using value_type = T;
+      Allocator(std::shared_ptr<FigureArena> _arena) : arena(_arena) {}
+      template <typename U>
+      Allocator(const Allocator<U> &other) : arena(other.arena) {}
+      T *allocate(size_t n) { return static_cast<T *>(arena->resource.allocate(n * sizeof(T), alignof(T))); }
+      void deallocate(T *, size_t) {} // memory is released with the arena
+      template <typename U>
+      bool operator==(const Allocator<U> &other) const { return arena == other.arena; }
+      template <typename U>
+      bool operator!=(const Allocator<U> &other) const { return arena != other.arena; }
+
+      std::shared_ptr<FigureArena> arena;
+    };
+
+    // while the scope exists, make_figure allocates nodes from the given arena
+    class Scope
+    {
+    public:
+      Scope(std::shared_ptr<FigureArena> arena) : prev(current_arena) { current_arena = arena; }
+      ~Scope() { current_arena = prev; }
+      Scope(const Scope &) = delete;
+      Scope &operator=(const Scope &) = delete;
+    private:
+      std::shared_ptr<FigureArena> prev;
+    };
+
+    static const std::shared_ptr<FigureArena> &current() { return current_arena; }
+
+  private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static thread_local std::shared_ptr<FigureArena> current_arena;
+    std::pmr::monotonic_buffer_resource resource{BLOCK_SIZE};
+  };
+
+  // creates figure node in the current arena, or on the heap if there is no arena
+  template <typename T, typename... Args>
+  std::shared_ptr<T> make_figure(Args &&...args)
+  {
+    if (FigureArena::current())
+      return std::allocate_shared<T>(FigureArena::Allocator<T>(FigureArena::current()), std::forward<Args>(args)...);
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  }
+
   struct Primitive : public Figure
   {
     virtual FigureType getType() const = 0;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
   };
 
   struct InstanceData
@@ -62,19 +156,23 @@ namespace LiteFigure
     int2 pos  = int2(0,0);
     int2 size = int2(-1,-1);
     LiteMath::float3x3 uv_transform = LiteMath::float3x3();
+    // pixels outside [clip_min, clip_max) are not written
+    int2 clip_min = int2(0, 0);
+    int2 clip_max = int2(INT_MAX, INT_MAX);
   };
   struct Instance
   {
-    Primitive *prim; //pointer to figure tree, no ownership
+    const Primitive *prim; //pointer to figure tree, no ownership
     InstanceData data;
   };
 
   struct Grid : public Figure
   {
     virtual FigureType getType() const override { return FigureType::Grid; }
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
     virtual bool load(const Block *blk) override;
+    virtual bool update() override;
 
     std::vector<std::vector<FigurePtr>> rows;
   };
@@ -91,9 +189,10 @@ namespace LiteFigure
     };
 
     virtual FigureType getType() const override { return FigureType::Collage; }
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
     virtual bool load(const Block *blk) override;
+    virtual bool update() override;
 
     std::vector<Element> elements;
   };
@@ -102,9 +201,10 @@ namespace LiteFigure
   struct Transform : public Figure
   {
     virtual FigureType getType() const override { return FigureType::Transform; }
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
     virtual bool load(const Block *blk) override;
+    virtual bool update() override;
 
     FigurePtr figure;
     std::shared_ptr<Rectangle> frame;
@@ -119,9 +219,13 @@ namespace LiteFigure
   {
     virtual FigureType getType() const override { return FigureType::PrimitiveImage; }
     virtual bool load(const Block *blk) override;
+    // decodes the image again if its file was edited since load
+    virtual bool update() override;
 
     LiteImage::Sampler sampler;
-    LiteImage::Image2D<float4> image;
+    std::shared_ptr<const LiteImage::Image2D<float4>> image; // shared by all images loaded from the same file
+    std::shared_ptr<Block> settings; // copy of blk the image was loaded from, used by update()
+    std::string file_version;        // modification time and size of the file the image was decoded from
   };
 
   struct PrimitiveFill : public Primitive
@@ -179,6 +283,19 @@ namespace LiteFigure
     bool antialiased = true;
   };
 
+  enum class FillRule
+  {
+    EvenOdd,
+    NonZero
+  };
+
+  enum class LineJoin
+  {
+    Miter,
+    Round,
+    Bevel
+  };
+
   struct Polygon : public Primitive
   {
     virtual FigureType getType() const override { return FigureType::Polygon; }
@@ -188,12 +305,21 @@ namespace LiteFigure
     {
       std::vector<float2> points; // in normalized coordinates (0..1)
     };
+    struct Edge
+    {
+      float2 p0, p1; // p0.y < p1.y
+      int winding;   // +1 if contour goes down (increasing y) along the edge, -1 otherwise
+    };
 
     float4 color = float4(0,0,0,1);
+    FillRule fill_rule = FillRule::EvenOdd;
+    bool antialiased = true;
     bool outline = false;
     float outline_thickness = 0.01f; // in normalized coordinates (0..1)
     bool  outline_antialiased = true;
+    LineJoin outline_join = LineJoin::Miter;
     std::vector<Contour> contours;
+    std::vector<Edge> edges; // non-horizontal edges of all contours sorted by p0.y, built on load
   };
 
   struct Glyph : public Primitive
@@ -225,7 +351,7 @@ namespace LiteFigure
   struct Text : public Figure
   {
     virtual FigureType getType() const override { return FigureType::Text; }
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
     virtual bool load(const Block *blk) override;
 
@@ -250,7 +376,7 @@ namespace LiteFigure
   {
     friend struct LinePlot; 
     virtual FigureType getType() const override { return FigureType::LineGraph; }
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
     virtual bool load(const Block *blk) override;
 
@@ -266,9 +392,13 @@ namespace LiteFigure
     bool load_line_params(const Block *blk);
     bool load_text_params(const Block *blk);
     void rebuid();
+    // adds values after the last one, only segments and points of new values are created
+    void append(const std::vector<float2> &new_values);
+    void add_segments_and_points(int first_value);
 
     Text base_text;
     std::shared_ptr<Collage> line_graph_collage;
+    std::shared_ptr<Collage> segments, points; // parts of line_graph_collage, before labels
   };
 
   enum class YLabelPosition
@@ -298,11 +428,31 @@ namespace LiteFigure
   struct LinePlot : public Figure
   {
     virtual FigureType getType() const override { return FigureType::LinePlot; }
-    virtual void prepareInstances(int2 pos, std::vector<Instance> &out_instances) override;
+    virtual void prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances) override;
     virtual int2 calculateSize(int2 force_size = int2(-1,-1)) override;
     virtual bool load(const Block *blk) override;
+    // parses only rows appended to csv files since the last load or update, their points
+    // are appended to graphs. Axes and ticks are rebuilt only if the range of values has changed
+    virtual bool update() override;
 
   private:
+    // "graphs" block loaded from a table, rows before row_count are already in source_graphs
+    struct TableGraphs
+    {
+      std::shared_ptr<const csv::Table> table; // the last seen one, later tables with more rows have its lineage
+      int row_count = 0;
+      int first_graph = 0;               // index of the first graph of the block in source_graphs
+      std::vector<uint32_t> group_codes; // group_by code of every graph of the block
+      bool appendable = false;           // every row is a point without label, new rows only add points
+    };
+
+    void load_graphs(const Block *blk);
+    // adds points of rows appended to the table to new_values (per graph in source_graphs),
+    // returns false if graphs have to be loaded again (e.g. a new group has appeared)
+    bool append_table_rows(const Block *blk, TableGraphs &source, std::vector<std::vector<float2>> &new_values);
+    bool build(const Block *blk);
+    float2 normalize_value(float2 val) const; // moves value to (0..1) range of plot body
+    void normalize_graphs();
     std::shared_ptr<Collage> create_legend_collage(const Block *blk, const Text &default_text,
                                                    const Line &default_line, int2 full_size);
     bool load_graphs_block(const Block *blk, const Text &default_text,
@@ -323,6 +473,20 @@ namespace LiteFigure
 
     std::vector<LineGraph> graphs;
 
+    std::shared_ptr<Block> settings; // copy of blk the plot was loaded from, used by update()
+    std::vector<TableGraphs> data_tables; // tables "graphs" blocks were loaded from
+    std::vector<LineGraph> source_graphs; // graphs with values in data units
+    int2 plot_size = int2(-1,-1);
+    float2 data_x_range, data_y_range; // range of values in source_graphs
+    float2 x_range, y_range;           // range of plot axes
+    bool x_use_log_scale = false;
+    bool y_use_log_scale = false;
+    float x_log_scale_base = 2.0f;
+    float y_log_scale_base = 2.0f;
+    std::string y_tick_format;
+
+    std::shared_ptr<Collage> body;
+    int body_graphs_offset = 0; // index of the first graph in body elements
     std::shared_ptr<Collage> full_graph_collage;
     //std::vector<Text> values;
     //PrimitiveFill legend_box;
@@ -333,10 +497,51 @@ namespace LiteFigure
   static bool is_valid_size(int2 size) { return size.x > 0 && size.y > 0; }
   static bool equal(int2 a, int2 b) { return a.x == b.x && a.y == b.y; }
 
+  // output options that do not change figure layout
+  struct RenderSettings
+  {
+    int msaa_samples = 0; // 4, 8 or 16 coverage samples per pixel, 0 - per-primitive antialiasing
+    int band_height = 0;  // if > 0, png is rendered and written band by band, full image is never in memory
+    FramebufferFormat framebuffer_format = FramebufferFormat::RGBA32F;
+    PngCompression png_compression = PngCompression::Fast;
+    int jpeg_quality = 90; // 1-100
+    bool verbose = false; // prints render and encode times
+    std::vector<ScaledOutput> scaled_outputs; // written from the same render, see MultiResolutionWriter
+    std::string tile_format = "png"; // format of deep zoom tiles, see save_figure_to_dzi
+  };
+  RenderSettings load_render_settings(const Block *blk);
+
   FigurePtr create_figure_from_blk(const Block *blk);
-  LiteImage::Image2D<float4> render_figure_to_image(FigurePtr figure);
+  LiteImage::Image2D<float4> render_figure_to_image(FigurePtr figure, const RenderSettings &settings = RenderSettings());
+  // renders figure band by band into a framebuffer of settings.framebuffer_format
+  Framebuffer render_figure_to_framebuffer(FigurePtr figure, const RenderSettings &settings);
+  // picks encoder by file extension (png, qoi, jpg, exr), returns nullptr for other formats
+  std::unique_ptr<ImageEncoder> create_image_encoder(const std::string &extension, const RenderSettings &settings);
+  // renders figure in horizontal bands of settings.band_height rows and streams them to encoder.
+  // encode_ms, if not null, receives the time spent in encoding
+  bool render_figure_banded(FigurePtr figure, const std::string &filename, ImageEncoder &encoder,
+                            const RenderSettings &settings, double *encode_ms = nullptr);
+  // writes deep zoom image: filename.dzi descriptor and 256x256 tiles of every zoom level
+  // in filename_files/<level>/<column>_<row>.<settings.tile_format>. Tiles of the full resolution
+  // level are rendered in parallel only from instances that touch them, coarser levels are
+  // box-filtered from finer ones, tiles where nothing is drawn are not written
+  bool save_figure_to_dzi(FigurePtr figure, const std::string &filename, const RenderSettings &settings);
   void create_and_save_multiple_figures(const Block &blk);
   void create_and_save_figure(const Block &blk, const std::string &filename);
+  // saves figure and saves it again every time its data files change, never returns
+  void watch_and_save_figure(const Block &blk, const std::string &filename, int interval_ms = 1000);
   std::vector<Instance> prepare_instances(FigurePtr figure);
+
+  struct CullStats
+  {
+    int total = 0;
+    int off_canvas = 0; // removed, nothing is visible on canvas
+    int occluded = 0;   // removed, fully covered by later opaque instances
+    int clipped = 0;    // partially visible, clip rect reduced to canvas
+  };
+  // removes instances that will not affect the final image, keeps order of the rest
+  CullStats cull_instances(std::vector<Instance> &instances, int2 canvas_size);
   void save_figure_to_pdf(FigurePtr fig, const std::string &filename);
+  // streams instances to svg as shapes, text and embedded png images, see svg_writer.cpp
+  void save_figure_to_svg(FigurePtr fig, const std::string &filename);
 }
\ No newline at end of file
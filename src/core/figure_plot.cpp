@@ -3,7 +3,10 @@
 #include "font.h"
 #include "csv/csv.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cmath>
+#include <filesystem>
 
 namespace LiteFigure
 {
@@ -125,31 +128,53 @@ namespace LiteFigure
     return true;
   }
 
-  void LineGraph::rebuid()
+  void LineGraph::add_segments_and_points(int first_value)
   {
-    line_graph_collage = std::make_shared<Collage>();
-    for (int i=0;i<values.size()-1;i++)
+    for (int i=std::max(first_value-1, 0);i+1<values.size();i++)
     {
-      std::shared_ptr<Line> line = std::make_shared<Line>();
+      std::shared_ptr<Line> line = make_figure<Line>();
       line->start = values[i];
       line->end = values[i+1];
       line->color = color;
       line->size = size;
       line->thickness = thickness;
-      line_graph_collage->elements.push_back(Collage::Element(int2(0,0), size, line));
+      segments->elements.push_back(Collage::Element(int2(0,0), size, line));
     }
     if (use_points)
     {
-      for (int i=0;i<values.size();i++)
+      for (int i=first_value;i<values.size();i++)
       {
-        std::shared_ptr<Circle> point = std::make_shared<Circle>();
+        std::shared_ptr<Circle> point = make_figure<Circle>();
         point->center = values[i];
         point->radius = point_size;
         point->color = color;
         point->size = size;
-        line_graph_collage->elements.push_back(Collage::Element(int2(0,0), size, point));
+        points->elements.push_back(Collage::Element(int2(0,0), size, point));
       }
     }
+  }
+
+  void LineGraph::append(const std::vector<float2> &new_values)
+  {
+    int first_value = values.size();
+    values.insert(values.end(), new_values.begin(), new_values.end());
+    // labels are placed over all values, they are rebuilt together with them
+    if (!line_graph_collage || !labels_str.empty())
+      rebuid();
+    else
+      add_segments_and_points(first_value);
+  }
+
+  void LineGraph::rebuid()
+  {
+    // segments are drawn below points, points below labels. Segments and points have their
+    // own collages, so that appended values add elements only to them
+    line_graph_collage = make_figure<Collage>();
+    segments = make_figure<Collage>();
+    points = make_figure<Collage>();
+    line_graph_collage->elements.push_back(Collage::Element(int2(0,0), size, segments));
+    line_graph_collage->elements.push_back(Collage::Element(int2(0,0), size, points));
+    add_segments_and_points(0);
     if (!labels_str.empty())
     {
       //there are the same number of labels as values
@@ -157,7 +182,7 @@ namespace LiteFigure
       {
         if (labels_str[i].empty())
           continue;
-        std::shared_ptr<Text> text = std::make_shared<Text>(base_text);
+        std::shared_ptr<Text> text = make_figure<Text>(base_text);
         text->text = labels_str[i];
         text->retain_height = false;
         text->retain_width = false;
@@ -176,13 +201,13 @@ namespace LiteFigure
   {
     if (!line_graph_collage)
       rebuid();
-    size = line_graph_collage->calculateSize(force_size);
+    size = line_graph_collage->layout(force_size);
     return size;
   }
 
-  void LineGraph::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+  void LineGraph::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
   {
-    line_graph_collage->prepareInstances(pos, out_instances);
+    line_graph_collage->prepareInstances(pos, clip, out_instances);
   }
 
   std::string default_format_from_range(float min, float max)
@@ -243,19 +268,19 @@ namespace LiteFigure
     float border_thickness = legend_blk->get_double("border_thickness", 0.01f);
     float4 border_color = legend_blk->get_vec4("border_color", float4(0,0,0,1));
 
-    std::shared_ptr<Grid> base_grid = std::make_shared<Grid>();
+    std::shared_ptr<Grid> base_grid = make_figure<Grid>();
     base_grid->rows.resize(graphs.size());
     for (int i=0;i<graphs.size();i++)
     {
       const auto &graph = graphs[i];
-      std::shared_ptr<Line> line = std::make_shared<Line>(default_line);
+      std::shared_ptr<Line> line = make_figure<Line>(default_line);
       line->size = int2(1,1);
       line->color = graph.color;
       line->thickness = graph.thickness;
       line->start = float2(0,0.5f);
       line->end = float2(line_length/(line_length+line_text_gap),0.5f);
 
-      std::shared_ptr<Text> text = std::make_shared<Text>(default_text);
+      std::shared_ptr<Text> text = make_figure<Text>(default_text);
       if (legend_blk->get_block("text"))
         text->load(legend_blk->get_block("text"));
       text->text = graph.name;
@@ -266,7 +291,7 @@ namespace LiteFigure
       base_grid->rows[i].push_back(text);
     }
 
-    std::shared_ptr<Collage> full_collage = std::make_shared<Collage>();
+    std::shared_ptr<Collage> full_collage = make_figure<Collage>();
     int2 base_size = base_grid->calculateSize();
 
     for (auto &row : base_grid->rows)
@@ -282,13 +307,13 @@ namespace LiteFigure
                           base_size.y*(1+2*vertical_gap));
     int2 base_pos = int2(base_size.x*horizontal_gap, base_size.y*vertical_gap);
 
-    std::shared_ptr<Rectangle> border = std::make_shared<Rectangle>();
+    std::shared_ptr<Rectangle> border = make_figure<Rectangle>();
     border->color = border_color;
     border->thickness = border_thickness;
     if (legend_blk->get_block("border"))
       border->load(legend_blk->get_block("border"));
 
-    std::shared_ptr<PrimitiveFill> background = std::make_shared<PrimitiveFill>();
+    std::shared_ptr<PrimitiveFill> background = make_figure<PrimitiveFill>();
     background->size = legend_size;
     background->color = float4(1,1,1,1);
     if (legend_blk->get_block("background"))
@@ -303,7 +328,6 @@ namespace LiteFigure
   bool LinePlot::load_graphs_block(const Block *blk, const Text &default_text,
                                    const Line &default_line, int2 full_size)
   {
-    std::shared_ptr<csv::Table> filtered_csv;
     const Block *data_blk = blk->get_block("data");
     if (!data_blk)
     {
@@ -311,89 +335,94 @@ namespace LiteFigure
       return false;
     }
 
+    // filtered rows are referenced by index, the table itself is not copied
+    csv::Slice slice = csv::load_csv_slice(data_blk);
+    data_tables.emplace_back();
+    TableGraphs &source = data_tables.back();
+    source.table = slice.data;
+    source.row_count = slice.row_mask.size();
+    source.first_graph = source_graphs.size();
+    if (!slice.data || slice.getRowCount() == 0 || slice.data->columns.size() == 0)
     {
-      csv::Slice slice = csv::load_csv_slice(data_blk);
-      if (!slice.data || slice.getRowCount() == 0 || slice.data->columns.size() == 0)
-      {
-        fprintf(stderr, "[LinePlot::load_graphs_block] csv load failed\n");
-        return false;
-      }
-      filtered_csv = slice.toTable();
+      fprintf(stderr, "[LinePlot::load_graphs_block] csv load failed\n");
+      return false;
     }
+    const csv::Table &table = *slice.data;
+    std::vector<int> rows = slice.getRowIndices();
 
     std::string group_by_col = blk->get_string("group_by");
     std::string names_col = blk->get_string("names");
     std::string labels_col = blk->get_string("labels");
     std::string x_values_col = blk->get_string("x_values");
     std::string y_values_col = blk->get_string("y_values");
+    std::string aggregate_by_col = blk->get_string("aggregate_by");
+    csv::Aggregation aggregation = (csv::Aggregation)blk->get_enum("aggregation", (uint32_t)csv::Aggregation::None);
 
-    std::map<std::string, std::vector<int>> group_map;
-    if (group_by_col == "")
-    {
-      std::vector<int> all_indices(filtered_csv->row_count);
-      for (int i = 0; i < filtered_csv->row_count; i++)
-        all_indices[i] = i;
-      group_map[""] = all_indices;
-    }
-    else
+    int group_idx = -1;
+    if (group_by_col != "")
     {
-      int group_idx = filtered_csv->get_column_idx(group_by_col);
+      group_idx = table.get_column_idx(group_by_col);
       if (group_idx == -1)
       {
         fprintf(stderr, "[LinePlot::load_graphs_block] group_by column \"%s\" is not found\n", group_by_col.c_str());
         return false;
       }
-
-      for (int i = 0; i < filtered_csv->row_count; i++)
-        group_map[filtered_csv->columns[group_idx][i]].push_back(i);
     }
 
-    std::vector<float> all_x_values, all_y_values;
-    std::vector<std::string> all_labels;
-    if (filtered_csv->get_column_idx(labels_col) != -1)
-    {
-      all_labels = filtered_csv->columns[filtered_csv->get_column_idx(labels_col)];
-    }
-    //else it is ok to have no labels
-
-    if (filtered_csv->get_column_idx(x_values_col) != -1)
-    {
-      all_x_values = csv::toFloatArray(filtered_csv->columns[filtered_csv->get_column_idx(x_values_col)]);
-    }
-    else
+    int x_idx = table.get_column_idx(x_values_col);
+    if (x_idx == -1)
     {
       fprintf(stderr, "[LinePlot::load_graphs_block] x_values column \"%s\" is not found\n", x_values_col.c_str());
       return false;
     }
 
-    if (filtered_csv->get_column_idx(y_values_col) != -1)
-    {
-      all_y_values = csv::toFloatArray(filtered_csv->columns[filtered_csv->get_column_idx(y_values_col)]);
-    }
-    else
+    int y_idx = table.get_column_idx(y_values_col);
+    if (y_idx == -1)
     {
       fprintf(stderr, "[LinePlot::load_graphs_block] y_values column \"%s\" is not found\n", y_values_col.c_str());
       return false;
     }
 
+    // points are merged by x value if aggregate_by is not set
+    int key_idx = -1;
+    if (aggregate_by_col != "")
+    {
+      key_idx = table.get_column_idx(aggregate_by_col);
+      if (key_idx == -1)
+      {
+        fprintf(stderr, "[LinePlot::load_graphs_block] aggregate_by column \"%s\" is not found\n", aggregate_by_col.c_str());
+        return false;
+      }
+    }
+
+    std::vector<csv::GroupedSeries> groups = csv::group_and_aggregate(table, rows, group_idx, key_idx, x_idx, y_idx, aggregation);
+    source.appendable = aggregation == csv::Aggregation::None && !blk->get_bool("labels_from_y_values", false);
+    for (auto &group : groups)
+      source.group_codes.push_back(group_idx == -1 ? 0 : table.coded(group_idx).codes[group.first_row]);
+
+    int labels_idx = table.get_column_idx(labels_col);
+    //it is ok to have no labels
+
     auto palette = get_palette((ColorPalette)blk->get_enum("palette", (uint32_t)ColorPalette::Set1));
 
-    int names_idx = filtered_csv->get_column_idx(names_col);
-    for (auto &p : group_map)
+    int names_idx = table.get_column_idx(names_col);
+    for (auto &group : groups)
     {
       LineGraph graph;
-      graph.color = palette[graphs.size()%palette.size()];
-      graph.name = names_idx == -1 ? ("Graph " + std::to_string(graphs.size())) : filtered_csv->columns[names_idx][p.second[0]];
+      graph.color = palette[source_graphs.size()%palette.size()];
+      graph.name = names_idx == -1 ? ("Graph " + std::to_string(source_graphs.size())) : table.value(names_idx, group.first_row);
       graph.labels_from_y_values = blk->get_bool("labels_from_y_values", graph.labels_from_y_values);
-      for (int idx : p.second)
+      for (int i = 0; i < group.point_rows.size(); i++)
       {
-        graph.values.push_back(float2(all_x_values[idx], all_y_values[idx]));
-        if (all_labels.size() > 0 && graph.labels_from_y_values)
-          graph.labels_str.push_back(all_labels[idx]);
+        float x = std::isnan(group.x[i]) ? 0.0f : group.x[i];
+        float y = std::isnan(group.y[i]) ? 0.0f : group.y[i];
+        graph.values.push_back(float2(x, y));
+        if (labels_idx != -1 && graph.labels_from_y_values)
+          graph.labels_str.push_back(table.value(labels_idx, group.point_rows[i]));
       }
       graph.load_line_params(blk->get_block("line"));
       graph.load_text_params(blk->get_block("text"));
-      graphs.push_back(graph);
+      source_graphs.push_back(graph);
     }
 
     return true;
@@ -436,23 +465,8 @@ namespace LiteFigure
     return v;
   }
 
-  bool LinePlot::load(const Block *blk)
+  static Text plot_default_text(const Block *blk)
   {
-    constexpr int MAX_TICK_TEXT_LEN = 16;
-
-    Block dummy_block;
-
-    size = blk->get_ivec2("size", size);
-    float4 background_color = blk->get_vec4("background_color", float4(1,1,1,1));
-    LegendPosition legend_position = LegendPosition::None;
-    float2 legend_pos = float2(1,1);
-    if (blk->get_block("legend"))
-    {
-      const Block *legend_blk = blk->get_block("legend");
-      legend_position = (LegendPosition)legend_blk->get_enum("position", (uint32_t)LegendPosition::InsideGraph);
-      legend_pos = legend_blk->get_vec2("pos", legend_pos);
-    }
-
     Text default_text;
     default_text.alignment_x = TextAlignmentX::Center;
     default_text.alignment_y = TextAlignmentY::Center;
@@ -463,28 +477,52 @@ namespace LiteFigure
     default_text.retain_width = false;
     default_text.size = int2(-1,-1);
     default_text.text = "???";
+    return default_text;
+  }
 
+  static Line plot_default_line(int2 size)
+  {
     Line default_line;
     default_line.size = size;
     default_line.antialiased = true;
     default_line.color = float4(0.25,0.25,0.25,1);
     default_line.style = LineStyle::Solid;
     default_line.thickness = 0.0033f;
+    return default_line;
+  }
 
-    background.color = background_color;
-
-    header = default_text;
-    header.retain_width = true;
-    header.retain_height = true;
-    header.alignment_y = TextAlignmentY::Top;
-    if (blk->get_block("header"))
+  static void values_range(const std::vector<LineGraph> &graphs, float2 &x_range, float2 &y_range)
+  {
+    x_range = float2(1e38f, -1e38f);
+    y_range = float2(1e38f, -1e38f);
+    for (const auto &graph : graphs)
     {
-      header.load(blk->get_block("header"));
+      for (int j = 0; j < graph.values.size(); j++)
+      {
+        x_range = float2(std::min(x_range.x, graph.values[j].x), std::max(x_range.y, graph.values[j].x));
+        y_range = float2(std::min(y_range.x, graph.values[j].y), std::max(y_range.y, graph.values[j].y));
+      }
     }
-    header.size = int2(size.x, 2*header.font_size);
+  }
+
+  bool LinePlot::load(const Block *blk)
+  {
+    settings = std::make_shared<Block>();
+    settings->copy(blk);
+    size = blk->get_ivec2("size", size);
+    plot_size = size;
+
+    load_graphs(blk);
+    return build(blk);
+  }
 
-    float2 x_range = float2(1e38f, -1e38f);
-    float2 y_range = float2(1e38f, -1e38f);
+  void LinePlot::load_graphs(const Block *blk)
+  {
+    Text default_text = plot_default_text(blk);
+    Line default_line = plot_default_line(plot_size);
+
+    source_graphs.clear();
+    data_tables.clear();
     for (int i=0;i<blk->size();i++)
     {
       if (!blk->get_block(i))
@@ -499,30 +537,222 @@ namespace LiteFigure
         if (!graph_is_ok)
           continue;
     
-        graphs.push_back(graph);
+        source_graphs.push_back(graph);
       }
       else if (blk->get_name(i) == "graphs") //load one or multiple line graphs from csv or similar data
       {
-        bool graphs_loaded = load_graphs_block(blk->get_block(i), default_text, default_line, size);
+        bool graphs_loaded = load_graphs_block(blk->get_block(i), default_text, default_line, plot_size);
         if (!graphs_loaded)
           printf("[LinePlot] Warning: failed to load line graphs from \"graphs\" block\n");
       }
     }
+  }
 
-    for (const auto &graph : graphs)
+  bool LinePlot::append_table_rows(const Block *blk, TableGraphs &source, std::vector<std::vector<float2>> &new_values)
+  {
+    csv::Slice slice = csv::load_csv_slice(blk->get_block("data"), source.row_count);
+    if (!slice.data || slice.data->lineage != source.table->lineage || slice.data->row_count < source.row_count)
+      return false;
+    const csv::Table &table = *slice.data;
+    int group_idx = blk->get_string("group_by") == "" ? -1 : table.get_column_idx(blk->get_string("group_by"));
+    int x_idx = table.get_column_idx(blk->get_string("x_values"));
+    int y_idx = table.get_column_idx(blk->get_string("y_values"));
+    if (x_idx == -1 || y_idx == -1)
+      return false;
+    const csv::Table::EncodedColumn *group_column = group_idx == -1 ? nullptr : &table.coded(group_idx);
+
+    for (int row : slice.getRowIndices())
     {
-      for (int j = 0; j < graph.values.size(); j++)
+      uint32_t group_code = group_column ? group_column->codes[row] : 0;
+      auto it = std::find(source.group_codes.begin(), source.group_codes.end(), group_code);
+      // a new group changes order and colors of graphs
+      if (it == source.group_codes.end())
+        return false;
+      float x = table.encoded[x_idx].numbers()[row];
+      float y = table.encoded[y_idx].numbers()[row];
+      new_values[source.first_graph + (it - source.group_codes.begin())].push_back(
+          float2(std::isnan(x) ? 0.0f : x, std::isnan(y) ? 0.0f : y));
+    }
+    source.table = slice.data;
+    source.row_count = slice.row_mask.size();
+    return true;
+  }
+
+  bool LinePlot::update()
+  {
+    if (!settings)
+      return false;
+
+    // tables are shared through csv cache. A table of a different lineage means that the file
+    // was rewritten, more rows in a table of the same lineage mean that rows were appended to it
+    bool reload = false;
+    bool appended = false;
+    std::vector<std::vector<float2>> new_values(source_graphs.size());
+    int table_id = 0;
+    for (int i = 0; i < settings->size() && !reload; i++)
+    {
+      if (!settings->get_block(i) || settings->get_name(i) != "graphs")
+        continue;
+      const Block *graphs_blk = settings->get_block(i);
+      const Block *data_blk = graphs_blk->get_block("data");
+      if (!data_blk)
+        continue;
+      if (table_id >= data_tables.size())
       {
-        x_range = float2(std::min(x_range.x, graph.values[j].x), std::max(x_range.y, graph.values[j].x));
-        y_range = float2(std::min(y_range.x, graph.values[j].y), std::max(y_range.y, graph.values[j].y));
+        reload = true;
+        break;
+      }
+      TableGraphs &source = data_tables[table_id++];
+      std::string path = data_blk->get_string("path", "");
+      if (!std::filesystem::exists(path))
+        continue;
+      std::shared_ptr<const csv::Table> table = csv::load_csv_cached(path);
+      if (table == source.table)
+        continue;
+      if (!table || !source.table || table->lineage != source.table->lineage)
+        reload = true;
+      else if (table->row_count != source.row_count)
+      {
+        if (source.appendable && append_table_rows(graphs_blk, source, new_values))
+          appended = true;
+        else
+          reload = true;
       }
+      else
+        source.table = table;
+    }
+    if (!reload && !appended)
+      return false;
+    invalidate_layouts();
+
+    if (!reload)
+    {
+      // graphs keep their order and names, only points are added
+      float2 new_x_range = data_x_range, new_y_range = data_y_range;
+      for (int i = 0; i < source_graphs.size(); i++)
+      {
+        for (float2 val : new_values[i])
+        {
+          new_x_range = float2(std::min(new_x_range.x, val.x), std::max(new_x_range.y, val.x));
+          new_y_range = float2(std::min(new_y_range.x, val.y), std::max(new_y_range.y, val.y));
+        }
+        source_graphs[i].values.insert(source_graphs[i].values.end(), new_values[i].begin(), new_values[i].end());
+      }
+      bool same_range = new_x_range.x == data_x_range.x && new_x_range.y == data_x_range.y &&
+                        new_y_range.x == data_y_range.x && new_y_range.y == data_y_range.y;
+      if (!same_range)
+        return build(settings.get());
+
+      for (int i = 0; i < source_graphs.size(); i++)
+      {
+        if (new_values[i].empty())
+          continue;
+        for (float2 &val : new_values[i])
+          val = normalize_value(val);
+        graphs[i].values.insert(graphs[i].values.end(), new_values[i].begin(), new_values[i].end());
+        // body graph shares segments and points with graphs[i], they are added once
+        std::static_pointer_cast<LineGraph>(body->elements[body_graphs_offset + i].figure)->append(new_values[i]);
+      }
+      return true;
     }
 
-    bool x_use_log_scale = blk->get_bool("x_use_log_scale", false);
-    float x_log_scale_base = blk->get_double("x_log_scale_base", 2.0f);
+    std::vector<LineGraph> old_graphs = std::move(source_graphs);
+    load_graphs(settings.get());
 
-    bool y_use_log_scale = blk->get_bool("y_use_log_scale", false);
-    float y_log_scale_base = blk->get_double("y_log_scale_base", 2.0f);
+    float2 new_x_range, new_y_range;
+    values_range(source_graphs, new_x_range, new_y_range);
+    bool same_legend = old_graphs.size() == source_graphs.size();
+    for (int i = 0; same_legend && i < source_graphs.size(); i++)
+      same_legend = old_graphs[i].name == source_graphs[i].name;
+
+    // axes, ticks and legend stay the same, only graphs in plot body are replaced
+    bool same_range = new_x_range.x == data_x_range.x && new_x_range.y == data_x_range.y &&
+                      new_y_range.x == data_y_range.x && new_y_range.y == data_y_range.y;
+    if (same_legend && same_range)
+    {
+      graphs = source_graphs;
+      normalize_graphs();
+      for (int i = 0; i < graphs.size(); i++)
+        body->elements[body_graphs_offset + i].figure = make_figure<LineGraph>(graphs[i]);
+      return true;
+    }
+
+    return build(settings.get());
+  }
+
+  float2 LinePlot::normalize_value(float2 val) const
+  {
+    return float2(val_to_rel_pos(val.x, x_range, x_use_log_scale, x_log_scale_base),
+                  1.0f - val_to_rel_pos(val.y, y_range, y_use_log_scale, y_log_scale_base));
+  }
+
+  void LinePlot::normalize_graphs()
+  {
+    constexpr int MAX_TICK_TEXT_LEN = 16;
+
+    for (auto &graph : graphs)
+    {
+      for (auto &val : graph.values)
+        val = normalize_value(val);
+      graph.size = plot_size;
+
+      // add labels from y values if needed
+      if (graph.labels_from_y_values)
+      {
+        for (float2 val : graph.values)
+        {
+          float y_real = rel_pos_to_val(1-val.y, y_range, y_use_log_scale, y_log_scale_base);
+          char buf[MAX_TICK_TEXT_LEN];
+          snprintf(buf, MAX_TICK_TEXT_LEN, y_tick_format.c_str(), y_real);
+          graph.labels_str.push_back(buf);
+        }
+      }
+      graph.rebuid();
+    }
+  }
+
+  bool LinePlot::build(const Block *blk)
+  {
+    constexpr int MAX_TICK_TEXT_LEN = 16;
+
+    Block dummy_block;
+
+    size = plot_size;
+    float4 background_color = blk->get_vec4("background_color", float4(1,1,1,1));
+    LegendPosition legend_position = LegendPosition::None;
+    float2 legend_pos = float2(1,1);
+    if (blk->get_block("legend"))
+    {
+      const Block *legend_blk = blk->get_block("legend");
+      legend_position = (LegendPosition)legend_blk->get_enum("position", (uint32_t)LegendPosition::InsideGraph);
+      legend_pos = legend_blk->get_vec2("pos", legend_pos);
+    }
+
+    Text default_text = plot_default_text(blk);
+    Line default_line = plot_default_line(size);
+
+    background.color = background_color;
+
+    header = default_text;
+    header.retain_width = true;
+    header.retain_height = true;
+    header.alignment_y = TextAlignmentY::Top;
+    if (blk->get_block("header"))
+    {
+      header.load(blk->get_block("header"));
+    }
+    header.size = int2(size.x, 2*header.font_size);
+
+    graphs = source_graphs;
+    values_range(graphs, data_x_range, data_y_range);
+    x_range = data_x_range;
+    y_range = data_y_range;
+
+    x_use_log_scale = blk->get_bool("x_use_log_scale", false);
+    x_log_scale_base = blk->get_double("x_log_scale_base", 2.0f);
+
+    y_use_log_scale = blk->get_bool("y_use_log_scale", false);
+    y_log_scale_base = blk->get_double("y_log_scale_base", 2.0f);
 
     //increase range by 5% on each side to make plot look nice
     //do similar thing in log scale too
@@ -563,7 +793,7 @@ namespace LiteFigure
       x_tick_count = x_ticks_blk->get_int("count", x_tick_count);
     }
 
-    std::string y_tick_format = default_format_from_range(y_range.x, y_range.y);
+    y_tick_format = default_format_from_range(y_range.x, y_range.y);
     std::vector<float> y_tick_values;
     std::vector<float> y_tick_positions; // from 0 to 1, relative positions of y ticks in the area, covered by graph
     int y_tick_count = 5;
@@ -598,16 +828,7 @@ namespace LiteFigure
       assert(y_range.x > 0);     
 
     //rescale values
-    for (auto &graph : graphs)
-    {
-      for (auto &val : graph.values)
-      {
-        val.x = val_to_rel_pos(val.x, x_range, x_use_log_scale, x_log_scale_base);
-        val.y = 1.0f - val_to_rel_pos(val.y, y_range, y_use_log_scale, y_log_scale_base);
-      }
-      graph.size = size;
-      graph.rebuid();
-    }
+    normalize_graphs();
 
     x_axis = default_line;
     x_axis.start = float2(0,1);
@@ -733,27 +954,12 @@ namespace LiteFigure
       int2 real_size = y_ticks[i].calculateSize();
     }
 
-    // add labels from y values if needed
-    for (auto &graph : graphs)
-    {
-      if (!graph.labels_from_y_values)
-        continue;
-      for (float2 val : graph.values)
-      {
-        float y_real = rel_pos_to_val(1-val.y, y_range, y_use_log_scale, y_log_scale_base);
-        char buf[MAX_TICK_TEXT_LEN];
-        snprintf(buf, MAX_TICK_TEXT_LEN, y_tick_format.c_str(), y_real);
-        graph.labels_str.push_back(buf);
-      }
-      graph.rebuid();
-    }
-
     FigurePtr legend = create_legend_collage(blk, default_text, default_line, size);
 
-    std::shared_ptr<Collage> body = std::make_shared<Collage>();
+    body = make_figure<Collage>();
     body->size = int2(size.x, size.y);
     {
-      std::shared_ptr<PrimitiveFill> fill = std::make_shared<PrimitiveFill>();
+      std::shared_ptr<PrimitiveFill> fill = make_figure<PrimitiveFill>();
       fill->size = size;
       fill->color = background_color;
       Collage::Element elem;
@@ -767,7 +973,7 @@ namespace LiteFigure
       Collage::Element elem;
       elem.pos = int2(0,0);
       elem.size = int2(size.x, size.y);
-      elem.figure = std::make_shared<Line>(line);
+      elem.figure = make_figure<Line>(line);
       body->elements.push_back(elem);
     }
     for (auto &line : y_tick_lines)
@@ -775,15 +981,16 @@ namespace LiteFigure
       Collage::Element elem;
       elem.pos = int2(0,0);
       elem.size = int2(size.x, size.y);
-      elem.figure = std::make_shared<Line>(line);
+      elem.figure = make_figure<Line>(line);
       body->elements.push_back(elem);
     }
+    body_graphs_offset = body->elements.size();
     for (auto &graph : graphs)
     {
       Collage::Element elem;
       elem.pos = int2(0,0);
       elem.size = int2(size.x, size.y);
-      elem.figure = std::make_shared<LineGraph>(graph);
+      elem.figure = make_figure<LineGraph>(graph);
       body->elements.push_back(elem);
     }
     {
@@ -791,7 +998,7 @@ namespace LiteFigure
       Collage::Element elem;
       elem.pos = int2(0,offset);
       elem.size = int2(size.x, size.y-offset);
-      elem.figure = std::make_shared<Line>(x_axis);
+      elem.figure = make_figure<Line>(x_axis);
       body->elements.push_back(elem);
     }
     {
@@ -799,7 +1006,7 @@ namespace LiteFigure
       Collage::Element elem;
       elem.pos = int2(offset,0);
       elem.size = int2(size.x-offset, size.y);
-      elem.figure = std::make_shared<Line>(y_axis);
+      elem.figure = make_figure<Line>(y_axis);
       body->elements.push_back(elem);
     }
     if (legend_position == LegendPosition::InsideGraph)
@@ -813,7 +1020,7 @@ namespace LiteFigure
       body->elements.push_back(elem); 
     }
 
-    std::shared_ptr<Collage> y_ticks_collage = std::make_shared<Collage>();
+    std::shared_ptr<Collage> y_ticks_collage = make_figure<Collage>();
     y_ticks_collage->elements.resize(y_tick_values.size());
     int y_ticks_collage_max_w = 0;
     for (int i = 0; i < y_tick_values.size(); i++)
@@ -822,7 +1029,7 @@ namespace LiteFigure
       Collage::Element elem;
       elem.pos = int2(0, size.y - center - y_ticks[i].size.y);
       elem.size = y_ticks[i].size;
-      elem.figure = std::make_shared<Text>(y_ticks[i]);
+      elem.figure = make_figure<Text>(y_ticks[i]);
       y_ticks_collage->elements[i] = elem;
       y_ticks_collage_max_w = std::max(y_ticks_collage_max_w, y_ticks[i].size.x);
     }
@@ -831,21 +1038,21 @@ namespace LiteFigure
     y_axis_separator.size = int2(y_label.font_size/2, size.y);
     y_axis_separator.color = background_color;
 
-    std::shared_ptr<Grid> y_axis_grid = std::make_shared<Grid>();
+    std::shared_ptr<Grid> y_axis_grid = make_figure<Grid>();
     y_axis_grid->rows.resize(1);
     if (y_axis_label_position == YLabelPosition::Left)
     {
-      y_axis_grid->rows[0].push_back(std::make_shared<Text>(y_label));
-      y_axis_grid->rows[0].push_back(std::make_shared<PrimitiveFill>(y_axis_separator));
+      y_axis_grid->rows[0].push_back(make_figure<Text>(y_label));
+      y_axis_grid->rows[0].push_back(make_figure<PrimitiveFill>(y_axis_separator));
     }
     y_axis_grid->rows[0].push_back(y_ticks_collage);
-    y_axis_grid->rows[0].push_back(std::make_shared<PrimitiveFill>(y_axis_separator));
+    y_axis_grid->rows[0].push_back(make_figure<PrimitiveFill>(y_axis_separator));
     int y_axis_grid_width = y_axis_grid->calculateSize().x;
 
-    std::shared_ptr<Collage> x_ticks_collage = std::make_shared<Collage>();
+    std::shared_ptr<Collage> x_ticks_collage = make_figure<Collage>();
     x_ticks_collage->elements.resize(x_tick_values.size()+1);    
     {
-      auto pf = std::make_shared<PrimitiveFill>();
+      auto pf = make_figure<PrimitiveFill>();
       pf->color = background_color;
       Collage::Element elem;
       elem.pos = int2(0,0.5f*x_ticks[0].font_size);
@@ -860,26 +1067,26 @@ namespace LiteFigure
       Collage::Element elem;
       elem.pos = int2(y_axis_grid_width+center-sh,0);
       elem.size = x_ticks[i].size;
-      elem.figure = std::make_shared<Text>(x_ticks[i]);
+      elem.figure = make_figure<Text>(x_ticks[i]);
       x_ticks_collage->elements[i+1] = elem;
     }
 
-    std::shared_ptr<Grid> graph_grid = std::make_shared<Grid>();
+    std::shared_ptr<Grid> graph_grid = make_figure<Grid>();
     graph_grid->rows.resize(3);
     graph_grid->rows[0].push_back(y_axis_grid);
     graph_grid->rows[0].push_back(body);
     graph_grid->rows[1].push_back(x_ticks_collage);
-    graph_grid->rows[2].push_back(std::make_shared<Text>(x_label));
+    graph_grid->rows[2].push_back(make_figure<Text>(x_label));
 
-    std::shared_ptr<Grid> full_graph_grid = std::make_shared<Grid>();
+    std::shared_ptr<Grid> full_graph_grid = make_figure<Grid>();
     full_graph_grid->rows.resize(2);
     if (y_axis_label_position == YLabelPosition::Top)
     {
       y_label.size = int2(-1,header.calculateSize().y - std::min(y_label.font_size, header.font_size)/2);
       y_label.alignment_y = TextAlignmentY::Bottom;
-      full_graph_grid->rows[0].push_back(std::make_shared<Text>(y_label));
+      full_graph_grid->rows[0].push_back(make_figure<Text>(y_label));
     }
-    full_graph_grid->rows[0].push_back(std::make_shared<Text>(header));
+    full_graph_grid->rows[0].push_back(make_figure<Text>(header));
     if (legend_position == LegendPosition::TopLeft)
     {
       full_graph_grid->rows[1].push_back(legend);
@@ -887,7 +1094,7 @@ namespace LiteFigure
     else if (legend_position == LegendPosition::BottomLeft)
     {
       int2 legend_size = legend->calculateSize();
-      std::shared_ptr<Collage> legend_collage = std::make_shared<Collage>();
+      std::shared_ptr<Collage> legend_collage = make_figure<Collage>();
       legend_collage->elements.push_back(Collage::Element{int2(0,size.y - legend_size.y), legend_size, legend});
       full_graph_grid->rows[1].push_back(legend_collage);
     }
@@ -899,7 +1106,7 @@ namespace LiteFigure
     else if (legend_position == LegendPosition::BottomRight)
     {
       int2 legend_size = legend->calculateSize();
-      std::shared_ptr<Collage> legend_collage = std::make_shared<Collage>();
+      std::shared_ptr<Collage> legend_collage = make_figure<Collage>();
       legend_collage->elements.push_back(Collage::Element{int2(0,size.y - legend_size.y), legend_size, legend});
       full_graph_grid->rows[1].push_back(legend_collage);
     }
@@ -909,11 +1116,11 @@ namespace LiteFigure
     int2 sz_full = int2(sz_grid.x*(1+padding.x+padding.z), sz_grid.y*(1+padding.y+padding.w));
     int2 pos_plot = int2(sz_grid.x*padding.x, sz_grid.y*padding.y);
 
-    full_graph_collage = std::make_shared<Collage>();
+    full_graph_collage = make_figure<Collage>();
     full_graph_collage->elements.resize(2);
     full_graph_collage->elements[0].pos = int2(0,0);
     full_graph_collage->elements[0].size = sz_full;
-    full_graph_collage->elements[0].figure = std::make_shared<PrimitiveFill>(background);
+    full_graph_collage->elements[0].figure = make_figure<PrimitiveFill>(background);
     full_graph_collage->elements[1].pos = pos_plot;
     full_graph_collage->elements[1].size = sz_grid;
     full_graph_collage->elements[1].figure = full_graph_grid;
@@ -921,11 +1128,11 @@ namespace LiteFigure
     return true;
   }
   
-  void LinePlot::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+  void LinePlot::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
   {
     //all text must be rendered on top of ther elements
     std::vector<Instance> local_instances;
-    full_graph_collage->prepareInstances(pos, local_instances);
+    full_graph_collage->prepareInstances(pos, clip, local_instances);
 
     //first, add everything except text
     for (auto &it : local_instances)
@@ -947,7 +1154,7 @@ namespace LiteFigure
     if (!is_valid_size(force_size) && is_valid_size(size))
       force_size = size;
     
-    size = full_graph_collage->calculateSize(force_size);
+    size = full_graph_collage->layout(force_size);
     return size;
   }
 }
\ No newline at end of file
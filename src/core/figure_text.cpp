@@ -236,6 +236,8 @@ namespace LiteFigure
 		}
 		if (!equal(prev_size, size) || glyphs.empty())
 		size = placeGlyphs();
+		background_fill.size = size;
+		background_fill.color = background_color;
 		if (verbose)
 		{
 			printf("[Text %s] size %d %d font size %d\n", text.c_str(), size.x, size.y, font_size);
@@ -243,18 +245,19 @@ namespace LiteFigure
 		return size;
 	}
 
-	void Text::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+	void Text::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
 	{
 		if (background_color.w > 0)
 		{
-			background_fill.size = size;
-			background_fill.color = background_color;
 			Instance inst;
 			inst.prim = &background_fill;
 			inst.data.pos = pos;
 			inst.data.size = size;
+			inst.data.clip_min = clip.p0;
+			inst.data.clip_max = clip.p1;
 			out_instances.push_back(inst);
 		}
+		// glyphs are not clipped, their outlines can slightly exceed text size, which is based on advance width
 		for (int i = 0; i < glyphs.size(); i++)
 		{
 			Glyph &glyph = glyphs[i];
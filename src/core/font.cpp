@@ -5,6 +5,7 @@
 #include <map>
 #include <fstream>
 #include <filesystem>
+#include <mutex>
 
 namespace LiteFigure
 {
@@ -102,7 +103,10 @@ namespace LiteFigure
 
   const Font &get_font(const std::string &filename)
   {
+    // tiles are rendered on several threads, map nodes are stable so returned reference stays valid
     static std::map<std::string, Font> font_cache;
+    static std::mutex font_cache_mutex;
+    std::lock_guard<std::mutex> lock(font_cache_mutex);
     auto it = font_cache.find(filename);
     if (it == font_cache.end())
     {
@@ -0,0 +1,166 @@
+#include "framebuffer.h"
+#include "image_writer.h"
+#include <cstring>
+
+namespace LiteFigure
+{
+  static constexpr float FRAMEBUFFER_GAMMA = 2.2f;
+
+  // round to nearest even, values that do not fit become infinity
+  static inline uint16_t float_to_half(float f)
+  {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t mag = x & 0x7FFFFFFF;
+    if (mag >= 0x7F800000) // inf or nan
+      return sign | 0x7C00 | (mag > 0x7F800000 ? 0x200 : 0);
+    if (mag >= 0x477FF000) // rounds above max half
+      return sign | 0x7C00;
+    if (mag < 0x38800000) // subnormal half, scaling by 2^24 is exact
+    {
+      float v;
+      memcpy(&v, &mag, 4);
+      return sign | uint16_t(std::nearbyint(v * 16777216.0f));
+    }
+    uint32_t h = (mag - 0x38000000) >> 13;
+    const uint32_t rest = mag & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+      h++;
+    return sign | h;
+  }
+
+  static inline float half_to_float(uint16_t h)
+  {
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1F;
+    const uint32_t mant = h & 0x3FF;
+    uint32_t x;
+    if (exp == 0)
+    {
+      float v = mant * (1.0f / 16777216.0f);
+      memcpy(&x, &v, 4);
+      x |= sign;
+    }
+    else if (exp == 31)
+      x = sign | 0x7F800000 | (mant << 13);
+    else
+      x = sign | ((exp + 112) << 23) | (mant << 13);
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+  }
+
+  static const float *gamma_decode_table()
+  {
+    static const std::vector<float> table = []()
+    {
+      std::vector<float> t(256);
+      for (int i = 0; i < 256; i++)
+        t[i] = std::pow(i / 255.0f, FRAMEBUFFER_GAMMA);
+      return t;
+    }();
+    return table.data();
+  }
+
+  int Framebuffer::pixel_size(FramebufferFormat format)
+  {
+    switch (format)
+    {
+    case FramebufferFormat::RGBA16F: return 4 * sizeof(uint16_t);
+    case FramebufferFormat::RGBA8: return 4;
+    default: return sizeof(float4);
+    }
+  }
+
+  Framebuffer::Framebuffer(int width, int height, FramebufferFormat format)
+  {
+    w = std::max(width, 0);
+    h = std::max(height, 0);
+    fmt = format;
+    pixels.assign(size_t(w) * h * pixel_size(fmt), 0);
+  }
+
+  void Framebuffer::store_rows(const LiteImage::Image2D<float4> &band, int first_row, int rows)
+  {
+    const float gamma_inv = 1.0f / FRAMEBUFFER_GAMMA;
+    const size_t count = size_t(w) * rows;
+    const float4 *src = band.data();
+    uint8_t *dst = pixels.data() + size_t(w) * first_row * pixel_size(fmt);
+    if (fmt == FramebufferFormat::RGBA32F)
+    {
+      memcpy(dst, src, count * sizeof(float4));
+    }
+    else if (fmt == FramebufferFormat::RGBA16F)
+    {
+      uint16_t *dst16 = (uint16_t *)dst;
+      for (size_t i = 0; i < count; i++)
+      {
+        dst16[4 * i + 0] = float_to_half(src[i].x);
+        dst16[4 * i + 1] = float_to_half(src[i].y);
+        dst16[4 * i + 2] = float_to_half(src[i].z);
+        dst16[4 * i + 3] = float_to_half(src[i].w);
+      }
+    }
+    else
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        dst[4 * i + 0] = tonemap_to_byte(src[i].x, gamma_inv);
+        dst[4 * i + 1] = tonemap_to_byte(src[i].y, gamma_inv);
+        dst[4 * i + 2] = tonemap_to_byte(src[i].z, gamma_inv);
+        dst[4 * i + 3] = uint8_t(std::min(255, std::max(0, int(src[i].w * 255.0f + 0.5f))));
+      }
+    }
+  }
+
+  void Framebuffer::load_rows(int first_row, int rows, LiteImage::Image2D<float4> &band) const
+  {
+    const size_t count = size_t(w) * rows;
+    const uint8_t *src = pixels.data() + size_t(w) * first_row * pixel_size(fmt);
+    float4 *dst = band.data();
+    if (fmt == FramebufferFormat::RGBA32F)
+    {
+      memcpy(dst, src, count * sizeof(float4));
+    }
+    else if (fmt == FramebufferFormat::RGBA16F)
+    {
+      const uint16_t *src16 = (const uint16_t *)src;
+      for (size_t i = 0; i < count; i++)
+        dst[i] = float4(half_to_float(src16[4 * i + 0]), half_to_float(src16[4 * i + 1]),
+                        half_to_float(src16[4 * i + 2]), half_to_float(src16[4 * i + 3]));
+    }
+    else
+    {
+      const float *decode = gamma_decode_table();
+      for (size_t i = 0; i < count; i++)
+        dst[i] = float4(decode[src[4 * i + 0]], decode[src[4 * i + 1]], decode[src[4 * i + 2]], src[4 * i + 3] / 255.0f);
+    }
+  }
+
+  void Framebuffer::encode_rows(int first_row, int rows, std::vector<uint8_t> &out_rgba) const
+  {
+    if (fmt == FramebufferFormat::RGBA8)
+    {
+      // already encoded, saved images are opaque
+      const size_t count = size_t(w) * rows;
+      out_rgba.resize(4 * count);
+      memcpy(out_rgba.data(), pixels.data() + 4 * size_t(w) * first_row, 4 * count);
+      for (size_t i = 0; i < count; i++)
+        out_rgba[4 * i + 3] = 255;
+    }
+    else
+    {
+      LiteImage::Image2D<float4> band(w, rows);
+      load_rows(first_row, rows, band);
+      tonemap_rows(band, 0, rows, out_rgba, FRAMEBUFFER_GAMMA);
+    }
+  }
+
+  LiteImage::Image2D<float4> Framebuffer::to_image() const
+  {
+    LiteImage::Image2D<float4> image(w, h);
+    load_rows(0, h, image);
+    return image;
+  }
+}
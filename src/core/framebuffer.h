@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "LiteMath/Image2d.h"
+
+namespace LiteFigure
+{
+  using LiteMath::float4;
+
+  enum class FramebufferFormat
+  {
+    RGBA32F, // reference, 16 bytes per pixel
+    RGBA16F, // half floats, 8 bytes per pixel
+    RGBA8    // gamma-encoded color and linear alpha, 4 bytes per pixel, same encoding as saved images
+  };
+
+  // render target with compact pixel storage. Figures are rasterized in float into a small band
+  // buffer and every finished band is quantized (rounded to nearest) into the framebuffer
+  class Framebuffer
+  {
+  public:
+    Framebuffer() = default;
+    Framebuffer(int width, int height, FramebufferFormat format);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    FramebufferFormat format() const { return fmt; }
+    size_t bytes() const { return pixels.size(); }
+    static int pixel_size(FramebufferFormat format);
+
+    // stores rows [0, rows) of band as rows [first_row, first_row+rows) of framebuffer
+    void store_rows(const LiteImage::Image2D<float4> &band, int first_row, int rows);
+    // decodes rows [first_row, first_row+rows) to rows [0, rows) of band
+    void load_rows(int first_row, int rows, LiteImage::Image2D<float4> &band) const;
+    // converts rows to tightly packed opaque RGBA8, as LiteImage::SaveImage does
+    void encode_rows(int first_row, int rows, std::vector<uint8_t> &out_rgba) const;
+    LiteImage::Image2D<float4> to_image() const;
+
+  private:
+    int w = 0;
+    int h = 0;
+    FramebufferFormat fmt = FramebufferFormat::RGBA32F;
+    std::vector<uint8_t> pixels;
+  };
+}
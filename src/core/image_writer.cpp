@@ -0,0 +1,1204 @@
+#include "image_writer.h"
+#include <atomic>
+#include <cstring>
+#include <queue>
+#include <thread>
+
+#include "stb_image_write.h"
+#include "tinyexr.h"
+
+namespace LiteFigure
+{
+  // thresholds[k] is the smallest value converted to byte k or larger by tonemap_to_byte.
+  // Binary search over them gives exactly the same bytes without calling pow per channel
+  struct TonemapThresholds
+  {
+    float thresholds[256];
+
+    TonemapThresholds(float gamma)
+    {
+      const float gamma_inv = 1.0f / gamma;
+      thresholds[0] = -INFINITY;
+      for (int k = 1; k < 256; k++)
+      {
+        // tonemap_to_byte is monotonic, so bisect over bit patterns of non-negative floats
+        uint32_t lo = 0, hi = 0x7F800000;
+        while (lo < hi)
+        {
+          uint32_t mid = lo + (hi - lo) / 2;
+          float x;
+          memcpy(&x, &mid, 4);
+          if (tonemap_to_byte(x, gamma_inv) >= k)
+            hi = mid;
+          else
+            lo = mid + 1;
+        }
+        memcpy(&thresholds[k], &lo, 4);
+      }
+    }
+
+    uint8_t operator()(float x) const
+    {
+      int k = 0;
+      for (int step = 128; step > 0; step >>= 1)
+        k += (x >= thresholds[k + step]) ? step : 0;
+      return k;
+    }
+  };
+
+  static void tonemap_pixels(const float4 *src, size_t count, uint8_t *dst, float gamma)
+  {
+    static const TonemapThresholds default_tonemap(2.2f);
+    const TonemapThresholds &tonemap = gamma == 2.2f ? default_tonemap : TonemapThresholds(gamma);
+    for (size_t i = 0; i < count; i++)
+    {
+      dst[4 * i + 0] = tonemap(src[i].x);
+      dst[4 * i + 1] = tonemap(src[i].y);
+      dst[4 * i + 2] = tonemap(src[i].z);
+      dst[4 * i + 3] = 255;
+    }
+  }
+
+  void tonemap_rows(const LiteImage::Image2D<float4> &image, int first_row, int rows,
+                    std::vector<uint8_t> &out_rgba, float gamma)
+  {
+    const size_t count = size_t(image.width()) * rows;
+    out_rgba.resize(4 * count);
+    tonemap_pixels(image.data() + size_t(first_row) * image.width(), count, out_rgba.data(), gamma);
+  }
+
+  void write_float_rows(ImageEncoder &encoder, const float4 *pixels, int width, int rows)
+  {
+    if (encoder.is_hdr())
+    {
+      encoder.write_float_rows(pixels, rows);
+    }
+    else
+    {
+      std::vector<uint8_t> rgba(4 * size_t(width) * rows);
+      tonemap_pixels(pixels, size_t(width) * rows, rgba.data(), 2.2f);
+      encoder.write_rows(rgba.data(), rows);
+    }
+  }
+
+  void write_image_rows(ImageEncoder &encoder, const LiteImage::Image2D<float4> &image, int first_row, int rows)
+  {
+    write_float_rows(encoder, image.data() + size_t(first_row) * image.width(), image.width(), rows);
+  }
+
+  BoxDownscaler::BoxDownscaler(int _src_width, int _src_height, int _dst_width, int _dst_height)
+      : src_width(_src_width), src_height(_src_height), dst_width(_dst_width), dst_height(_dst_height)
+  {
+    // positions are kept in units of 1/src_width (1/src_height), so all overlaps are exact
+    x_splits.resize(src_width);
+    for (int x = 0; x < src_width; x++)
+    {
+      const int64_t begin = int64_t(x) * dst_width;
+      const int64_t end = begin + dst_width;
+      const int first = begin / src_width;
+      const int64_t boundary = int64_t(first + 1) * src_width;
+      x_splits[x].first = first;
+      x_splits[x].w0 = float(std::min(end, boundary) - begin) / src_width;
+      x_splits[x].w1 = float(std::max<int64_t>(end - boundary, 0)) / src_width;
+    }
+    row.resize(dst_width + 1);
+    acc[0].assign(dst_width, float4(0, 0, 0, 0));
+    acc[1].assign(dst_width, float4(0, 0, 0, 0));
+  }
+
+  void BoxDownscaler::add_rows(const float4 *pixels, int rows, std::vector<float4> &out_rows)
+  {
+    for (int r = 0; r < rows && src_row < src_height; r++, src_row++)
+    {
+      const float4 *src = pixels + size_t(r) * src_width;
+      std::fill(row.begin(), row.end(), float4(0, 0, 0, 0));
+      for (int x = 0; x < src_width; x++)
+      {
+        const Split &s = x_splits[x];
+        row[s.first] += s.w0 * src[x];
+        row[s.first + 1] += s.w1 * src[x];
+      }
+
+      const int64_t begin = int64_t(src_row) * dst_height;
+      const int64_t end = begin + dst_height;
+      const int64_t boundary = int64_t(dst_row + 1) * src_height;
+      const float w0 = float(std::min(end, boundary) - begin) / src_height;
+      const float w1 = float(std::max<int64_t>(end - boundary, 0)) / src_height;
+      for (int i = 0; i < dst_width; i++)
+      {
+        acc[0][i] += w0 * row[i];
+        acc[1][i] += w1 * row[i];
+      }
+      if (end >= boundary)
+      {
+        // destination row is complete
+        out_rows.insert(out_rows.end(), acc[0].begin(), acc[0].end());
+        std::swap(acc[0], acc[1]);
+        std::fill(acc[1].begin(), acc[1].end(), float4(0, 0, 0, 0));
+        dst_row++;
+      }
+    }
+  }
+
+  void MultiResolutionWriter::add_output(const ScaledOutput &spec, std::unique_ptr<ImageEncoder> encoder)
+  {
+    outputs.push_back({spec, std::move(encoder), nullptr});
+  }
+
+  bool MultiResolutionWriter::open(const std::string &filename, int width, int height)
+  {
+    if (!main->open(filename, width, height))
+      return false;
+    src_width = width;
+    for (Output &output : outputs)
+    {
+      // missing side keeps the aspect ratio
+      const ScaledOutput &spec = output.spec;
+      int w = spec.width, h = spec.height;
+      if (w <= 0 && h <= 0)
+      {
+        w = std::lround(width * spec.scale);
+        h = std::lround(height * spec.scale);
+      }
+      else if (w <= 0)
+        w = std::lround(double(width) * h / height);
+      else if (h <= 0)
+        h = std::lround(double(height) * w / width);
+      w = std::max(w, 1);
+      h = std::max(h, 1);
+      if (w > width || h > height)
+      {
+        printf("[MultiResolutionWriter::open] %s: %dx%d is larger than the image (%dx%d), only downscaling is supported\n",
+               spec.path.c_str(), w, h, width, height);
+        continue;
+      }
+      if (output.encoder->open(spec.path, w, h))
+        output.downscaler = std::make_unique<BoxDownscaler>(width, height, w, h);
+    }
+    return true;
+  }
+
+  void MultiResolutionWriter::write_float_rows(const float4 *pixels, int rows)
+  {
+    LiteFigure::write_float_rows(*main, pixels, src_width, rows);
+    for (Output &output : outputs)
+    {
+      if (!output.downscaler)
+        continue;
+      scaled_rows.clear();
+      output.downscaler->add_rows(pixels, rows, scaled_rows);
+      const int w = output.downscaler->width();
+      if (!scaled_rows.empty())
+        LiteFigure::write_float_rows(*output.encoder, scaled_rows.data(), w, scaled_rows.size() / w);
+    }
+  }
+
+  bool MultiResolutionWriter::close()
+  {
+    bool ok = main->close();
+    for (Output &output : outputs)
+    {
+      if (output.downscaler)
+        ok = output.encoder->close() && ok;
+    }
+    return ok;
+  }
+
+  static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+  {
+    static const std::vector<uint32_t> table = []()
+    {
+      std::vector<uint32_t> t(256);
+      for (uint32_t i = 0; i < 256; i++)
+      {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+          c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        t[i] = c;
+      }
+      return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+      crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+  }
+
+  static constexpr int DEFLATE_WINDOW = 1 << 15;
+  static constexpr int MIN_MATCH = 3;
+  static constexpr int MAX_MATCH = 258;
+
+  static const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                       3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+  static const int DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                    8193, 12289, 16385, 24577};
+  static const int DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                     7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+  static const int CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+  static inline int length_code(int length)
+  {
+    return int(std::upper_bound(LENGTH_BASE, LENGTH_BASE + 29, length) - LENGTH_BASE) - 1;
+  }
+
+  static inline int dist_code(int dist)
+  {
+    return int(std::upper_bound(DIST_BASE, DIST_BASE + 30, dist) - DIST_BASE) - 1;
+  }
+
+  struct BitWriter
+  {
+    std::vector<uint8_t> &out;
+    uint64_t buffer = 0;
+    int count = 0;
+
+    BitWriter(std::vector<uint8_t> &_out) : out(_out) {}
+
+    void put(uint32_t value, int bits)
+    {
+      buffer |= uint64_t(value) << count;
+      count += bits;
+      while (count >= 8)
+      {
+        out.push_back(buffer & 0xFF);
+        buffer >>= 8;
+        count -= 8;
+      }
+    }
+
+    void align()
+    {
+      if (count > 0)
+        put(0, 8 - count);
+    }
+  };
+
+  // Huffman code lengths limited to max_bits, frequencies are halved until the tree fits
+  static void build_code_lengths(const uint32_t *freq, int n, int max_bits, uint8_t *lengths)
+  {
+    std::vector<uint32_t> f(freq, freq + n);
+    std::fill(lengths, lengths + n, 0);
+    while (true)
+    {
+      std::vector<int> symbols;
+      for (int i = 0; i < n; i++)
+        if (f[i] > 0)
+          symbols.push_back(i);
+      if (symbols.empty())
+        return;
+      if (symbols.size() == 1)
+      {
+        lengths[symbols[0]] = 1;
+        return;
+      }
+
+      // leaves first, then internal nodes in creation order, so parents always have larger indices
+      const int leaves = symbols.size();
+      std::vector<uint64_t> weight(2 * leaves - 1);
+      std::vector<int> parent(2 * leaves - 1, -1);
+      using Item = std::pair<uint64_t, int>;
+      std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+      for (int i = 0; i < leaves; i++)
+      {
+        weight[i] = f[symbols[i]];
+        queue.push({weight[i], i});
+      }
+      for (int node = leaves; node < 2 * leaves - 1; node++)
+      {
+        Item a = queue.top();
+        queue.pop();
+        Item b = queue.top();
+        queue.pop();
+        weight[node] = a.first + b.first;
+        parent[a.second] = node;
+        parent[b.second] = node;
+        queue.push({weight[node], node});
+      }
+      std::vector<int> depth(2 * leaves - 1, 0);
+      int max_depth = 0;
+      for (int node = 2 * leaves - 3; node >= 0; node--)
+      {
+        depth[node] = depth[parent[node]] + 1;
+        max_depth = std::max(max_depth, depth[node]);
+      }
+      if (max_depth <= max_bits)
+      {
+        for (int i = 0; i < leaves; i++)
+          lengths[symbols[i]] = depth[i];
+        return;
+      }
+      for (int i = 0; i < n; i++)
+        f[i] = (f[i] + 1) / 2;
+    }
+  }
+
+  // canonical codes, stored bit-reversed as deflate writes them starting from the most significant bit
+  static void build_codes(const uint8_t *lengths, int n, uint16_t *codes)
+  {
+    int bl_count[16] = {0};
+    for (int i = 0; i < n; i++)
+      bl_count[lengths[i]]++;
+    bl_count[0] = 0;
+    int next_code[16] = {0};
+    for (int bits = 1, code = 0; bits < 16; bits++)
+    {
+      code = (code + bl_count[bits - 1]) << 1;
+      next_code[bits] = code;
+    }
+    for (int i = 0; i < n; i++)
+    {
+      int len = lengths[i];
+      if (len == 0)
+        continue;
+      uint32_t code = next_code[len]++;
+      uint32_t reversed = 0;
+      for (int b = 0; b < len; b++)
+        reversed |= ((code >> b) & 1) << (len - 1 - b);
+      codes[i] = reversed;
+    }
+  }
+
+  struct Token
+  {
+    uint16_t value; // literal or match length
+    uint16_t dist;  // 0 for literals
+  };
+
+  static void write_block(const Token *tokens, size_t count, bool final, BitWriter &bits)
+  {
+    uint32_t lit_freq[286] = {0};
+    uint32_t dist_freq[30] = {0};
+    for (size_t i = 0; i < count; i++)
+    {
+      if (tokens[i].dist == 0)
+        lit_freq[tokens[i].value]++;
+      else
+      {
+        lit_freq[257 + length_code(tokens[i].value)]++;
+        dist_freq[dist_code(tokens[i].dist)]++;
+      }
+    }
+    lit_freq[256] = 1;
+
+    uint8_t fixed_lit_len[288], fixed_dist_len[30];
+    for (int i = 0; i < 288; i++)
+      fixed_lit_len[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    std::fill(fixed_dist_len, fixed_dist_len + 30, 5);
+
+    // both codes have to be complete, so at least two symbols are used in each
+    uint32_t lit_tree_freq[286], dist_tree_freq[30];
+    std::copy(lit_freq, lit_freq + 286, lit_tree_freq);
+    std::copy(dist_freq, dist_freq + 30, dist_tree_freq);
+    if (std::count_if(lit_tree_freq, lit_tree_freq + 286, [](uint32_t f) { return f > 0; }) < 2)
+      lit_tree_freq[lit_tree_freq[0] == 0 ? 0 : 1] = 1;
+    for (int i = 0; std::count_if(dist_tree_freq, dist_tree_freq + 30, [](uint32_t f) { return f > 0; }) < 2; i++)
+      dist_tree_freq[i] = std::max(dist_tree_freq[i], 1u);
+    uint8_t lit_len[286], dist_len[30];
+    build_code_lengths(lit_tree_freq, 286, 15, lit_len);
+    build_code_lengths(dist_tree_freq, 30, 15, dist_len);
+
+    int hlit = 286;
+    while (hlit > 257 && lit_len[hlit - 1] == 0)
+      hlit--;
+    int hdist = 30;
+    while (hdist > 1 && dist_len[hdist - 1] == 0)
+      hdist--;
+
+    // run-length encoded code lengths, symbols 16-18 repeat previous length or zeros
+    std::vector<uint8_t> lengths(lit_len, lit_len + hlit);
+    lengths.insert(lengths.end(), dist_len, dist_len + hdist);
+    std::vector<std::pair<uint8_t, uint8_t>> rle; // symbol, extra bits value
+    for (size_t i = 0; i < lengths.size();)
+    {
+      size_t run = 1;
+      while (i + run < lengths.size() && lengths[i + run] == lengths[i])
+        run++;
+      size_t left = run;
+      if (lengths[i] == 0)
+      {
+        while (left >= 11)
+        {
+          size_t n = std::min<size_t>(left, 138);
+          rle.push_back({18, uint8_t(n - 11)});
+          left -= n;
+        }
+        if (left >= 3)
+        {
+          rle.push_back({17, uint8_t(left - 3)});
+          left = 0;
+        }
+      }
+      else
+      {
+        rle.push_back({lengths[i], 0});
+        left--;
+        while (left >= 3)
+        {
+          size_t n = std::min<size_t>(left, 6);
+          rle.push_back({16, uint8_t(n - 3)});
+          left -= n;
+        }
+      }
+      for (; left > 0; left--)
+        rle.push_back({lengths[i], 0});
+      i += run;
+    }
+    uint32_t cl_freq[19] = {0};
+    for (auto &r : rle)
+      cl_freq[r.first]++;
+    uint8_t cl_len[19];
+    build_code_lengths(cl_freq, 19, 7, cl_len);
+    int hclen = 19;
+    while (hclen > 4 && cl_len[CODE_LENGTH_ORDER[hclen - 1]] == 0)
+      hclen--;
+
+    // extra bits are the same for both codes and are not counted
+    uint64_t fixed_cost = 3, dynamic_cost = 3 + 5 + 5 + 4 + 3 * hclen;
+    for (int i = 0; i < 286; i++)
+    {
+      fixed_cost += uint64_t(lit_freq[i]) * fixed_lit_len[i];
+      dynamic_cost += uint64_t(lit_freq[i]) * lit_len[i];
+    }
+    for (int i = 0; i < 30; i++)
+    {
+      fixed_cost += uint64_t(dist_freq[i]) * fixed_dist_len[i];
+      dynamic_cost += uint64_t(dist_freq[i]) * dist_len[i];
+    }
+    for (auto &r : rle)
+      dynamic_cost += cl_len[r.first] + (r.first == 16 ? 2 : r.first == 17 ? 3 : r.first == 18 ? 7 : 0);
+
+    uint16_t lit_code[288] = {0}, dist_code_bits[30] = {0};
+    const uint8_t *lit_lengths = lit_len;
+    const uint8_t *dist_lengths = dist_len;
+    bits.put(final ? 1 : 0, 1);
+    if (fixed_cost <= dynamic_cost)
+    {
+      bits.put(1, 2);
+      lit_lengths = fixed_lit_len;
+      dist_lengths = fixed_dist_len;
+      build_codes(fixed_lit_len, 288, lit_code);
+      build_codes(fixed_dist_len, 30, dist_code_bits);
+    }
+    else
+    {
+      bits.put(2, 2);
+      bits.put(hlit - 257, 5);
+      bits.put(hdist - 1, 5);
+      bits.put(hclen - 4, 4);
+      for (int i = 0; i < hclen; i++)
+        bits.put(cl_len[CODE_LENGTH_ORDER[i]], 3);
+      uint16_t cl_code[19] = {0};
+      build_codes(cl_len, 19, cl_code);
+      for (auto &r : rle)
+      {
+        bits.put(cl_code[r.first], cl_len[r.first]);
+        if (r.first == 16)
+          bits.put(r.second, 2);
+        else if (r.first == 17)
+          bits.put(r.second, 3);
+        else if (r.first == 18)
+          bits.put(r.second, 7);
+      }
+      build_codes(lit_len, 286, lit_code);
+      build_codes(dist_len, 30, dist_code_bits);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      const Token &t = tokens[i];
+      if (t.dist == 0)
+      {
+        bits.put(lit_code[t.value], lit_lengths[t.value]);
+        continue;
+      }
+      int l = length_code(t.value);
+      bits.put(lit_code[257 + l], lit_lengths[257 + l]);
+      bits.put(t.value - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+      int d = dist_code(t.dist);
+      bits.put(dist_code_bits[d], dist_lengths[d]);
+      bits.put(t.dist - DIST_BASE[d], DIST_EXTRA[d]);
+    }
+    bits.put(lit_code[256], lit_lengths[256]);
+  }
+
+  // compresses data[history, history+size), the first history bytes are only used as a dictionary.
+  // Output is byte aligned, a non-final chunk ends with an empty stored block (sync flush)
+  static void deflate_chunk(const uint8_t *data, size_t history, size_t size, bool final,
+                            PngCompression compression, std::vector<uint8_t> &out)
+  {
+    constexpr int HASH_BITS = 15;
+    constexpr size_t BLOCK_TOKENS = 1 << 15;
+    const bool small = compression == PngCompression::Small;
+    const int max_chain = small ? 256 : 8;
+    const int nice_length = small ? MAX_MATCH : 32;
+
+    const size_t total = history + size;
+    std::vector<int32_t> head(1 << HASH_BITS, -1);
+    std::vector<int32_t> prev(total, -1);
+    auto hash = [&](size_t p)
+    { return ((data[p] << 10) ^ (data[p + 1] << 5) ^ data[p + 2]) & ((1 << HASH_BITS) - 1); };
+    auto insert = [&](size_t p)
+    {
+      if (p + MIN_MATCH > total)
+        return;
+      int h = hash(p);
+      prev[p] = head[h];
+      head[h] = p;
+    };
+    auto find_match = [&](size_t p, int &best_len, int &best_dist)
+    {
+      best_len = 0;
+      best_dist = 0;
+      const int max_len = std::min<size_t>(MAX_MATCH, total - p);
+      if (max_len < MIN_MATCH)
+        return;
+      int32_t candidate = head[hash(p)];
+      for (int chain = 0; chain < max_chain && candidate >= 0 && p - candidate <= DEFLATE_WINDOW; chain++)
+      {
+        const uint8_t *a = data + candidate;
+        const uint8_t *b = data + p;
+        if (a[best_len] == b[best_len])
+        {
+          int len = 0;
+          while (len < max_len && a[len] == b[len])
+            len++;
+          if (len > best_len)
+          {
+            best_len = len;
+            best_dist = int(p - candidate);
+            if (len >= nice_length || len == max_len)
+              break;
+          }
+        }
+        candidate = prev[candidate];
+      }
+      // short far matches cost more than literals
+      if (best_len < MIN_MATCH || (best_len == MIN_MATCH && best_dist > 4096))
+        best_len = 0;
+    };
+
+    for (size_t p = history > DEFLATE_WINDOW ? history - DEFLATE_WINDOW : 0; p < history; p++)
+      insert(p);
+
+    BitWriter bits(out);
+    std::vector<Token> tokens;
+    tokens.reserve(BLOCK_TOKENS);
+    size_t p = history;
+    while (p < total)
+    {
+      int len, dist;
+      find_match(p, len, dist);
+      if (len > 0 && small && len < nice_length && p + 1 < total)
+      {
+        // lazy matching: a literal followed by a longer match is better
+        insert(p);
+        int next_len, next_dist;
+        find_match(p + 1, next_len, next_dist);
+        if (next_len > len)
+        {
+          tokens.push_back({data[p], 0});
+          p++;
+          len = next_len;
+          dist = next_dist;
+          insert(p);
+        }
+        tokens.push_back({uint16_t(len), uint16_t(dist)});
+        for (size_t i = p + 1; i < p + len; i++)
+          insert(i);
+        p += len;
+      }
+      else if (len > 0)
+      {
+        tokens.push_back({uint16_t(len), uint16_t(dist)});
+        for (size_t i = p; i < p + len; i++)
+          insert(i);
+        p += len;
+      }
+      else
+      {
+        tokens.push_back({data[p], 0});
+        insert(p);
+        p++;
+      }
+
+      if (tokens.size() >= BLOCK_TOKENS)
+      {
+        write_block(tokens.data(), tokens.size(), final && p == total, bits);
+        tokens.clear();
+      }
+    }
+
+    if (!tokens.empty() || (final && size == 0))
+      write_block(tokens.data(), tokens.size(), final, bits);
+    if (!final)
+    {
+      bits.put(0, 3);
+      bits.align();
+      const uint8_t sync[4] = {0x00, 0x00, 0xFF, 0xFF};
+      out.insert(out.end(), sync, sync + 4);
+    }
+    bits.align();
+  }
+
+  // zlib stream assembled from chunks compressed in parallel. Every chunk is primed with the
+  // last 32KB of data before it, so matches are not lost at chunk boundaries
+  class ZlibStream
+  {
+  public:
+    ZlibStream(std::vector<uint8_t> &_out, PngCompression _compression, int _threads)
+        : out(_out), compression(_compression), threads(_threads)
+    {
+      out.push_back(0x78); // deflate, 32KB window
+      out.push_back(_compression == PngCompression::Small ? 0xDA : 0x01);
+    }
+
+    void write(const uint8_t *data, size_t size)
+    {
+      update_adler(data, size);
+      buffer.insert(buffer.end(), data, data + size);
+      if (buffer.size() - history >= size_t(threads) * CHUNK_SIZE)
+        compress(false);
+    }
+
+    void finish()
+    {
+      compress(true);
+      uint32_t adler = (adler_b << 16) | adler_a;
+      for (int i = 3; i >= 0; i--)
+        out.push_back((adler >> (8 * i)) & 0xFF);
+    }
+
+  private:
+    static constexpr size_t CHUNK_SIZE = 1 << 18;
+
+    void update_adler(const uint8_t *data, size_t size)
+    {
+      // 5552 is the largest n for which sums do not overflow before the modulo
+      while (size > 0)
+      {
+        size_t n = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < n; i++)
+        {
+          adler_a += data[i];
+          adler_b += adler_a;
+        }
+        adler_a %= 65521;
+        adler_b %= 65521;
+        data += n;
+        size -= n;
+      }
+    }
+
+    void compress(bool final)
+    {
+      const size_t size = buffer.size() - history;
+      const int chunks = std::max<int>(1, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+      std::vector<std::vector<uint8_t>> compressed(chunks);
+      parallel_for(chunks, threads, [&](int i)
+                   {
+                     size_t begin = history + i * CHUNK_SIZE;
+                     size_t chunk_size = std::min(CHUNK_SIZE, buffer.size() - begin);
+                     size_t dictionary = std::min<size_t>(begin, DEFLATE_WINDOW);
+                     deflate_chunk(buffer.data() + begin - dictionary, dictionary, chunk_size,
+                                   final && i == chunks - 1, compression, compressed[i]); });
+      for (auto &c : compressed)
+        out.insert(out.end(), c.begin(), c.end());
+
+      // only the last window is kept as a dictionary for the next chunks
+      if (buffer.size() > DEFLATE_WINDOW)
+        buffer.erase(buffer.begin(), buffer.end() - DEFLATE_WINDOW);
+      history = buffer.size();
+    }
+
+    std::vector<uint8_t> &out;
+    PngCompression compression;
+    int threads;
+    std::vector<uint8_t> buffer; // dictionary of history bytes followed by data to compress
+    size_t history = 0;
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+  };
+
+  static inline uint8_t paeth(int a, int b, int c)
+  {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+      return a;
+    return pb <= pc ? b : c;
+  }
+
+  // applies png filter TYPE to row, prev is the previous row (zeros for the first one).
+  // Writes the result to out if it is not null and returns the sum of absolute values of filtered bytes
+  template <int TYPE, size_t bpp>
+  static uint64_t filter_row(const uint8_t *row, const uint8_t *prev, size_t size, uint8_t *out)
+  {
+    uint64_t score = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+      int a = i >= bpp ? row[i - bpp] : 0;
+      int b = prev[i];
+      int c = i >= bpp ? prev[i - bpp] : 0;
+      uint8_t v;
+      if (TYPE == 0)
+        v = row[i];
+      else if (TYPE == 1)
+        v = row[i] - a;
+      else if (TYPE == 2)
+        v = row[i] - b;
+      else if (TYPE == 3)
+        v = row[i] - ((a + b) >> 1);
+      else
+        v = row[i] - paeth(a, b, c);
+      score += std::abs((int8_t)v);
+      if (out)
+        out[i] = v;
+    }
+    return score;
+  }
+
+  template <size_t bpp>
+  static uint64_t filter_row(int type, const uint8_t *row, const uint8_t *prev, size_t size, uint8_t *out)
+  {
+    switch (type)
+    {
+    case 0: return filter_row<0, bpp>(row, prev, size, out);
+    case 1: return filter_row<1, bpp>(row, prev, size, out);
+    case 2: return filter_row<2, bpp>(row, prev, size, out);
+    case 3: return filter_row<3, bpp>(row, prev, size, out);
+    default: return filter_row<4, bpp>(row, prev, size, out);
+    }
+  }
+
+  // writes filter byte and filtered row to out, the filter with the smallest sum of absolute values
+  // is chosen, as most encoders do
+  template <size_t bpp>
+  static void filter_row_adaptive(const uint8_t *row, const uint8_t *prev, size_t size, uint8_t *out)
+  {
+    int best_type = 0;
+    uint64_t best_score = UINT64_MAX;
+    for (int type = 0; type < 5; type++)
+    {
+      uint64_t score = filter_row<bpp>(type, row, prev, size, nullptr);
+      if (score < best_score)
+      {
+        best_score = score;
+        best_type = type;
+      }
+    }
+    out[0] = best_type;
+    filter_row<bpp>(best_type, row, prev, size, out + 1);
+  }
+
+  void zlib_compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, PngCompression compression, int threads)
+  {
+    ZlibStream zlib(out, compression, std::max(threads, 1));
+    zlib.write(data, size);
+    zlib.finish();
+  }
+
+  void compress_png_rows(const uint8_t *pixels, int width, int height, int channels, std::vector<uint8_t> &out,
+                         PngCompression compression, int threads)
+  {
+    const size_t row_size = size_t(width) * channels;
+    std::vector<uint8_t> filtered(height * (row_size + 1));
+    std::vector<uint8_t> zero_row(row_size, 0);
+    for (int y = 0; y < height; y++)
+    {
+      const uint8_t *row = pixels + y * row_size;
+      const uint8_t *prev = y == 0 ? zero_row.data() : row - row_size;
+      uint8_t *dst = filtered.data() + y * (row_size + 1);
+      if (channels == 4)
+        filter_row_adaptive<4>(row, prev, row_size, dst);
+      else if (channels == 3)
+        filter_row_adaptive<3>(row, prev, row_size, dst);
+      else
+        filter_row_adaptive<1>(row, prev, row_size, dst);
+    }
+    zlib_compress(filtered.data(), filtered.size(), out, compression, threads);
+  }
+
+  static void append_png_chunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, size_t size)
+  {
+    for (int i = 0; i < 4; i++)
+      out.push_back((size >> (24 - 8 * i)) & 0xFF);
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    uint32_t crc = crc32(0, out.data() + out.size() - size - 4, size + 4);
+    for (int i = 0; i < 4; i++)
+      out.push_back((crc >> (24 - 8 * i)) & 0xFF);
+  }
+
+  void encode_png(const uint8_t *pixels, int width, int height, int channels, std::vector<uint8_t> &out,
+                  PngCompression compression, int threads)
+  {
+    static const uint8_t color_types[5] = {0, 0 /*gray*/, 0, 2 /*RGB*/, 6 /*RGBA*/};
+    std::vector<uint8_t> idat;
+    compress_png_rows(pixels, width, height, channels, idat, compression, threads);
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.assign(signature, signature + 8);
+    uint8_t ihdr[13] = {0};
+    for (int i = 0; i < 4; i++)
+    {
+      ihdr[i] = (width >> (24 - 8 * i)) & 0xFF;
+      ihdr[4 + i] = (height >> (24 - 8 * i)) & 0xFF;
+    }
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = color_types[channels];
+    append_png_chunk(out, "IHDR", ihdr, 13);
+    append_png_chunk(out, "IDAT", idat.data(), idat.size());
+    append_png_chunk(out, "IEND", nullptr, 0);
+  }
+
+  PngStreamWriter::PngStreamWriter(PngCompression _compression, int _threads) : compression(_compression), threads(_threads) {}
+
+  PngStreamWriter::~PngStreamWriter()
+  {
+    if (file)
+      close();
+  }
+
+  bool PngStreamWriter::open(const std::string &filename, int _width, int _height)
+  {
+    if (_width <= 0 || _height <= 0)
+    {
+      printf("[PngStreamWriter::open] invalid image size %dx%d\n", _width, _height);
+      return false;
+    }
+    file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+      printf("[PngStreamWriter::open] cannot open file %s\n", filename.c_str());
+      return false;
+    }
+    width = _width;
+    height = _height;
+    rows_written = 0;
+    ok = true;
+    prev_row.assign(4 * size_t(width), 0);
+    idat.clear();
+    if (threads <= 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    zlib = std::make_unique<ZlibStream>(idat, compression, threads);
+
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    ok = fwrite(signature, 1, 8, file) == 8;
+
+    uint8_t ihdr[13] = {0};
+    for (int i = 0; i < 4; i++)
+    {
+      ihdr[i] = (width >> (24 - 8 * i)) & 0xFF;
+      ihdr[4 + i] = (height >> (24 - 8 * i)) & 0xFF;
+    }
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = 6; // RGBA
+    write_chunk("IHDR", ihdr, 13);
+    return ok;
+  }
+
+  void PngStreamWriter::write_rows(const uint8_t *rgba, int rows)
+  {
+    if (!file)
+      return;
+    rows = std::min(rows, height - rows_written);
+    const size_t row_size = 4 * size_t(width);
+    filtered.resize(rows * (row_size + 1));
+
+    // rows only depend on the unfiltered previous row, so they are filtered independently
+    constexpr int ROWS_PER_TASK = 16;
+    const int tasks = (rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    parallel_for(tasks, threads, [&](int task)
+                 {
+      for (int y = task * ROWS_PER_TASK; y < std::min(rows, (task + 1) * ROWS_PER_TASK); y++)
+      {
+        const uint8_t *row = rgba + y * row_size;
+        const uint8_t *prev = y == 0 ? prev_row.data() : row - row_size;
+        filter_row_adaptive<4>(row, prev, row_size, filtered.data() + y * (row_size + 1));
+      } });
+    if (rows > 0)
+      memcpy(prev_row.data(), rgba + (rows - 1) * row_size, row_size);
+    zlib->write(filtered.data(), filtered.size());
+    rows_written += rows;
+    flush_idat(false);
+  }
+
+  bool PngStreamWriter::close()
+  {
+    if (!file)
+      return false;
+    if (rows_written < height)
+    {
+      printf("[PngStreamWriter::close] only %d of %d rows were written\n", rows_written, height);
+      ok = false;
+    }
+    zlib->finish();
+    flush_idat(true);
+    write_chunk("IEND", nullptr, 0);
+    ok = (fclose(file) == 0) && ok;
+    file = nullptr;
+    zlib.reset();
+    return ok;
+  }
+
+  void PngStreamWriter::flush_idat(bool all)
+  {
+    constexpr size_t IDAT_SIZE = 1 << 16;
+    size_t written = 0;
+    while (idat.size() - written >= IDAT_SIZE || (all && written < idat.size()))
+    {
+      size_t size = std::min(IDAT_SIZE, idat.size() - written);
+      write_chunk("IDAT", idat.data() + written, size);
+      written += size;
+    }
+    idat.erase(idat.begin(), idat.begin() + written);
+  }
+
+  void PngStreamWriter::write_chunk(const char *type, const uint8_t *data, size_t size)
+  {
+    uint8_t header[8];
+    for (int i = 0; i < 4; i++)
+    {
+      header[i] = (size >> (24 - 8 * i)) & 0xFF;
+      header[4 + i] = type[i];
+    }
+    uint32_t crc = crc32(0, header + 4, 4);
+    if (size > 0)
+      crc = crc32(crc, data, size);
+    uint8_t footer[4];
+    for (int i = 0; i < 4; i++)
+      footer[i] = (crc >> (24 - 8 * i)) & 0xFF;
+
+    ok = ok && fwrite(header, 1, 8, file) == 8;
+    ok = ok && (size == 0 || fwrite(data, 1, size, file) == size);
+    ok = ok && fwrite(footer, 1, 4, file) == 4;
+  }
+
+  QoiStreamWriter::~QoiStreamWriter()
+  {
+    if (file)
+      close();
+  }
+
+  bool QoiStreamWriter::open(const std::string &filename, int _width, int _height)
+  {
+    if (_width <= 0 || _height <= 0)
+    {
+      printf("[QoiStreamWriter::open] invalid image size %dx%d\n", _width, _height);
+      return false;
+    }
+    file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+      printf("[QoiStreamWriter::open] cannot open file %s\n", filename.c_str());
+      return false;
+    }
+    width = _width;
+    height = _height;
+    rows_written = 0;
+    std::fill(index, index + 64, 0);
+    prev = 0xFF000000;
+    run = 0;
+
+    uint8_t header[14] = {'q', 'o', 'i', 'f'};
+    for (int i = 0; i < 4; i++)
+    {
+      header[4 + i] = (width >> (24 - 8 * i)) & 0xFF;
+      header[8 + i] = (height >> (24 - 8 * i)) & 0xFF;
+    }
+    header[12] = 3; // RGB, saved images are opaque
+    header[13] = 0; // sRGB with linear alpha
+    ok = fwrite(header, 1, 14, file) == 14;
+    return ok;
+  }
+
+  void QoiStreamWriter::flush_run()
+  {
+    if (run > 0)
+      bytes.push_back(0xC0 | (run - 1)); // QOI_OP_RUN
+    run = 0;
+  }
+
+  void QoiStreamWriter::write_rows(const uint8_t *rgba, int rows)
+  {
+    if (!file)
+      return;
+    rows = std::min(rows, height - rows_written);
+    const size_t count = size_t(width) * rows;
+    bytes.clear();
+    bytes.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      const uint8_t *p = rgba + 4 * i;
+      const uint32_t px = p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+      if (px == prev)
+      {
+        if (++run == 62)
+          flush_run();
+        continue;
+      }
+      flush_run();
+
+      const int hash = (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) % 64;
+      if (index[hash] == px)
+      {
+        bytes.push_back(hash); // QOI_OP_INDEX
+      }
+      else
+      {
+        index[hash] = px;
+        if ((px >> 24) == (prev >> 24))
+        {
+          const int8_t vr = p[0] - (prev & 0xFF);
+          const int8_t vg = p[1] - ((prev >> 8) & 0xFF);
+          const int8_t vb = p[2] - ((prev >> 16) & 0xFF);
+          const int8_t vg_r = vr - vg;
+          const int8_t vg_b = vb - vg;
+          if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+          {
+            bytes.push_back(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)); // QOI_OP_DIFF
+          }
+          else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+          {
+            bytes.push_back(0x80 | (vg + 32)); // QOI_OP_LUMA
+            bytes.push_back((vg_r + 8) << 4 | (vg_b + 8));
+          }
+          else
+          {
+            const uint8_t op[4] = {0xFE, p[0], p[1], p[2]}; // QOI_OP_RGB
+            bytes.insert(bytes.end(), op, op + 4);
+          }
+        }
+        else
+        {
+          const uint8_t op[5] = {0xFF, p[0], p[1], p[2], p[3]}; // QOI_OP_RGBA
+          bytes.insert(bytes.end(), op, op + 5);
+        }
+      }
+      prev = px;
+    }
+    ok = ok && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    rows_written += rows;
+  }
+
+  bool QoiStreamWriter::close()
+  {
+    if (!file)
+      return false;
+    if (rows_written < height)
+    {
+      printf("[QoiStreamWriter::close] only %d of %d rows were written\n", rows_written, height);
+      ok = false;
+    }
+    bytes.clear();
+    flush_run();
+    const uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    bytes.insert(bytes.end(), end_marker, end_marker + 8);
+    ok = ok && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (fclose(file) == 0) && ok;
+    file = nullptr;
+    return ok;
+  }
+
+  bool JpegWriter::open(const std::string &_filename, int _width, int _height)
+  {
+    if (_width <= 0 || _height <= 0)
+    {
+      printf("[JpegWriter::open] invalid image size %dx%d\n", _width, _height);
+      return false;
+    }
+    filename = _filename;
+    width = _width;
+    height = _height;
+    rows_written = 0;
+    rgb.resize(3 * size_t(width) * height);
+    return true;
+  }
+
+  void JpegWriter::write_rows(const uint8_t *rgba, int rows)
+  {
+    rows = std::min(rows, height - rows_written);
+    const size_t count = size_t(width) * rows;
+    uint8_t *dst = rgb.data() + 3 * size_t(width) * rows_written;
+    for (size_t i = 0; i < count; i++)
+    {
+      dst[3 * i + 0] = rgba[4 * i + 0];
+      dst[3 * i + 1] = rgba[4 * i + 1];
+      dst[3 * i + 2] = rgba[4 * i + 2];
+    }
+    rows_written += rows;
+  }
+
+  bool JpegWriter::close()
+  {
+    if (rgb.empty())
+      return false;
+    bool ok = rows_written == height;
+    if (!ok)
+      printf("[JpegWriter::close] only %d of %d rows were written\n", rows_written, height);
+    else if (!stbi_write_jpg(filename.c_str(), width, height, 3, rgb.data(), quality))
+    {
+      printf("[JpegWriter::close] cannot write file %s\n", filename.c_str());
+      ok = false;
+    }
+    rgb = std::vector<uint8_t>();
+    return ok;
+  }
+
+  bool ExrWriter::open(const std::string &_filename, int _width, int _height)
+  {
+    if (_width <= 0 || _height <= 0)
+    {
+      printf("[ExrWriter::open] invalid image size %dx%d\n", _width, _height);
+      return false;
+    }
+    filename = _filename;
+    width = _width;
+    height = _height;
+    rows_written = 0;
+    rgb.resize(3 * size_t(width) * height);
+    return true;
+  }
+
+  void ExrWriter::write_float_rows(const float4 *pixels, int rows)
+  {
+    rows = std::min(rows, height - rows_written);
+    const size_t count = size_t(width) * rows;
+    float *dst = rgb.data() + 3 * size_t(width) * rows_written;
+    for (size_t i = 0; i < count; i++)
+    {
+      dst[3 * i + 0] = pixels[i].x;
+      dst[3 * i + 1] = pixels[i].y;
+      dst[3 * i + 2] = pixels[i].z;
+    }
+    rows_written += rows;
+  }
+
+  bool ExrWriter::close()
+  {
+    if (rgb.empty())
+      return false;
+    bool ok = rows_written == height;
+    if (!ok)
+    {
+      printf("[ExrWriter::close] only %d of %d rows were written\n", rows_written, height);
+    }
+    else
+    {
+      const char *err = nullptr;
+      if (SaveEXR(rgb.data(), width, height, 3, 0, filename.c_str(), &err) != TINYEXR_SUCCESS)
+      {
+        printf("[ExrWriter::close] cannot write file %s: %s\n", filename.c_str(), err ? err : "unknown error");
+        FreeEXRErrorMessage(err);
+        ok = false;
+      }
+    }
+    rgb = std::vector<float>();
+    return ok;
+  }
+}
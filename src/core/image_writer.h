@@ -0,0 +1,250 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LiteMath/Image2d.h"
+
+namespace LiteFigure
+{
+  // runs f(i) for i in [0, count) on up to threads threads
+  template <typename F>
+  void parallel_for(int count, int threads, const F &f)
+  {
+    threads = std::min(threads, count);
+    if (threads <= 1)
+    {
+      for (int i = 0; i < count; i++)
+        f(i);
+      return;
+    }
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+      workers.emplace_back([&]()
+                           { for (int i = next++; i < count; i = next++) f(i); });
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  // same conversion to 8-bit as LiteImage::SaveImage
+  static inline uint8_t tonemap_to_byte(float x, float gamma_inv)
+  {
+    const int color_ldr = int(std::pow(x, gamma_inv) * 255.0f + 0.5f);
+    return uint8_t(std::min(255, std::max(0, color_ldr)));
+  }
+
+  // converts rows [first_row, first_row+rows) of image to tightly packed RGBA8
+  void tonemap_rows(const LiteImage::Image2D<float4> &image, int first_row, int rows,
+                    std::vector<uint8_t> &out_rgba, float gamma = 2.2f);
+
+  enum class PngCompression
+  {
+    Fast,  // short match search, for iterating on a figure
+    Small  // long match search with lazy matching, for publication
+  };
+
+  // compresses data into a zlib stream, as png IDAT and pdf /FlateDecode streams store it
+  void zlib_compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out,
+                     PngCompression compression = PngCompression::Small, int threads = 1);
+  // png-filters rows of 8-bit pixels with 1, 3 or 4 channels and compresses them with zlib_compress.
+  // The result is png IDAT data, pdf reads it with /FlateDecode and /Predictor 15
+  void compress_png_rows(const uint8_t *pixels, int width, int height, int channels, std::vector<uint8_t> &out,
+                         PngCompression compression = PngCompression::Small, int threads = 1);
+  // encodes whole png file with 8-bit pixels with 1, 3 or 4 channels into memory, for images embedded in other files
+  void encode_png(const uint8_t *pixels, int width, int height, int channels, std::vector<uint8_t> &out,
+                  PngCompression compression = PngCompression::Small, int threads = 1);
+
+  // output file format that receives the image row by row, from top to bottom.
+  // The renderer hands rows to any encoder the same way and does not know the format
+  class ImageEncoder
+  {
+  public:
+    virtual ~ImageEncoder() = default;
+
+    virtual bool open(const std::string &filename, int width, int height) = 0;
+    // HDR encoders take linear float rows with write_float_rows, others take RGBA8 rows with write_rows
+    virtual bool is_hdr() const { return false; }
+    // appends rows of tightly packed gamma-encoded opaque RGBA8 pixels
+    virtual void write_rows(const uint8_t * /*rgba*/, int /*rows*/) {}
+    // appends rows of linear float4 pixels
+    virtual void write_float_rows(const float4 * /*pixels*/, int /*rows*/) {}
+    // finishes the file, returns false if it is incomplete or could not be written
+    virtual bool close() = 0;
+  };
+
+  // passes rows of linear pixels to encoder in the format it takes
+  void write_float_rows(ImageEncoder &encoder, const float4 *pixels, int width, int rows);
+  // passes rows [first_row, first_row+rows) of image to encoder in the format it takes
+  void write_image_rows(ImageEncoder &encoder, const LiteImage::Image2D<float4> &image, int first_row, int rows);
+
+  // shrinks an image streamed row by row with a box filter. Every source pixel is split
+  // between the destination pixels it overlaps in proportion to the overlapped area,
+  // so only two rows of the destination image are kept
+  class BoxDownscaler
+  {
+  public:
+    BoxDownscaler(int src_width, int src_height, int dst_width, int dst_height);
+    int width() const { return dst_width; }
+    int height() const { return dst_height; }
+    // adds next source rows, finished destination rows are appended to out_rows
+    void add_rows(const float4 *pixels, int rows, std::vector<float4> &out_rows);
+
+  private:
+    struct Split
+    {
+      int first;    // first destination pixel covered by source pixel
+      float w0, w1; // overlap with it and with the next one
+    };
+
+    int src_width, src_height;
+    int dst_width, dst_height;
+    int src_row = 0;
+    int dst_row = 0; // first unfinished destination row
+    std::vector<Split> x_splits;
+    std::vector<float4> row;    // horizontally filtered source row
+    std::vector<float4> acc[2]; // destination rows dst_row and dst_row + 1
+  };
+
+  // smaller copy of the output image, its size is given by width and/or height
+  // (a missing side keeps the aspect ratio) or by scale
+  struct ScaledOutput
+  {
+    std::string path;
+    float scale = 1.0f;
+    int width = 0;
+    int height = 0;
+  };
+
+  // writes image with the main encoder and box-filtered down to every scaled output
+  // with their own encoders, all from the same stream of rows
+  class MultiResolutionWriter : public ImageEncoder
+  {
+  public:
+    MultiResolutionWriter(std::unique_ptr<ImageEncoder> main) : main(std::move(main)) {}
+    void add_output(const ScaledOutput &spec, std::unique_ptr<ImageEncoder> encoder);
+
+    bool open(const std::string &filename, int width, int height) override;
+    bool is_hdr() const override { return true; }
+    void write_float_rows(const float4 *pixels, int rows) override;
+    bool close() override;
+
+  private:
+    struct Output
+    {
+      ScaledOutput spec;
+      std::unique_ptr<ImageEncoder> encoder;
+      std::unique_ptr<BoxDownscaler> downscaler; // null if output could not be opened
+    };
+
+    std::unique_ptr<ImageEncoder> main;
+    std::vector<Output> outputs;
+    int src_width = 0;
+    std::vector<float4> scaled_rows;
+  };
+
+  class ZlibStream;
+
+  // writes 8-bit RGBA png row by row, so that the whole image never has to be in memory.
+  // Rows are filtered and compressed as they come and go to the file in IDAT chunks.
+  // Filtering and deflate run on all cores, the stream is cut into independent chunks
+  // which are concatenated into one zlib stream, as pigz does
+  class PngStreamWriter : public ImageEncoder
+  {
+  public:
+    // threads = 0 uses all cores
+    PngStreamWriter(PngCompression compression = PngCompression::Fast, int threads = 0);
+    ~PngStreamWriter();
+    PngStreamWriter(const PngStreamWriter &) = delete;
+    PngStreamWriter &operator=(const PngStreamWriter &) = delete;
+
+    bool open(const std::string &filename, int width, int height) override;
+    void write_rows(const uint8_t *rgba, int rows) override;
+    bool close() override;
+
+  private:
+    void write_chunk(const char *type, const uint8_t *data, size_t size);
+    void flush_idat(bool all);
+
+    PngCompression compression;
+    FILE *file = nullptr;
+    int width = 0;
+    int height = 0;
+    int rows_written = 0;
+    bool ok = false;
+    int threads = 1;
+    std::vector<uint8_t> prev_row;
+    std::vector<uint8_t> filtered; // filter byte + filtered row for each row of current batch
+    std::vector<uint8_t> idat;     // compressed data not yet written
+    std::unique_ptr<ZlibStream> zlib;
+  };
+
+  // writes QOI, a simple lossless format that encodes and decodes several times faster than png.
+  // Pixels are encoded as they come, only the 64-entry color index is kept between rows
+  class QoiStreamWriter : public ImageEncoder
+  {
+  public:
+    ~QoiStreamWriter();
+
+    bool open(const std::string &filename, int width, int height) override;
+    void write_rows(const uint8_t *rgba, int rows) override;
+    bool close() override;
+
+  private:
+    void flush_run();
+
+    FILE *file = nullptr;
+    int width = 0;
+    int height = 0;
+    int rows_written = 0;
+    bool ok = false;
+    uint32_t index[64] = {0};
+    uint32_t prev = 0xFF000000; // packed RGBA, r in the lowest byte
+    int run = 0;
+    std::vector<uint8_t> bytes;
+  };
+
+  // writes baseline JPEG with stb_image_write. It only encodes whole images,
+  // so rows are kept as RGB8 until close
+  class JpegWriter : public ImageEncoder
+  {
+  public:
+    JpegWriter(int quality = 90) : quality(quality) {}
+
+    bool open(const std::string &filename, int width, int height) override;
+    void write_rows(const uint8_t *rgba, int rows) override;
+    bool close() override;
+
+  private:
+    int quality;
+    std::string filename;
+    int width = 0;
+    int height = 0;
+    int rows_written = 0;
+    std::vector<uint8_t> rgb;
+  };
+
+  // writes linear RGB float OpenEXR with tinyexr. It only encodes whole images,
+  // so rows are kept until close
+  class ExrWriter : public ImageEncoder
+  {
+  public:
+    bool open(const std::string &filename, int width, int height) override;
+    bool is_hdr() const override { return true; }
+    void write_float_rows(const float4 *pixels, int rows) override;
+    bool close() override;
+
+  private:
+    std::string filename;
+    int width = 0;
+    int height = 0;
+    int rows_written = 0;
+    std::vector<float> rgb;
+  };
+}
@@ -0,0 +1,604 @@
+#include "pdf_document.h"
+#include "image_writer.h"
+#include "ttf_reader.h"
+#include "vector_writer.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace LiteFigure
+{
+  static bool same_color(float4 a, float4 b)
+  {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+  }
+
+  // at most 3 digits after the point, followed by the space that separates operands
+  static void append_operand(std::string &s, float v)
+  {
+    append_number(s, v, 3);
+    s.push_back(' ');
+  }
+
+  PdfDocument::PdfDocument(float width, float height) : page_width(width), page_height(height)
+  {
+    // miter limit of the renderer for polygon outlines, the same as in SVG
+    content = "4 M\n";
+  }
+
+  void PdfDocument::number(float v)
+  {
+    append_operand(content, v);
+  }
+
+  void PdfDocument::set_fill_color(float4 color)
+  {
+    set_alpha(color.w);
+    if (same_color(color, state.fill_color))
+      return;
+    end_path();
+    state.fill_color = color;
+    number(color.x);
+    number(color.y);
+    number(color.z);
+    content += "rg\n";
+  }
+
+  void PdfDocument::set_stroke_color(float4 color)
+  {
+    set_alpha(color.w);
+    if (same_color(color, state.stroke_color))
+      return;
+    end_path();
+    state.stroke_color = color;
+    number(color.x);
+    number(color.y);
+    number(color.z);
+    content += "RG\n";
+  }
+
+  void PdfDocument::set_line_width(float width)
+  {
+    if (width == state.line_width)
+      return;
+    end_path();
+    state.line_width = width;
+    number(width);
+    content += "w\n";
+  }
+
+  void PdfDocument::set_alpha(float opacity)
+  {
+    int a = std::clamp(int(opacity * 255.0f + 0.5f), 0, 255);
+    if (a == state.alpha)
+      return;
+    end_path();
+    state.alpha = a;
+    auto it = alphas.find(a);
+    if (it == alphas.end())
+      it = alphas.emplace(a, "GS" + std::to_string(a)).first;
+    content += "/" + it->second + " gs\n";
+  }
+
+  void PdfDocument::set_line_cap(int cap)
+  {
+    if (cap == state.line_cap)
+      return;
+    end_path();
+    state.line_cap = cap;
+    content += std::to_string(cap) + " J\n";
+  }
+
+  void PdfDocument::set_line_join(int join)
+  {
+    if (join == state.line_join)
+      return;
+    end_path();
+    state.line_join = join;
+    content += std::to_string(join) + " j\n";
+  }
+
+  void PdfDocument::set_dash(float2 pattern, float phase)
+  {
+    if (pattern.y == 0)
+      phase = 0;
+    if (pattern.x == state.dash.x && pattern.y == state.dash.y && phase == state.dash_phase)
+      return;
+    end_path();
+    state.dash = pattern;
+    state.dash_phase = phase;
+    content += "[";
+    if (pattern.y != 0)
+    {
+      number(pattern.x);
+      number(pattern.y);
+    }
+    content += "] ";
+    number(phase);
+    content += "d\n";
+  }
+
+  void PdfDocument::begin_path(Paint paint)
+  {
+    if (paint == path_paint)
+      return;
+    end_path();
+    path_paint = paint;
+  }
+
+  void PdfDocument::end_path()
+  {
+    switch (path_paint)
+    {
+    case Paint::None:
+      return;
+    case Paint::Stroke:
+      content += "S\n";
+      break;
+    case Paint::Fill:
+      content += "f\n";
+      break;
+    case Paint::FillEvenOdd:
+      content += "f*\n";
+      break;
+    }
+    path_paint = Paint::None;
+  }
+
+  void PdfDocument::contour(const std::vector<float2> &points)
+  {
+    if (points.size() < 2)
+      return;
+    number(points[0].x);
+    number(flip(points[0].y));
+    content += "m\n";
+    for (int i = 1; i < points.size(); i++)
+    {
+      number(points[i].x);
+      number(flip(points[i].y));
+      content += "l\n";
+    }
+    content += "h\n";
+  }
+
+  int PdfDocument::add_image(int width, int height, std::vector<uint8_t> &&flate_rgb)
+  {
+    images.push_back(Image{width, height, std::move(flate_rgb)});
+    return images.size() - 1;
+  }
+
+  void PdfDocument::draw_image(int image, float x, float y, float width, float height)
+  {
+    end_path();
+    content += "q ";
+    number(width);
+    content += "0 0 ";
+    number(height);
+    number(x);
+    number(flip(y + height));
+    content += "cm /Im" + std::to_string(image) + " Do Q\n";
+  }
+
+  void PdfDocument::clip_rect(float x, float y, float width, float height)
+  {
+    const bool covers_page = x <= 0 && y <= 0 && x + width >= page_width && y + height >= page_height;
+    if (covers_page ? !clipped : clipped && clip.x == x && clip.y == y && clip.z == width && clip.w == height)
+      return;
+    end_path();
+    if (clipped)
+    {
+      content += "Q\n";
+      state = unclipped_state;
+    }
+    clipped = !covers_page;
+    if (!clipped)
+      return;
+    clip = float4(x, y, width, height);
+    unclipped_state = state;
+    content += "q ";
+    number(x);
+    number(flip(y + height));
+    number(width);
+    number(height);
+    content += "re W n\n";
+  }
+
+  void PdfDocument::fill_rect(float x, float y, float width, float height, float4 color)
+  {
+    set_fill_color(color);
+    begin_path(Paint::Fill);
+    number(x);
+    number(flip(y + height));
+    number(width);
+    number(height);
+    content += "re\n";
+  }
+
+  void PdfDocument::stroke_rect(float x, float y, float width, float height, float line_width, float4 color)
+  {
+    set_stroke_color(color);
+    set_line_width(line_width);
+    set_line_join(0);
+    set_dash(float2(0, 0), 0);
+    begin_path(Paint::Stroke);
+    number(x);
+    number(flip(y + height));
+    number(width);
+    number(height);
+    content += "re\n";
+  }
+
+  void PdfDocument::line(float x1, float y1, float x2, float y2, float line_width, float4 color,
+                         float2 dash, float dash_phase)
+  {
+    set_stroke_color(color);
+    set_line_width(line_width);
+    set_line_cap(dash.x == 0 ? 1 : 0);
+    set_line_join(1);
+    set_dash(dash, dash_phase);
+    // a segment continues the polyline if it starts at its end and nothing was written after it.
+    // Dashes restart at every subpath, as the renderer restarts them at every segment
+    const bool continues = path_paint == Paint::Stroke && polyline_end == content.size() && dash.y == 0 &&
+                           std::abs(x1 - path_end.x) < 1e-3f && std::abs(y1 - path_end.y) < 1e-3f;
+    begin_path(Paint::Stroke);
+    if (!continues)
+    {
+      number(x1);
+      number(flip(y1));
+      content += "m ";
+    }
+    number(x2);
+    number(flip(y2));
+    content += "l\n";
+    path_end = float2(x2, y2);
+    polyline_end = content.size();
+  }
+
+  void PdfDocument::fill_ellipse(float cx, float cy, float rx, float ry, float4 color)
+  {
+    // four cubic Bezier quarter arcs
+    const float k = 4.0f / 3.0f * (std::sqrt(2.0f) - 1.0f);
+    const float lx = k * rx, ly = k * ry;
+    cy = flip(cy);
+    set_fill_color(color);
+    begin_path(Paint::Fill);
+    number(cx + rx);
+    number(cy);
+    content += "m ";
+    const float curves[4][6] = {
+        {cx + rx, cy - ly, cx + lx, cy - ry, cx, cy - ry},
+        {cx - lx, cy - ry, cx - rx, cy - ly, cx - rx, cy},
+        {cx - rx, cy + ly, cx - lx, cy + ry, cx, cy + ry},
+        {cx + lx, cy + ry, cx + rx, cy + ly, cx + rx, cy}};
+    for (const auto &c : curves)
+    {
+      for (float v : c)
+        number(v);
+      content += "c ";
+    }
+    content += "h\n";
+  }
+
+  void PdfDocument::fill_polygon(const std::vector<std::vector<float2>> &contours, FillRule fill_rule, float4 color)
+  {
+    // other shapes are not added to the path, they would change what is inside the polygon
+    set_fill_color(color);
+    end_path();
+    begin_path(fill_rule == FillRule::EvenOdd ? Paint::FillEvenOdd : Paint::Fill);
+    for (const auto &points : contours)
+      contour(points);
+    end_path();
+  }
+
+  void PdfDocument::stroke_polygon(const std::vector<std::vector<float2>> &contours, float line_width, LineJoin join,
+                                   float4 color)
+  {
+    set_stroke_color(color);
+    set_line_width(line_width);
+    set_line_join(int(join)); // LineJoin values are pdf line join styles
+    set_dash(float2(0, 0), 0);
+    begin_path(Paint::Stroke);
+    for (const auto &points : contours)
+      contour(points);
+  }
+
+  int PdfDocument::add_font(const std::string &name, const Font &font, bool standard)
+  {
+    for (int i = 0; i < fonts.size(); i++)
+      if (fonts[i].name == name)
+        return i;
+    FontResource resource;
+    resource.name = name;
+    resource.font = &font;
+    resource.standard = standard;
+    if (!standard)
+    {
+      resource.subset.push_back(0);
+      resource.characters.push_back(0);
+      resource.subset_ids[0] = 0;
+    }
+    fonts.push_back(resource);
+    return fonts.size() - 1;
+  }
+
+  // advance in 1/1000 of font size, as pdf font widths are given
+  int PdfDocument::glyph_width(int font, uint16_t glyph) const
+  {
+    const Font &f = *fonts[font].font;
+    return std::lround(f.glyphs[glyph].advance.advanceWidth * f.scale * 1000.0f);
+  }
+
+  void PdfDocument::text_run(int font, float size, float y, float4 color, const std::vector<TextGlyph> &glyphs)
+  {
+    if (glyphs.empty())
+      return;
+    end_path();
+    FontResource &resource = fonts[font];
+    set_fill_color(color);
+    content += "BT /F" + std::to_string(font) + " ";
+    number(size);
+    content += "Tf ";
+    number(glyphs[0].x);
+    number(flip(y));
+    content += "Td [";
+
+    // the pen moves by glyph widths, glyphs that are not where it gets are moved with TJ offsets
+    const char *open = resource.standard ? "(" : "<";
+    const char *close = resource.standard ? ")" : ">";
+    content += open;
+    float pen = glyphs[0].x;
+    for (int i = 0; i < glyphs.size(); i++)
+    {
+      const TextGlyph &g = glyphs[i];
+      int offset = std::lround((pen - g.x) * 1000.0f / size);
+      if (offset != 0)
+      {
+        content += close;
+        content += std::to_string(offset);
+        content += open;
+      }
+      pen -= offset * size / 1000.0f;
+
+      uint16_t glyph = g.glyph;
+      if (resource.standard)
+      {
+        unsigned char c = g.character;
+        glyph = resource.font->cmap.charGlyphs[c];
+        if (c == '(' || c == ')' || c == '\\')
+          content.push_back('\\');
+        if (c >= 32 && c < 127)
+        {
+          content.push_back(c);
+        }
+        else
+        {
+          char octal[8];
+          snprintf(octal, sizeof(octal), "\\%03o", c);
+          content += octal;
+        }
+      }
+      else
+      {
+        auto it = resource.subset_ids.find(g.glyph);
+        if (it == resource.subset_ids.end())
+        {
+          it = resource.subset_ids.emplace(g.glyph, resource.subset.size()).first;
+          resource.subset.push_back(g.glyph);
+          resource.characters.push_back(g.character);
+        }
+        char hex[8];
+        snprintf(hex, sizeof(hex), "%04X", it->second);
+        content += hex;
+      }
+      pen += glyph_width(font, glyph) * size / 1000.0f;
+    }
+    content += close;
+    content += "] TJ ET\n";
+  }
+
+  // writes font objects starting from first_object: a simple font for standard fonts, or Type0 font,
+  // CID font, descriptor, TrueType subset and ToUnicode map for embedded ones. Returns number of objects
+  int PdfDocument::write_font(FILE *file, int font, int first_object, std::vector<long> &offsets) const
+  {
+    const FontResource &resource = fonts[font];
+    const Font &f = *resource.font;
+    if (resource.standard)
+    {
+      offsets[first_object] = ftell(file);
+      std::string widths;
+      for (int c = 32; c < 256; c++)
+        widths += std::to_string(glyph_width(font, f.cmap.charGlyphs[c])) + (c % 16 == 15 ? "\n" : " ");
+      const char *encoding = resource.name == "Symbol" || resource.name == "ZapfDingbats" ? "" : " /Encoding /WinAnsiEncoding";
+      fprintf(file, "%d 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /%s%s\n/FirstChar 32 /LastChar 255 /Widths [%s] >>\nendobj\n",
+              first_object, resource.name.c_str(), encoding, widths.c_str());
+      return 1;
+    }
+
+    // subset fonts are named with a 6 letter tag, unique in the document
+    std::string base_font = "AAAAAA+";
+    for (int i = 5, n = font; i >= 0 && n > 0; i--, n /= 26)
+      base_font[i] = 'A' + n % 26;
+    for (char c : resource.name.substr(0, resource.name.find_last_of('.')))
+      if (isalnum((unsigned char)c) || c == '-')
+        base_font.push_back(c);
+
+    std::string widths;
+    float4 bbox = float4(0, 0, 0, 0);
+    for (int i = 0; i < resource.subset.size(); i++)
+    {
+      const TTFSimpleGlyph &glyph = f.glyphs[resource.subset[i]];
+      widths += std::to_string(glyph_width(font, resource.subset[i])) + " ";
+      if (!glyph.contours.empty())
+        bbox = float4(std::min<float>(bbox.x, glyph.xMin), std::min<float>(bbox.y, glyph.yMin),
+                      std::max<float>(bbox.z, glyph.xMax), std::max<float>(bbox.w, glyph.yMax));
+    }
+    bbox *= f.scale * 1000.0f;
+    const int ascent = std::lround(f.ascent * f.scale * 1000.0f);
+    const int descent = std::lround(f.descent * f.scale * 1000.0f);
+
+    std::string to_unicode =
+        "/CIDInit /ProcSet findresource begin\n12 dict begin\nbegincmap\n"
+        "/CIDSystemInfo << /Registry (Adobe) /Ordering (UCS) /Supplement 0 >> def\n"
+        "/CMapName /Adobe-Identity-UCS def\n/CMapType 2 def\n"
+        "1 begincodespacerange\n<0000> <FFFF>\nendcodespacerange\n";
+    // at most 100 entries per block
+    for (int first = 1; first < resource.subset.size(); first += 100)
+    {
+      int count = std::min<int>(100, resource.subset.size() - first);
+      to_unicode += std::to_string(count) + " beginbfchar\n";
+      for (int i = first; i < first + count; i++)
+      {
+        char entry[32];
+        snprintf(entry, sizeof(entry), "<%04X> <%04X>\n", i, (unsigned char)resource.characters[i]);
+        to_unicode += entry;
+      }
+      to_unicode += "endbfchar\n";
+    }
+    to_unicode += "endcmap\nCMapName currentdict /CMap defineresource pop\nend\nend\n";
+
+    std::vector<uint8_t> ttf = write_ttf_subset(f, resource.subset);
+    std::vector<uint8_t> compressed_ttf;
+    zlib_compress(ttf.data(), ttf.size(), compressed_ttf);
+
+    const int n = first_object;
+    offsets[n] = ftell(file);
+    fprintf(file, "%d 0 obj\n<< /Type /Font /Subtype /Type0 /BaseFont /%s /Encoding /Identity-H "
+                  "/DescendantFonts [%d 0 R] /ToUnicode %d 0 R >>\nendobj\n",
+            n, base_font.c_str(), n + 1, n + 4);
+    offsets[n + 1] = ftell(file);
+    fprintf(file, "%d 0 obj\n<< /Type /Font /Subtype /CIDFontType2 /BaseFont /%s "
+                  "/CIDSystemInfo << /Registry (Adobe) /Ordering (Identity) /Supplement 0 >>\n"
+                  "/FontDescriptor %d 0 R /CIDToGIDMap /Identity /W [0 [%s]] >>\nendobj\n",
+            n + 1, base_font.c_str(), n + 2, widths.c_str());
+    offsets[n + 2] = ftell(file);
+    fprintf(file, "%d 0 obj\n<< /Type /FontDescriptor /FontName /%s /Flags 4 /FontBBox [%d %d %d %d] "
+                  "/ItalicAngle 0 /Ascent %d /Descent %d /CapHeight %d /StemV 80 /FontFile2 %d 0 R >>\nendobj\n",
+            n + 2, base_font.c_str(), int(bbox.x), int(bbox.y), int(bbox.z), int(bbox.w), ascent, descent, ascent, n + 3);
+    offsets[n + 3] = ftell(file);
+    fprintf(file, "%d 0 obj\n<< /Length1 %zu /Filter /FlateDecode /Length %zu >>\nstream\n", n + 3, ttf.size(), compressed_ttf.size());
+    fwrite(compressed_ttf.data(), 1, compressed_ttf.size(), file);
+    fprintf(file, "\nendstream\nendobj\n");
+    offsets[n + 4] = ftell(file);
+    fprintf(file, "%d 0 obj\n<< /Length %zu >>\nstream\n%s\nendstream\nendobj\n", n + 4, to_unicode.size(), to_unicode.c_str());
+    return 5;
+  }
+
+  bool PdfDocument::save(const std::string &filename)
+  {
+    end_path();
+    clip_rect(0, 0, page_width, page_height);
+    std::vector<uint8_t> compressed_content;
+    zlib_compress((const uint8_t *)content.data(), content.size(), compressed_content, PngCompression::Small,
+                  std::max(1u, std::thread::hardware_concurrency()));
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+      printf("[PdfDocument::save] cannot open file %s\n", filename.c_str());
+      return false;
+    }
+
+    // objects: 1 catalog, 2 page tree, 3 page, 4 content stream, 5 info, then fonts and images
+    std::vector<int> font_objects(fonts.size());
+    int next_object = 6;
+    for (int i = 0; i < fonts.size(); i++)
+    {
+      font_objects[i] = next_object;
+      next_object += fonts[i].standard ? 1 : 5;
+    }
+    const int first_image = next_object;
+    const int object_count = first_image + images.size();
+    std::vector<long> offsets(object_count, 0);
+    std::string buf;
+    auto begin_object = [&](int id)
+    {
+      offsets[id] = ftell(file);
+      fprintf(file, "%d 0 obj\n", id);
+    };
+    auto write_stream = [&](const std::string &dict, const void *data, size_t size)
+    {
+      fprintf(file, "<< %s /Length %zu >>\nstream\n", dict.c_str(), size);
+      fwrite(data, 1, size, file);
+      fprintf(file, "\nendstream\nendobj\n");
+    };
+
+    fprintf(file, "%%PDF-1.4\n%%\xE2\xE3\xCF\xD3\n");
+
+    begin_object(1);
+    fprintf(file, "<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    begin_object(2);
+    fprintf(file, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+
+    begin_object(3);
+    buf.clear();
+    buf += "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 ";
+    append_operand(buf, page_width);
+    append_operand(buf, page_height);
+    buf += "] /Contents 4 0 R\n/Resources <<";
+    if (!fonts.empty())
+    {
+      buf += " /Font <<";
+      for (int i = 0; i < fonts.size(); i++)
+        buf += " /F" + std::to_string(i) + " " + std::to_string(font_objects[i]) + " 0 R";
+      buf += " >>";
+    }
+    if (!images.empty())
+    {
+      buf += " /XObject <<";
+      for (int i = 0; i < images.size(); i++)
+        buf += " /Im" + std::to_string(i) + " " + std::to_string(first_image + i) + " 0 R";
+      buf += " >>";
+    }
+    if (!alphas.empty())
+    {
+      buf += " /ExtGState <<";
+      for (const auto &[a, name] : alphas)
+      {
+        buf += " /" + name + " << /ca ";
+        append_operand(buf, a / 255.0f);
+        buf += "/CA ";
+        append_operand(buf, a / 255.0f);
+        buf += ">>";
+      }
+      buf += " >>";
+    }
+    buf += " >>\n>>\nendobj\n";
+    fwrite(buf.data(), 1, buf.size(), file);
+
+    begin_object(4);
+    write_stream("/Filter /FlateDecode", compressed_content.data(), compressed_content.size());
+
+    begin_object(5);
+    fprintf(file, "<< /Creator (LiteFigure) /Producer (LiteFigure) >>\nendobj\n");
+
+    for (int i = 0; i < fonts.size(); i++)
+      write_font(file, i, font_objects[i], offsets);
+
+    for (int i = 0; i < images.size(); i++)
+    {
+      const Image &image = images[i];
+      begin_object(first_image + i);
+      char dict[512];
+      snprintf(dict, sizeof(dict),
+               "/Type /XObject /Subtype /Image /Width %d /Height %d /ColorSpace /DeviceRGB /BitsPerComponent 8 "
+               "/Interpolate true /Filter /FlateDecode /DecodeParms << /Predictor 15 /Colors 3 /BitsPerComponent 8 /Columns %d >>",
+               image.width, image.height, image.width);
+      write_stream(dict, image.data.data(), image.data.size());
+    }
+
+    const long xref = ftell(file);
+    fprintf(file, "xref\n0 %d\n0000000000 65535 f \n", object_count);
+    for (int i = 1; i < object_count; i++)
+      fprintf(file, "%010ld 00000 n \n", offsets[i]);
+    fprintf(file, "trailer\n<< /Size %d /Root 1 0 R /Info 5 0 R >>\nstartxref\n%ld\n%%%%EOF\n", object_count, xref);
+
+    bool ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+      printf("[PdfDocument::save] failed to write %s\n", filename.c_str());
+    return ok;
+  }
+}
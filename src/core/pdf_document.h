@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "LiteMath/LiteMath.h"
+#include "figure.h"
+#include "font.h"
+
+namespace LiteFigure
+{
+  using LiteMath::float2;
+  using LiteMath::float4;
+
+  // single page PDF written straight from drawing calls. Coordinates are in points with
+  // the origin in the top left corner, as in figures; the page is flipped when written.
+  // Colors are display (gamma-encoded) RGB in [0,1], alpha is opacity.
+  // Consecutive shapes drawn with the same style are added to one path that is painted once,
+  // so a plot line or a set of markers becomes a single path object
+  class PdfDocument
+  {
+  public:
+    PdfDocument(float width, float height);
+
+    // adds image XObject from rows compressed with compress_png_rows (RGB8), returns its id.
+    // The image is stored once and can be drawn any number of times
+    int add_image(int width, int height, std::vector<uint8_t> &&flate_rgb);
+    void draw_image(int image, float x, float y, float width, float height);
+
+    // shapes drawn after it are clipped to the rect, a rect that covers the page removes the clip
+    void clip_rect(float x, float y, float width, float height);
+
+    void fill_rect(float x, float y, float width, float height, float4 color);
+    void stroke_rect(float x, float y, float width, float height, float line_width, float4 color);
+    // lines have round caps and joins, as they are rendered. dash is (dash length, gap), solid if the gap is 0,
+    // zero dash length with round caps gives dots. Segments that continue the previous one form a polyline
+    void line(float x1, float y1, float x2, float y2, float line_width, float4 color,
+              float2 dash = float2(0, 0), float dash_phase = 0);
+    void fill_ellipse(float cx, float cy, float rx, float ry, float4 color);
+    // contours are closed
+    void fill_polygon(const std::vector<std::vector<float2>> &contours, FillRule fill_rule, float4 color);
+    void stroke_polygon(const std::vector<std::vector<float2>> &contours, float line_width, LineJoin join, float4 color);
+
+    // returns id of font for text_run, the same for the same name. Standard (base 14) fonts are
+    // referenced by name with widths from font, other fonts are embedded as TrueType subsets
+    // of the glyphs used in the document
+    int add_font(const std::string &name, const Font &font, bool standard);
+    struct TextGlyph
+    {
+      uint16_t glyph; // index in font.glyphs
+      char character; // for text extraction, and the char code for standard fonts
+      float x;        // start of the glyph on the baseline
+    };
+    // one line of text drawn with a single show-text operator, every glyph is placed at its x exactly
+    void text_run(int font, float size, float y, float4 color, const std::vector<TextGlyph> &glyphs);
+
+    // paints the open path and writes the file, the content stream is compressed
+    bool save(const std::string &filename);
+
+  private:
+    struct Image
+    {
+      int width, height;
+      std::vector<uint8_t> data;
+    };
+
+    struct FontResource
+    {
+      std::string name;
+      const Font *font;
+      bool standard;
+      // embedded fonts only: subset glyph i is font glyph subset[i] and shows character characters[i],
+      // glyph 0 is .notdef. Text uses subset glyph indices as 2-byte codes
+      std::vector<uint16_t> subset;
+      std::vector<char> characters;
+      std::map<uint16_t, uint16_t> subset_ids;
+    };
+
+    enum class Paint
+    {
+      None,
+      Stroke,
+      Fill,
+      FillEvenOdd
+    };
+
+    float flip(float y) const { return page_height - y; }
+    void begin_path(Paint paint);
+    void end_path();
+    void contour(const std::vector<float2> &points);
+    int glyph_width(int font, uint16_t glyph) const;
+    int write_font(FILE *file, int font, int first_object, std::vector<long> &offsets) const;
+    void set_fill_color(float4 color);
+    void set_stroke_color(float4 color);
+    void set_line_width(float width);
+    void set_alpha(float alpha);
+    void set_line_cap(int cap);
+    void set_line_join(int join);
+    void set_dash(float2 dash, float phase);
+    void number(float v);
+
+    float page_width, page_height;
+    std::string content;
+    std::vector<Image> images;
+    std::vector<FontResource> fonts;    // font i is /F<i>
+    std::map<int, std::string> alphas;  // opacity in 1/255 units -> ExtGState name
+
+    // current graphics state, unchanged settings are not written again.
+    // Changing any of them paints the open path first
+    struct GraphicsState
+    {
+      float4 fill_color = float4(0, 0, 0, 1);
+      float4 stroke_color = float4(0, 0, 0, 1);
+      float line_width = 1.0f;
+      int alpha = 255;
+      int line_cap = 0;  // butt
+      int line_join = 0; // miter
+      float2 dash = float2(0, 0);
+      float dash_phase = 0;
+    };
+    GraphicsState state;
+
+    // the clip is set inside q/Q, state is put back to the one before q when the clip is removed
+    bool clipped = false;
+    float4 clip = float4(0, 0, 0, 0); // x, y, width, height
+    GraphicsState unclipped_state;
+
+    // path that is being built and how it will be painted
+    Paint path_paint = Paint::None;
+    float2 path_end = float2(0, 0); // end of the last line segment
+    size_t polyline_end = 0;         // content size right after the last line segment
+  };
+}
@@ -1,298 +1,162 @@
 #include "figure.h"
-#include "pdfgen.h"
+#include "pdf_document.h"
 #include "renderer.h"
-#include "stb_image_write.h"
-#include "font.h"
+#include "image_writer.h"
+#include "vector_writer.h"
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace LiteFigure
 {
   //Points Per Pixel
   static constexpr int PPP = 1;
-  int document_height_points = 0;
 
-  static inline int tonemap(float x, float a_gammaInv) 
-  { 
-    const int colorLDR = int( std::pow(x, a_gammaInv) * 255.0f + 0.5f );
-    if(colorLDR < 0)        return 0;
-    else if(colorLDR > 255) return 255;
-    else                    return colorLDR;
-  }
-
-  static inline float4 tonemap(float4 x, float a_gammaInv)
-  {
-    return float4(std::pow(x.x, a_gammaInv), std::pow(x.y, a_gammaInv), 
-                  std::pow(x.z, a_gammaInv), std::pow(x.w, a_gammaInv));
-  }
-
-  static inline uint32_t float4_to_PDF_color(float4 color)
-  {
-    uint32_t r = std::clamp((uint32_t)(color.x * 255.0f), 0u, 255u);
-    uint32_t g = std::clamp((uint32_t)(color.y * 255.0f), 0u, 255u);
-    uint32_t b = std::clamp((uint32_t)(color.z * 255.0f), 0u, 255u);
-    uint32_t a = 255 - std::clamp((uint32_t)(color.w * 255.0f), 0u, 255u);
-    return (a << 24) | (r << 16) | (g << 8) | b;
-  }
-
-  static inline uint32_t float4_to_RGBA8_color(float4 color, float a_gammaInv)
-  {
-    uint32_t r = tonemap(color.x, a_gammaInv);
-    uint32_t g = tonemap(color.y, a_gammaInv);
-    uint32_t b = tonemap(color.z, a_gammaInv);
-    uint32_t a = tonemap(color.w, a_gammaInv);
-    return (a << 24) | (b << 16) | (g << 8) | r;
-  }
-
-  void float4_image_to_RGBA8_image(LiteImage::Image2D<float4> &src, LiteImage::Image2D<uint32_t> &dst, float gamma = 2.2f)
-  {
-    dst.resize(src.width(), src.height());
-    for (uint32_t y = 0; y < src.height(); y++)
+  // adds every distinct image to pdf once, ids[i] is the pdf image of instance i.
+  // Images are compressed in parallel
+  static void add_images_to_pdf(std::vector<EmbeddedImage> &images, PdfDocument &pdf, std::vector<int> &ids)
+  {
+    std::vector<int> unique;
+    for (int i = 0; i < images.size(); i++)
+      if (images[i].source == i)
+        unique.push_back(i);
+    std::vector<std::vector<uint8_t>> compressed(unique.size());
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    parallel_for(unique.size(), threads, [&](int i)
+                 {
+                   EmbeddedImage &image = images[unique[i]];
+                   compress_png_rows(image.rgb.data(), image.size.x, image.size.y, 3, compressed[i]);
+                   image.rgb = std::vector<uint8_t>(); });
+    ids.assign(images.size(), -1);
+    for (int i = 0; i < unique.size(); i++)
     {
-      const uint32_t offset1 = y*src.width();
-      const uint32_t offset2 = y*dst.width();
-      for(uint32_t x=0; x<src.width(); x++)
-      {
-        dst.data()[offset2 + x] = float4_to_RGBA8_color(src.data()[offset1 + x], 1.0f/gamma);
-      }
+      const EmbeddedImage &image = images[unique[i]];
+      ids[unique[i]] = pdf.add_image(image.size.x, image.size.y, std::move(compressed[i]));
     }
+    for (int i = 0; i < images.size(); i++)
+      if (images[i].source >= 0)
+        ids[i] = ids[images[i].source];
   }
 
-  void float4_image_to_RGB8_image(LiteImage::Image2D<float4> &src, std::vector<unsigned char> &dst, float gamma = 2.2f)
-  {
-    dst.resize(3*src.width()*src.height());
-    for (uint32_t y = 0; y < src.height(); y++)
-    {
-      const uint32_t offset1 = y*src.width();
-      const uint32_t offset2 = 3*y*src.width();
-      for(uint32_t x=0; x<src.width(); x++)
-      {
-        float4 color = src.data()[offset1 + x];
-        dst.data()[offset2 + x*3 + 0] = tonemap(color.x, 1.0f/gamma);
-        dst.data()[offset2 + x*3 + 1] = tonemap(color.y, 1.0f/gamma);
-        dst.data()[offset2 + x*3 + 2] = tonemap(color.z, 1.0f/gamma);
-      }
-    }
-  }
-
-  int pdf_add_image_file_flip(struct pdf_doc *pdf, struct pdf_object *page, float x, float y, float w, float h, const char *filename)
-  {
-    return pdf_add_image_file(pdf, page, x, document_height_points - y - h, w, h, filename);
-  }
-
-  int pdf_add_text_flip(struct pdf_doc *pdf, struct pdf_object *page, const char *text, float size, float xoff, float yoff,
-                        uint32_t colour)
-  {
-    return pdf_add_text(pdf, page, text, size, xoff, document_height_points - yoff, colour);
-  }
-
-  int pdf_add_line_flip(struct pdf_doc *pdf, struct pdf_object *page, float x1, float y1, float x2, float y2, float width, 
-                        uint32_t colour)
-  {
-    return pdf_add_line(pdf, page, x1, document_height_points - y1, x2, document_height_points - y2, width, colour);
-  }
-
-  int pdf_add_filled_rectangle_flip(struct pdf_doc *pdf, struct pdf_object *page, float x, float y, float w, float h, 
-                                    uint32_t colour)
-  {
-    return pdf_add_filled_rectangle(pdf, page, x, document_height_points - y - h, w, h, 0, colour, colour);
-  }
-
-  int pdf_add_rectangle_flip(struct pdf_doc *pdf, struct pdf_object *page, float x, float y, float w, float h, 
-                             float border_width, uint32_t colour)
+  void save_PrimitiveImage_to_pdf(const EmbeddedImage &image, int id, PdfDocument &pdf)
   {
-    return pdf_add_rectangle(pdf, page, x, document_height_points - y - h, w, h, border_width, colour);
+    if (id >= 0)
+      pdf.draw_image(id, PPP*image.pos.x, PPP*image.pos.y, PPP*image.size.x, PPP*image.size.y);
   }
 
-  int pdf_add_ellipse_flip(struct pdf_doc *pdf, struct pdf_object *page, float x, float y, float x_radius, float y_radius, 
-                           uint32_t colour)
+  // saves glyph instances starting from first that lie on one line and have the same font, size and color
+  // as one text run. Returns index of the first instance after the run
+  int save_Glyph_run_to_pdf(const std::vector<Instance> &instances, int first, PdfDocument &pdf)
   {
-    return pdf_add_ellipse(pdf, page, x, document_height_points - y, x_radius, y_radius, 0, colour, colour);
+    TextRun run;
+    int end = collect_text_run(instances, first, run);
+    const std::string &font_name = run.prim->font_name;
+    int pdf_font = pdf.add_font(font_name, *run.font, is_default_font(font_name));
+    std::vector<PdfDocument::TextGlyph> glyphs;
+    for (const RunGlyph &g : run.glyphs)
+      glyphs.push_back({g.glyph, g.character, PPP*g.x});
+    pdf.text_run(pdf_font, PPP*run.prim->font_size, PPP*run.baseline, display_color(run.prim->color), glyphs);
+    return end;
   }
 
-  bool save_PrimitiveImage_to_pdf(PrimitiveImage *prim, InstanceData inst, struct pdf_doc *pdf)
+  // consecutive lines of a plot with the same style become one polyline in PdfDocument
+  bool save_Line_to_pdf(const Line *prim, InstanceData inst, PdfDocument &pdf)
   {
-    static int counter = 0;
-    //first, render image (it can be cropped, rotated, etc.)
-    LiteImage::Image2D<float4> out = LiteImage::Image2D<float4>(inst.size.x, inst.size.y);
-    Renderer renderer;
-    Instance image_inst;
-    image_inst.prim = prim;
-    image_inst.data = inst;
-    image_inst.data.pos = int2(0, 0);
-    renderer.render_instance(image_inst, out);
-
-    // then, save to temporary png file. Drop alpha channel
-    std::vector<unsigned char> out_RGB8;
-    float4_image_to_RGB8_image(out, out_RGB8);
-    std::string filename = "tmp/image_" + std::to_string(counter++) + ".png";
-    stbi_write_png(filename.c_str(), inst.size.x, inst.size.y, 3, out_RGB8.data(), inst.size.x*3);
-
-    //then add it to pdf
-    int res = pdf_add_image_file_flip(pdf, nullptr, PPP*inst.pos.x, PPP*inst.pos.y, 
-                                      PPP*inst.size.x, PPP*inst.size.y, filename.c_str());
-    if (res < 0)
-    {
-      fprintf(stderr, "[PDFGen]Error adding image: %d\n", res);
-      return false;
-    }
+    LineGeometry line = line_geometry(prim, inst);
+    float2 p0 = PPP*line.p0;
+    float2 p1 = PPP*line.p1;
+    pdf.line(p0.x, p0.y, p1.x, p1.y, PPP*line.width, display_color(prim->color), PPP*line.dash, PPP*line.dash_phase);
     return true;
   }
 
-  bool is_default_font(const std::string &name)
+  bool save_PrimitiveFill_to_pdf(const PrimitiveFill *prim, InstanceData inst, PdfDocument &pdf)
   {
-    static const char *default_fonts[] = {
-      "Times-Roman", "Times-Bold", "Times-Italic", "Times-BoldItalic",
-      "Helvetica", "Helvetica-Bold", "Helvetica-Oblique", "Helvetica-BoldOblique",
-      "Courier", "Courier-Bold", "Courier-Oblique", "Courier-BoldOblique",
-      "Symbol", "ZapfDingbats",
-    };
-    for(int i=0; i<14; i++)
-      if (name == default_fonts[i])
-        return true;
-    return false;
-  }
-
-  bool save_Glyph_to_pdf(Glyph *prim, InstanceData inst, struct pdf_doc *pdf)
-  {
-    const Font &font = get_font(prim->font_name);
-    const TTFSimpleGlyph &glyph = font.glyphs[prim->glyph_id];
-    // printf("size %d %d\n", inst.size.x, inst.size.y);
-    // printf("font scale %f\n", 1.0f/font.scale);
-    // printf("font size %f %f\n", inst.size.x/(font.scale*(glyph.xMax-glyph.xMin)), 
-    //                             inst.size.y/(font.scale*(glyph.yMax-glyph.yMin)));
-    // printf("glyphs box %d %d %d %d\n", glyph.xMin, glyph.yMin, glyph.xMax, glyph.yMax);
-    char ch[2];
-    ch[0] = prim->character;
-    ch[1] = '\0';
-    float sz = PPP*prim->font_size;
-    float2 sh = float2(-font.scale*glyph.xMin, font.scale*glyph.yMax);
-    if (is_default_font(prim->font_name))
-      pdf_set_font(pdf, prim->font_name.c_str());
-    else
-    {
-      pdf_set_font(pdf, "Times-Roman");
-      printf("[PDFGen]Warning: font %s is not a default font. It will not be rendered correctly\n", prim->font_name.c_str());
-    }
-    int res = pdf_add_text_flip(pdf, nullptr, ch, sz, PPP*inst.pos.x + sh.x*sz, PPP*inst.pos.y + sh.y*sz, 
-                                float4_to_PDF_color(prim->color));
-    if (res < 0)
-    {
-      fprintf(stderr, "[PDFGen]Error adding glyph: %d\n", res);
-      return false;
-    }
+    pdf.fill_rect(PPP*inst.pos.x, PPP*inst.pos.y, PPP*inst.size.x, PPP*inst.size.y, display_color(prim->color));
     return true;
   }
 
-  bool save_Line_to_pdf(Line *prim, InstanceData inst, struct pdf_doc *pdf)
+  bool save_Rectangle_to_pdf(const Rectangle *prim, InstanceData inst, PdfDocument &pdf)
   {
     float th_pixel = prim->thickness_pixel > 0 ? prim->thickness_pixel : 
                                                  prim->thickness*std::max(inst.size.x, inst.size.y);
-    int res = pdf_add_line_flip(pdf, nullptr, 
-                                PPP*(inst.pos.x + inst.size.x*prim->start.x), PPP*(inst.pos.y + inst.size.y*prim->start.y),
-                                PPP*(inst.pos.x + inst.size.x*  prim->end.x), PPP*(inst.pos.y + inst.size.y*  prim->end.y),
-                                PPP*th_pixel,
-                                float4_to_PDF_color(tonemap(prim->color, 1.0f/2.2f)));
-    if (res < 0)
-    {
-      fprintf(stderr, "[PDFGen]Error adding line: %d\n", res);
-      return false;
-    }
-    return true;
-  }
+    float s = PPP*th_pixel;
+		int2 p0   = inst.pos + int2(prim->region.x*inst.size.x, prim->region.y*inst.size.y);
+    int2 size = int2((prim->region.z-prim->region.x)*inst.size.x, (prim->region.w-prim->region.y)*inst.size.y);
 
-  bool save_PrimitiveFill_to_pdf(PrimitiveFill *prim, InstanceData inst, struct pdf_doc *pdf)
-  {
-    int res = pdf_add_filled_rectangle_flip(pdf, nullptr, PPP*inst.pos.x, PPP*inst.pos.y, 
-                                            PPP*inst.size.x, PPP*inst.size.y, 
-                                            float4_to_PDF_color(tonemap(prim->color, 1.0f/2.2f)));
-    if (res < 0)
-    {
-      fprintf(stderr, "[PDFGen]Error adding rectangle: %d\n", res);
-      return false;
-    }
+    pdf.stroke_rect(PPP*p0.x+s/2, PPP*p0.y+s/2, PPP*size.x-s, PPP*size.y-s, s, display_color(prim->color));
     return true;
   }
 
-  bool save_Rectangle_to_pdf(Rectangle *prim, InstanceData inst, struct pdf_doc *pdf)
+  bool save_Polygon_to_pdf(const Polygon *prim, InstanceData inst, PdfDocument &pdf)
   {
-    float th_pixel = prim->thickness_pixel > 0 ? prim->thickness_pixel : 
-                                                 prim->thickness*std::max(inst.size.x, inst.size.y);
-    float s = PPP*th_pixel;
-		int2 p0   = inst.pos + int2(prim->region.x*prim->size.x, prim->region.y*prim->size.y);
-    int2 size = int2((prim->region.z-prim->region.x)*prim->size.x, (prim->region.w-prim->region.y)*prim->size.y);
-
-    int res = pdf_add_rectangle_flip(pdf, nullptr, 
-                                     PPP*p0.x+s/2, PPP*p0.y+s/2, PPP*size.x-s, PPP*size.y-s,s,
-                                     float4_to_PDF_color(tonemap(prim->color, 1.0f/2.2f)));
-    if (res < 0)
+    std::vector<std::vector<float2>> contours;
+    for (const Polygon::Contour &contour : prim->contours)
     {
-      fprintf(stderr, "[PDFGen]Error adding rectangle: %d\n", res);
-      return false;
+      contours.emplace_back();
+      for (const float2 &p : contour.points)
+        contours.back().push_back(PPP*uv_to_pixels(to_uv(p, inst), inst));
     }
+    if (prim->outline)
+      pdf.stroke_polygon(contours, PPP*prim->outline_thickness*std::max(inst.size.x, inst.size.y), prim->outline_join,
+                         display_color(prim->color));
+    else
+      pdf.fill_polygon(contours, prim->fill_rule, display_color(prim->color));
     return true;
   }
 
-  bool save_Circle_to_pdf(Circle *prim, InstanceData inst, struct pdf_doc *pdf)
+  bool save_Circle_to_pdf(const Circle *prim, InstanceData inst, PdfDocument &pdf)
   {
     float center_x = PPP*(inst.pos.x + inst.size.x*prim->center.x);
     float center_y = PPP*(inst.pos.y + inst.size.y*prim->center.y);
     float radius = PPP*prim->radius*std::max(inst.size.x, inst.size.y);
-    int res = pdf_add_ellipse_flip(pdf, nullptr, center_x, center_y, radius, radius,
-                                   float4_to_PDF_color(tonemap(prim->color, 1.0f/2.2f)));
-    if (res < 0)
-    {
-      fprintf(stderr, "[PDFGen]Error adding circle: %d\n", res);
-      return false;
-    }
+    pdf.fill_ellipse(center_x, center_y, radius, radius, display_color(prim->color));
     return true;
   }
 
   void save_figure_to_pdf(FigurePtr fig, const std::string &filename)
   {
-    Renderer renderer;
     std::vector<Instance> instances = prepare_instances(fig);
     printf("%d instances, figure size %d %d\n", (int)instances.size(), fig->size.x, fig->size.y);    
 
-    //TODO: this can be an option too
-    struct pdf_info info = {
-         .creator = "LiteFugure",
-         .producer = "LiteFugure",
-         .title = "My document",
-         .author = "Author",
-         .subject = "Figure",
-         .date = "Today"
-         };
-
-    struct pdf_doc *pdf = pdf_create(PPP*fig->size.x, PPP*fig->size.y, &info);
-    document_height_points = PPP*fig->size.y;
+    PdfDocument pdf(PPP*fig->size.x, PPP*fig->size.y);
     //our figure is always a single page
-    pdf_append_page(pdf);
-    pdf_set_font(pdf, "Times-Roman"); //TODO: set font for each text field
-    pdf_add_filled_rectangle(pdf, nullptr, 0, 0, PPP*fig->size.x, PPP*fig->size.y, 0, PDF_BLACK, PDF_BLACK);
+    pdf.fill_rect(0, 0, PPP*fig->size.x, PPP*fig->size.y, float4(0, 0, 0, 1));
+
+    std::vector<EmbeddedImage> images;
+    std::vector<int> image_ids;
+    render_embedded_images(instances, fig->size, images);
+    add_images_to_pdf(images, pdf, image_ids);
 
-    for (auto &inst : instances)
+    for (int i = 0; i < instances.size(); i++)
     {
-      //const auto &inst = instances[i];
+      const auto &inst = instances[i];
+      int2 clip_p0, clip_p1;
+      canvas_clip(inst.data, fig->size, clip_p0, clip_p1);
+      pdf.clip_rect(PPP*clip_p0.x, PPP*clip_p0.y, PPP*(clip_p1.x - clip_p0.x), PPP*(clip_p1.y - clip_p0.y));
+      if (inst.prim->getType() == FigureType::Glyph)
+      {
+        i = save_Glyph_run_to_pdf(instances, i, pdf) - 1;
+        continue;
+      }
       switch (inst.prim->getType())
       {
       case FigureType::PrimitiveImage:
-        save_PrimitiveImage_to_pdf(dynamic_cast<PrimitiveImage*>(inst.prim), inst.data, pdf);
+        save_PrimitiveImage_to_pdf(images[i], image_ids[i], pdf);
         break;
       case FigureType::PrimitiveFill:
-        save_PrimitiveFill_to_pdf(dynamic_cast<PrimitiveFill*>(inst.prim), inst.data, pdf);
-        break;
-      case FigureType::Glyph:
-        save_Glyph_to_pdf(dynamic_cast<Glyph*>(inst.prim), inst.data, pdf);
+        save_PrimitiveFill_to_pdf(dynamic_cast<const PrimitiveFill*>(inst.prim), inst.data, pdf);
         break;
       case FigureType::Line:
-        save_Line_to_pdf(dynamic_cast<Line*>(inst.prim), inst.data, pdf);
+        save_Line_to_pdf(dynamic_cast<const Line*>(inst.prim), inst.data, pdf);
+        break;
+      case FigureType::Polygon:
+        save_Polygon_to_pdf(dynamic_cast<const Polygon*>(inst.prim), inst.data, pdf);
         break;
       case FigureType::Circle:
-        save_Circle_to_pdf(dynamic_cast<Circle*>(inst.prim), inst.data, pdf);
+        save_Circle_to_pdf(dynamic_cast<const Circle*>(inst.prim), inst.data, pdf);
         break;
       case FigureType::Rectangle:
-        save_Rectangle_to_pdf(dynamic_cast<Rectangle*>(inst.prim), inst.data, pdf);
+        save_Rectangle_to_pdf(dynamic_cast<const Rectangle*>(inst.prim), inst.data, pdf);
         break;
       default:
         printf("[save_figure_to_pdf] Primitive type %d not supported\n", (int)(inst.prim->getType()));
@@ -300,7 +164,6 @@ namespace LiteFigure
       }
     }
 
-    pdf_save(pdf, filename.c_str());
-    pdf_destroy(pdf);
+    pdf.save(filename);
   }
 };
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "figure.h"
 #include "stb_image.h"
+#include <algorithm>
 #include <cstdio>
 #include <filesystem>
+#include <map>
+#include <mutex>
 
 #define TINYEXR_USE_MINIZ      0
 #define TINYEXR_USE_STB_ZLIB   1
@@ -153,18 +156,36 @@ namespace LiteFigure
     return size;
   }
 
-  void Primitive::prepareInstances(int2 pos, std::vector<Instance> &out_instances)
+  void Primitive::prepareInstances(int2 pos, const ClipRect &clip, std::vector<Instance> &out_instances)
   {
     Instance inst;
     inst.prim = this;
     inst.data.pos = pos;
     inst.data.size = size;
+    inst.data.clip_min = clip.p0;
+    inst.data.clip_max = clip.p1;
     
     out_instances.push_back(inst);    
   }
 
+  // modification time and size of the file, empty if it does not exist
+  static std::string get_file_version(const std::string &path)
+  {
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+      return "";
+    uintmax_t file_size = std::filesystem::file_size(path, ec);
+    return ec ? "" : std::to_string(mtime.time_since_epoch().count()) + "|" + std::to_string(file_size);
+  }
+
   bool PrimitiveImage::load(const Block *blk)
   {
+    if (blk != settings.get())
+    {
+      settings = std::make_shared<Block>();
+      settings->copy(blk);
+    }
     size = blk->get_ivec2("size", size);
     std::string path = blk->get_string("path", "");
     if (path == "")
@@ -183,22 +204,52 @@ namespace LiteFigure
     else
       tonemap_param_id = -1;
 
-    bool status = load_image(path.c_str(), ext.c_str(), gamma, tonemap_param_id >=0, tonemap_range, monochrome, flip_y, image);
-    if (!status)
-      return false;
+    // decoded images are shared by all figures that load the same version of the file with the
+    // same parameters while any of them is alive. A file edited on disk (e.g. with --watch) has
+    // a different modification time or size, so it is decoded again
+    std::string version = get_file_version(path);
+    char key_params[128];
+    snprintf(key_params, sizeof(key_params), "|%d|%d|%f|%d|%f|%f", (int)monochrome, (int)flip_y, gamma,
+             tonemap_param_id >= 0, tonemap_range.x, tonemap_range.y);
+    std::string key = path + "|" + version + key_params;
+    static std::mutex image_cache_mutex;
+    static std::map<std::string, std::weak_ptr<const LiteImage::Image2D<float4>>> image_cache;
+    std::shared_ptr<const LiteImage::Image2D<float4>> decoded;
+    {
+      std::lock_guard<std::mutex> lock(image_cache_mutex);
+      auto it = image_cache.find(key);
+      if (it != image_cache.end())
+        decoded = it->second.lock();
+    }
+    if (!decoded)
+    {
+      // decoded without the lock, figures loaded in parallel do not wait for each other's images
+      auto new_image = std::make_shared<LiteImage::Image2D<float4>>();
+      bool status = load_image(path.c_str(), ext.c_str(), gamma, tonemap_param_id >=0, tonemap_range, monochrome, flip_y, *new_image);
+      if (!status)
+        return false;
+
+      //TODO: support images with alpha
+      for (int i=0;i<new_image->height()*new_image->width();i++)
+        new_image->data()[i].w = 1.0f;
+      decoded = new_image;
 
-    //TODO: support images with alpha
-    for (int i=0;i<image.height()*image.width();i++)
-      image.data()[i].w = 1.0f;
+      std::lock_guard<std::mutex> lock(image_cache_mutex);
+      for (auto it = image_cache.begin(); it != image_cache.end();)
+        it = it->second.expired() ? image_cache.erase(it) : std::next(it);
+      image_cache[key] = decoded;
+    }
+    image = decoded;
+    file_version = version;
 
-    if (image.width() < 1 || image.height() < 1)
+    if (image->width() < 1 || image->height() < 1)
     {
       printf("[PrimitiveImage::load] image is invalid\n");
       return false;
     }
     else if (size.x < 1 || size.y < 1)
     {
-      size = int2(image.width(), image.height());
+      size = int2(image->width(), image->height());
     }
 
     LiteImage::Sampler::AddressMode address_mode = LiteImage::Sampler::AddressMode::CLAMP;
@@ -212,6 +263,15 @@ namespace LiteFigure
     return true;
   }
 
+  bool PrimitiveImage::update()
+  {
+    // a file that can not be decoded yet (e.g. it is still being written) keeps the old image,
+    // it is loaded again on the next update
+    if (!settings || get_file_version(settings->get_string("path", "")) == file_version)
+      return false;
+    return load(settings.get());
+  }
+
   bool PrimitiveFill::load(const Block *blk)
   {
     size = blk->get_ivec2("size", size);
@@ -291,9 +351,12 @@ namespace LiteFigure
   {
     size = blk->get_ivec2("size", size);
     color = blk->get_vec4("color", color);
+    fill_rule = (FillRule)blk->get_enum("fill_rule", (uint32_t)fill_rule);
+    antialiased = blk->get_bool("antialiased", antialiased);
     outline = blk->get_bool("outline", outline);
     outline_thickness = blk->get_double("outline_thickness", outline_thickness);
     outline_antialiased = blk->get_bool("outline_antialiased", outline_antialiased);
+    outline_join = (LineJoin)blk->get_enum("outline_join", (uint32_t)outline_join);
     Block *points_blk = blk->get_block("points");
     Block *contours_blk = blk->get_block("contours");
     if (!points_blk && !contours_blk)
@@ -360,6 +423,23 @@ namespace LiteFigure
       }
     }
 
+    edges.clear();
+    for (auto &c : contours)
+    {
+      for (int i = 0; i < c.points.size(); i++)
+      {
+        float2 a = c.points[i];
+        float2 b = c.points[(i + 1) % c.points.size()];
+        if (a.y == b.y)
+          continue;
+        if (a.y < b.y)
+          edges.push_back(Edge{a, b, 1});
+        else
+          edges.push_back(Edge{b, a, -1});
+      }
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.p0.y < b.p0.y; });
+
     return true;
   }
 }
\ No newline at end of file
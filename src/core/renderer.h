@@ -1,5 +1,6 @@
 #pragma once
 #include "figure.h"
+#include <bitset>
 
 namespace LiteFigure
 {
@@ -17,24 +18,107 @@ namespace LiteFigure
 	{
 		return float2(v.x, v.y);
 	}
+
+	// placement of one instance as the rasterizers read it. It is taken from an InstanceData or
+	// straight from the arrays of InstanceBuffer, the uv transform is referenced, not copied
+	struct InstanceView
+	{
+		InstanceView(const InstanceData &data)
+			: pos(data.pos), size(data.size), clip_min(data.clip_min), clip_max(data.clip_max), uv_transform(data.uv_transform) {}
+		InstanceView(int2 pos, int2 size, int2 clip_min, int2 clip_max, const LiteMath::float3x3 &uv_transform)
+			: pos(pos), size(size), clip_min(clip_min), clip_max(clip_max), uv_transform(uv_transform) {}
+
+		int2 pos;
+		int2 size;
+		int2 clip_min;
+		int2 clip_max;
+		const LiteMath::float3x3 &uv_transform;
+	};
+
+	// part of the instance rect that can be written, in instance-local pixels, [p0, p1)
+	static inline void visible_span(const InstanceView &instance, const LiteImage::Image2D<float4> &out, int2 &p0, int2 &p1)
+	{
+		p0 = max(instance.clip_min - instance.pos, int2(0, 0));
+		p1 = min(min(instance.clip_max, int2(out.width(), out.height())) - instance.pos, instance.size);
+	}
   
+  // compact structure-of-arrays copy of instance list, reserved from a counting pass. Equal uv transforms
+  // and primitives are stored once, consecutive instances of the same type form runs that are rendered
+  // without per-instance dispatch
+  struct InstanceBuffer
+  {
+    struct Run
+    {
+      FigureType type;
+      uint32_t begin;
+      uint32_t end;
+    };
+
+    void build(const std::vector<Instance> &instances);
+    uint32_t size() const { return types.size(); }
+    bool visible(uint32_t id, int2 canvas_size) const
+    {
+      return std::max(bounds_mins[id].x, 0) < std::min(bounds_maxs[id].x, canvas_size.x) &&
+             std::max(bounds_mins[id].y, 0) < std::min(bounds_maxs[id].y, canvas_size.y);
+    }
+    InstanceView view(uint32_t id) const
+    {
+      return InstanceView(positions[id], sizes[id], bounds_mins[id], bounds_maxs[id], transforms[transform_ids[id]]);
+    }
+
+    std::vector<FigureType> types;
+    std::vector<uint32_t> prim_ids;      // index in prims
+    std::vector<uint32_t> instance_ids;  // index in the instance list the buffer was built from
+    std::vector<int2> positions;
+    std::vector<int2> sizes;
+    std::vector<int2> bounds_mins;       // instance rect intersected with its clip rect, [min, max)
+    std::vector<int2> bounds_maxs;
+    std::vector<uint32_t> transform_ids; // index in transforms
+    std::vector<const Primitive *> prims;
+    std::vector<LiteMath::float3x3> transforms;
+    std::vector<Run> runs;
+  };
+
+  // sample positions inside a pixel for multisample antialiasing. Every sample lies in its own
+  // sub-row (rotated grid), samples are sorted by y so scanline rasterizers can use them as sub-scanlines.
+  // Coverage of a pixel is stored as a mask with one bit per sample
+  struct SamplePattern
+  {
+    static constexpr int MAX_SAMPLES = 16;
+    static SamplePattern create(int samples);
+
+    float resolve(uint32_t mask) const { return float(std::bitset<MAX_SAMPLES>(mask).count()) / count; }
+    uint32_t full_mask() const { return (1u << count) - 1; }
+
+    int count = 0; // 0 if multisampling is off
+    float2 offsets[MAX_SAMPLES];
+  };
+
   class Renderer
   {
   public:
     Renderer() = default;
+    Renderer(const RenderSettings &settings) : samples(SamplePattern::create(settings.msaa_samples)) {}
     ~Renderer() = default;
 
     // renders figure into out image, returns true on success
     void render_instance(const Instance &inst, LiteImage::Image2D<float4> &out) const;
+    // renders all instances in order, one type switch per run of same-type instances
+    void render_instances(const InstanceBuffer &buffer, LiteImage::Image2D<float4> &out) const;
 
 	private:
-		void render(const PrimitiveImage &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
-		void render(const PrimitiveFill &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
-		void render(const Line &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
-		void render(const Circle &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
-		void render(const Polygon &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
-		void render(const Rectangle &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
-    void render(const Glyph &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const;
+		SamplePattern samples;
+
+		template <typename T>
+		void render_run(const InstanceBuffer &buffer, const InstanceBuffer::Run &run, LiteImage::Image2D<float4> &out) const;
+
+		void render(const PrimitiveImage &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
+		void render(const PrimitiveFill &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
+		void render(const Line &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
+		void render(const Circle &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
+		void render(const Polygon &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
+		void render(const Rectangle &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
+    void render(const Glyph &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const;
   };
 
 	struct TTFSimpleGlyph;
@@ -1,7 +1,33 @@
 #include "renderer.h"
+#include <cstring>
+#include <unordered_map>
 
 namespace LiteFigure
 {
+	SamplePattern SamplePattern::create(int samples)
+	{
+		SamplePattern pattern;
+		if (samples <= 1)
+			return pattern;
+		if (samples != 4 && samples != 8 && samples != 16)
+		{
+			printf("[SamplePattern] %d samples per pixel are not supported, use 4, 8 or 16\n", samples);
+			samples = samples < 4 ? 4 : (samples < 8 ? 8 : 16);
+		}
+
+		// n-rooks pattern: sample i is in row i, columns are a rotated grid for 4 samples
+		// and a lattice (i*step) % n for 8 and 16
+		const int columns_4[4] = {1, 3, 0, 2};
+		int step = samples == 8 ? 3 : 5;
+		pattern.count = samples;
+		for (int i = 0; i < samples; i++)
+		{
+			int column = samples == 4 ? columns_4[i] : (i * step) % samples;
+			pattern.offsets[i] = float2((column + 0.5f) / samples, (i + 0.5f) / samples);
+		}
+		return pattern;
+	}
+
 	void Renderer::render_instance(const Instance &inst, LiteImage::Image2D<float4> &out) const
 	{
 		if (!inst.prim)
@@ -36,32 +62,202 @@ namespace LiteFigure
 		}
 	}
 
-	void Renderer::render(const PrimitiveImage &prim, const InstanceData &instance, LiteImage::Image2D<float4> &out) const
+	// FNV-1a over the bytes of the matrix, equal transforms are bitwise equal
+	struct TransformHash
+	{
+		size_t operator()(const LiteMath::float3x3 &m) const
+		{
+			uint64_t h = 14695981039346656037ull;
+			const uint8_t *bytes = (const uint8_t *)&m;
+			for (size_t i = 0; i < sizeof(m); i++)
+				h = (h ^ bytes[i]) * 1099511628211ull;
+			return size_t(h);
+		}
+	};
+	struct TransformEqual
+	{
+		bool operator()(const LiteMath::float3x3 &a, const LiteMath::float3x3 &b) const
+		{
+			return memcmp(&a, &b, sizeof(a)) == 0;
+		}
+	};
+
+	void InstanceBuffer::build(const std::vector<Instance> &instances)
+	{
+		// counting pass, so that every array is allocated once
+		uint32_t count = 0;
+		uint32_t run_count = 0;
+		FigureType last_type = FigureType::Unknown;
+		for (const Instance &inst : instances)
+		{
+			if (!inst.prim)
+				continue;
+			FigureType type = inst.prim->getType();
+			run_count += (count == 0 || type != last_type) ? 1 : 0;
+			last_type = type;
+			count++;
+		}
+
+		types.clear();
+		prim_ids.clear();
+		instance_ids.clear();
+		positions.clear();
+		sizes.clear();
+		bounds_mins.clear();
+		bounds_maxs.clear();
+		transform_ids.clear();
+		prims.clear();
+		transforms.clear();
+		runs.clear();
+		types.reserve(count);
+		prim_ids.reserve(count);
+		instance_ids.reserve(count);
+		positions.reserve(count);
+		sizes.reserve(count);
+		bounds_mins.reserve(count);
+		bounds_maxs.reserve(count);
+		transform_ids.reserve(count);
+		runs.reserve(run_count);
+
+		// most instances share one of a few transforms (usually identity), markers and glyphs share
+		// primitives. Neighbours are usually equal, so the previous instance is checked before the maps
+		std::unordered_map<LiteMath::float3x3, uint32_t, TransformHash, TransformEqual> transform_map;
+		std::unordered_map<const Primitive *, uint32_t> prim_map;
+		for (uint32_t i = 0; i < instances.size(); i++)
+		{
+			const Instance &inst = instances[i];
+			if (!inst.prim)
+				continue;
+
+			uint32_t transform_id;
+			if (!transform_ids.empty() && TransformEqual()(transforms[transform_ids.back()], inst.data.uv_transform))
+				transform_id = transform_ids.back();
+			else
+			{
+				auto it = transform_map.emplace(inst.data.uv_transform, uint32_t(transforms.size())).first;
+				if (it->second == transforms.size())
+					transforms.push_back(inst.data.uv_transform);
+				transform_id = it->second;
+			}
+
+			uint32_t prim_id;
+			if (!prim_ids.empty() && prims[prim_ids.back()] == inst.prim)
+				prim_id = prim_ids.back();
+			else
+			{
+				auto it = prim_map.emplace(inst.prim, uint32_t(prims.size())).first;
+				if (it->second == prims.size())
+					prims.push_back(inst.prim);
+				prim_id = it->second;
+			}
+
+			FigureType type = inst.prim->getType();
+			if (runs.empty() || runs.back().type != type)
+				runs.push_back(Run{type, size(), size()});
+			runs.back().end++;
+
+			types.push_back(type);
+			prim_ids.push_back(prim_id);
+			instance_ids.push_back(i);
+			positions.push_back(inst.data.pos);
+			sizes.push_back(inst.data.size);
+			bounds_mins.push_back(max(inst.data.clip_min, inst.data.pos));
+			bounds_maxs.push_back(min(inst.data.clip_max, inst.data.pos + inst.data.size));
+			transform_ids.push_back(transform_id);
+		}
+	}
+
+	template <typename T>
+	void Renderer::render_run(const InstanceBuffer &buffer, const InstanceBuffer::Run &run, LiteImage::Image2D<float4> &out) const
 	{
-		for (int y = 0; y < std::min<int>(prim.size.y, out.height() - instance.pos.y); y++)
+		const int2 canvas_size = int2(out.width(), out.height());
+		for (uint32_t i = run.begin; i < run.end; i++)
 		{
-			for (int x = 0; x < std::min<int>(prim.size.x, out.width() - instance.pos.x); x++)
+			if (buffer.visible(i, canvas_size))
+				render(static_cast<const T &>(*buffer.prims[buffer.prim_ids[i]]), buffer.view(i), out);
+		}
+	}
+
+	void Renderer::render_instances(const InstanceBuffer &buffer, LiteImage::Image2D<float4> &out) const
+	{
+		for (const InstanceBuffer::Run &run : buffer.runs)
+		{
+			switch (run.type)
+			{
+			case FigureType::PrimitiveImage:
+				render_run<PrimitiveImage>(buffer, run, out);
+				break;
+			case FigureType::PrimitiveFill:
+				render_run<PrimitiveFill>(buffer, run, out);
+				break;
+			case FigureType::Line:
+				render_run<Line>(buffer, run, out);
+				break;
+			case FigureType::Circle:
+				render_run<Circle>(buffer, run, out);
+				break;
+			case FigureType::Polygon:
+				render_run<Polygon>(buffer, run, out);
+				break;
+			case FigureType::Glyph:
+				render_run<Glyph>(buffer, run, out);
+				break;
+			case FigureType::Rectangle:
+				render_run<Rectangle>(buffer, run, out);
+				break;
+			default:
+				printf("ERROR: trying to render unrenderable primitve (type %d)\n", (int)run.type);
+				break;
+			}
+		}
+	}
+
+	void Renderer::render(const PrimitiveImage &prim, const InstanceView &instance, LiteImage::Image2D<float4> &out) const
+	{
+		// px, py - position in pixels inside the instance
+		auto sample = [&](float px, float py) -> float4
+		{
+			float3 uv3 = instance.uv_transform * float3(px / float(instance.size.x), py / float(instance.size.y), 1);
+			if (prim.sampler.addressU == LiteImage::Sampler::AddressMode::BORDER && (uv3.x <= 0 || uv3.x >= 1))
+				return prim.sampler.borderColor;
+			else if (prim.sampler.addressV == LiteImage::Sampler::AddressMode::BORDER && (uv3.y <= 0 || uv3.y >= 1))
+				return prim.sampler.borderColor;
+			else
+				return prim.image->sample(prim.sampler, float2(uv3.x, uv3.y));
+		};
+
+		int2 p0, p1;
+		visible_span(instance, out, p0, p1);
+		for (int y = p0.y; y < p1.y; y++)
+		{
+			for (int x = p0.x; x < p1.x; x++)
 			{
-				float3 uv3 = instance.uv_transform * float3((x+0.5f) / float(prim.size.x), (y+0.5f) / float(prim.size.y), 1);
 				float4 c;
-				if (prim.sampler.addressU == LiteImage::Sampler::AddressMode::BORDER && (uv3.x <= 0 || uv3.x >= 1))
-					c = prim.sampler.borderColor;
-				else if (prim.sampler.addressV == LiteImage::Sampler::AddressMode::BORDER && (uv3.y <= 0 || uv3.y >= 1))
-					c = prim.sampler.borderColor;
+				if (samples.count > 0)
+				{
+					c = float4(0, 0, 0, 0);
+					for (int s = 0; s < samples.count; s++)
+						c += sample(x + samples.offsets[s].x, y + samples.offsets[s].y);
+					c /= float(samples.count);
+				}
 				else
-					c = prim.image.sample(prim.sampler, float2(uv3.x, uv3.y));
+				{
+					c = sample(x + 0.5f, y + 0.5f);
+				}
 				uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
 				out[pixel] = alpha_blend(c, out[pixel]);
 			}
 		}
 	}
 
-	void Renderer::render(const PrimitiveFill &prim, const InstanceData &instance, LiteImage::Image2D<float4> &out) const
+	void Renderer::render(const PrimitiveFill &prim, const InstanceView &instance, LiteImage::Image2D<float4> &out) const
 	{
 		float4 c = prim.color;
-		for (int y = instance.pos.y; y < std::min<int>(out.height(), instance.pos.y + prim.size.y); y++)
+		int2 p0, p1;
+		visible_span(instance, out, p0, p1);
+		for (int y = instance.pos.y + p0.y; y < instance.pos.y + p1.y; y++)
 		{
-			for (int x = instance.pos.x; x < std::min<int>(out.width(), instance.pos.x + prim.size.x); x++)
+			for (int x = instance.pos.x + p0.x; x < instance.pos.x + p1.x; x++)
 			{
 				out[uint2(x, y)] = alpha_blend(c, out[uint2(x, y)]);
 			}
@@ -69,41 +265,45 @@ namespace LiteFigure
 	}
 
 
-	void Renderer::render(const Rectangle &prim, const InstanceData &instance, LiteImage::Image2D<float4> &out) const
+	void Renderer::render(const Rectangle &prim, const InstanceView &instance, LiteImage::Image2D<float4> &out) const
 	{
 		int border_pixels = prim.thickness_pixel > 0 ? prim.thickness_pixel : 
-							std::max<int>(1, round(prim.thickness*std::max(prim.size.x, prim.size.y)));
-		border_pixels = std::min(border_pixels, (std::min(prim.size.x, prim.size.y)+1)/2);
+							std::max<int>(1, round(prim.thickness*std::max(instance.size.x, instance.size.y)));
+		border_pixels = std::min(border_pixels, (std::min(instance.size.x, instance.size.y)+1)/2);
 		float4 c = prim.color;
-		int2 p0 = instance.pos + int2(prim.region.x*prim.size.x, prim.region.y*prim.size.y);
-		int2 p1 = instance.pos + int2(prim.region.z*prim.size.x, prim.region.w*prim.size.y);
-
-		for (int y=p0.y; y<p0.y+border_pixels; y++)
-			for (int x=p0.x; x<p1.x; x++)
-				out[uint2(x, y)] = alpha_blend(c, out[uint2(x, y)]);
+		int2 p0 = int2(prim.region.x*instance.size.x, prim.region.y*instance.size.y);
+		int2 p1 = int2(prim.region.z*instance.size.x, prim.region.w*instance.size.y);
+		int2 clip0, clip1;
+		visible_span(instance, out, clip0, clip1);
 
-		for (int y=p0.y+border_pixels; y<p1.y-border_pixels; y++)
+		// fills [x0, x1) x [y0, y1) in local coordinates
+		auto fill_span = [&](int x0, int x1, int y0, int y1)
 		{
-			for (int x=p0.x; x<p0.x+border_pixels; x++)
-				out[uint2(x, y)] = alpha_blend(c, out[uint2(x, y)]);
-			for (int x=p1.x-border_pixels; x<p1.x; x++)
-				out[uint2(x, y)] = alpha_blend(c, out[uint2(x, y)]);
-		}
+			for (int y = std::max(y0, clip0.y); y < std::min(y1, clip1.y); y++)
+			{
+				for (int x = std::max(x0, clip0.x); x < std::min(x1, clip1.x); x++)
+				{
+					uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
+					out[pixel] = alpha_blend(c, out[pixel]);
+				}
+			}
+		};
 
-		for (int y=p1.y-border_pixels; y<p1.y; y++)
-			for (int x=p0.x; x<p1.x; x++)
-				out[uint2(x, y)] = alpha_blend(c, out[uint2(x, y)]);
+		fill_span(p0.x, p1.x, p0.y, p0.y + border_pixels);
+		fill_span(p0.x, p0.x + border_pixels, p0.y + border_pixels, p1.y - border_pixels);
+		fill_span(p1.x - border_pixels, p1.x, p0.y + border_pixels, p1.y - border_pixels);
+		fill_span(p0.x, p1.x, p1.y - border_pixels, p1.y);
 	}
 
-	void Renderer::render(const Line &prim, const InstanceData &instance, LiteImage::Image2D<float4> &out) const
+	void Renderer::render(const Line &prim, const InstanceView &instance, LiteImage::Image2D<float4> &out) const
 	{
 		float2 p0 = to_float2(instance.uv_transform * float3(prim.start.x, prim.start.y, 1));
 		float2 p1 = to_float2(instance.uv_transform * float3(prim.end.x, prim.end.y, 1));
 		p0 = LiteMath::clamp(p0, float2(0, 0), float2(1, 1));
 		p1 = LiteMath::clamp(p1, float2(0, 0), float2(1, 1));
 
-		int w = prim.size.x;
-		int h = prim.size.y;
+		int w = instance.size.x;
+		int h = instance.size.y;
 		float x0 = p0.x * w, y0 = p0.y * h;
 		float x1 = p1.x * w, y1 = p1.y * h;
 		float dx = x1 - x0, dy = y1 - y0;
@@ -115,14 +315,56 @@ namespace LiteFigure
 		bool horizontal = std::abs(x1 - x0) > fmax(w, h)*std::abs(y1 - y0);
 		float perp_x = -dy / length_pixel;
     float perp_y = dx / length_pixel;
-		for (int y = std::max(0, int(std::min(y0, y1) - T / 2.0f)); y < std::min(h, int(std::max(y0, y1) + T / 2.0f)); ++y)
+		// returns true if point (in pixels) is inside the line and its color
+		auto shade = [&](float px, float py, bool antialiased, float4 &c) -> bool
 		{
-			int x_start = 0;
-			int x_end = w;
+			// Compute projection parameter t
+			float len2 = dx * dx + dy * dy;
+			float t = len2 > 0 ? ((px - x0) * dx + (py - y0) * dy) / len2 : 0;
+			t = fmax(0, fmin(1, t));
+			// Closest point on segment
+			float cx = x0 + t * dx, cy = y0 + t * dy;
+			float dist = sqrtf((px - cx) * (px - cx) + (py - cy) * (py - cy));
+			if (dist >= T / 2.0f)
+				return false;
+
+			// Optional: for anti-aliasing, fade edge
+			float alpha = antialiased ? std::min(1.0f, T / 2.0f - dist) : 1;
+			c = prim.color * float4(1, 1, 1, alpha);
+
+			if (prim.style == LineStyle::Dashed)
+			{
+				int t_pixel = int(t * length_pixel);
+				c.w = t_pixel % dash_step_pixel < dash_length_pixel ? 1 : 0;
+			}
+			else if (prim.style == LineStyle::Dotted)
+			{
+				int t_pixel = int(t * length_pixel);
+				if (t_pixel % dash_step_pixel < dash_length_pixel)
+				{
+					float t_center = float((t_pixel/dash_step_pixel) * dash_step_pixel + 0.5f*dash_length_pixel)/length_pixel;
+					float2 center = float2(x0 + t_center * dx, y0 + t_center * dy);
+					float dist_center = sqrtf((px - center.x) * (px - center.x) + (py - center.y) * (py - center.y));
+					c.w = dist_center < T / 2.0f ? 1 : 0;
+				}
+				else
+				{
+					c.w = 0;
+				}
+			}
+			return true;
+		};
+
+		int2 clip0, clip1;
+		visible_span(instance, out, clip0, clip1);
+		for (int y = std::max(clip0.y, int(std::min(y0, y1) - T / 2.0f)); y < std::min(clip1.y, int(std::max(y0, y1) + T / 2.0f)); ++y)
+		{
+			int x_start = clip0.x;
+			int x_end = clip1.x;
 			if (horizontal)
 			{
-				x_start = std::max(0, int(std::min(x0, x1) - T / 2.0f));
-				x_end = std::min(w, int(std::max(x0, x1) + T / 2.0f));
+				x_start = std::max(clip0.x, int(std::min(x0, x1) - T / 2.0f));
+				x_end = std::min(clip1.x, int(std::max(x0, x1) + T / 2.0f));
 			}
 			else
 			{
@@ -130,380 +372,426 @@ namespace LiteFigure
 				float x01 = (x0 - perp_x * T / 2.0f) + dx * ((y+1 - (y0 - perp_y * T / 2.0f)) / dy);
 				float x10 = (x0 + perp_x * T / 2.0f) + dx * ((y - (y0 + perp_y * T / 2.0f)) / dy);
 				float x11 = (x0 + perp_x * T / 2.0f) + dx * ((y+1 - (y0 + perp_y * T / 2.0f)) / dy);
-				x_start = std::max(0, int(std::min(std::min(x00, x01), std::min(x10, x11))));
-				x_end = std::min(w, int(std::max(std::max(x00, x01), std::max(x10, x11))));
+				x_start = std::max(clip0.x, int(std::min(std::min(x00, x01), std::min(x10, x11))));
+				x_end = std::min(clip1.x, int(std::max(std::max(x00, x01), std::max(x10, x11))));
 			}
 
 			for (int x = x_start; x < x_end; ++x)
 			{
-				float px = x + 0.5f, py = y + 0.5f;
-				// Compute projection parameter t
-				float len2 = dx * dx + dy * dy;
-				float t = len2 > 0 ? ((px - x0) * dx + (py - y0) * dy) / len2 : 0;
-				t = fmax(0, fmin(1, t));
-				// Closest point on segment
-				float cx = x0 + t * dx, cy = y0 + t * dy;
-				float dist = sqrtf((px - cx) * (px - cx) + (py - cy) * (py - cy));
-				if (dist < T / 2.0f)
+				float4 c;
+				if (samples.count > 0)
 				{
-					// Optional: for anti-aliasing, fade edge
-					float alpha = prim.antialiased ? std::min(1.0f, T / 2.0f - dist) : 1;
-					float4 c = prim.color * float4(1, 1, 1, alpha);
-
-					if (prim.style == LineStyle::Dashed)
-					{
-						int t_pixel = int(t * length_pixel);
-						c.w = t_pixel % dash_step_pixel < dash_length_pixel ? 1 : 0;
-					}
-					else if (prim.style == LineStyle::Dotted)
+					uint32_t mask = 0;
+					for (int s = 0; s < samples.count; s++)
 					{
-						int t_pixel = int(t * length_pixel);
-						if (t_pixel % dash_step_pixel < dash_length_pixel)
-						{
-							float t_center = float((t_pixel/dash_step_pixel) * dash_step_pixel + 0.5f*dash_length_pixel)/length_pixel;
-							float2 center = float2(x0 + t_center * dx, y0 + t_center * dy);
-							float dist_center = sqrtf((px - center.x) * (px - center.x) + (py - center.y) * (py - center.y));
-							c.w = dist_center < T / 2.0f ? 1 : 0;
-						}
-						else
-						{
-							c.w = 0;
-						}
+						if (shade(x + samples.offsets[s].x, y + samples.offsets[s].y, false, c) && c.w > 0)
+							mask |= 1u << s;
 					}
-
-					uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
-					out[pixel] = alpha_blend(c, out[pixel]);
+					if (mask == 0)
+						continue;
+					c = prim.color * float4(1, 1, 1, samples.resolve(mask));
 				}
-			}
-		}
-	}
-
-	void Renderer::render(const Circle &prim, const InstanceData &instance, LiteImage::Image2D<float4> &out) const
-	{
-		float2 scale = float2(prim.size.x, prim.size.y) / fmax(prim.size.x, prim.size.y);
-		float2 r2 = prim.radius / scale;
-		float2 p0 = to_float2(instance.uv_transform * float3(prim.center.x - r2.x, prim.center.y - r2.y, 1));
-		float2 p1 = to_float2(instance.uv_transform * float3(prim.center.x + r2.x, prim.center.y + r2.y, 1));
-		int min_y = int(floor(fmin(p0.y, p1.y) * prim.size.y))- 1;
-		int max_y = int(ceil(fmax(p0.y, p1.y) * prim.size.y)) + 1;
-		for (int y = std::max(0, min_y); y < std::min(prim.size.y, max_y); y++)
-		{
-			for (int x = 0; x < prim.size.x; x++)
-			{
-				float2 p = to_float2(instance.uv_transform * float3(x / (prim.size.x + 0.5), y / (prim.size.y + 0.5), 1));
-				float dist = LiteMath::length(scale * (p - prim.center));
-				if (dist <= prim.radius)
+				else if (!shade(x + 0.5f, y + 0.5f, prim.antialiased, c))
 				{
-					// Optional: for anti-aliasing, fade edge
-					float alpha = prim.antialiased ? std::min(1.0f, std::max(prim.size.x, prim.size.y) * (prim.radius - dist)) : 1;
-					float4 c = prim.color * float4(1, 1, 1, alpha);
-					uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
-					out[pixel] = alpha_blend(c, out[pixel]);
+					continue;
 				}
+
+				uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
+				out[pixel] = alpha_blend(c, out[pixel]);
 			}
 		}
 	}
 
-	struct Triangle
+	// signed area of intersection of the disc |v| <= r with triangle (0, a, b): sectors where the
+	// edge ab is outside the disc and the triangle where it is inside
+	static float disc_triangle_area(float2 a, float2 b, float r)
 	{
-		float2 p1, p2, p3;
-
-		Triangle(const float2 &a, const float2 &b, const float2 &c) : p1(a), p2(b), p3(c) {}
-	};
+		auto sector = [r](float2 u, float2 v) { return 0.5f * r * r * atan2f(u.x * v.y - u.y * v.x, LiteMath::dot(u, v)); };
+		float2 d = b - a;
+		float A = LiteMath::dot(d, d);
+		float B = LiteMath::dot(a, d);
+		float D = B * B - A * (LiteMath::dot(a, a) - r * r);
+		if (A < 1e-20f || D <= 0)
+			return sector(a, b);
+		float t0 = std::min(1.0f, std::max(0.0f, (-B - sqrtf(D)) / A));
+		float t1 = std::min(1.0f, std::max(0.0f, (-B + sqrtf(D)) / A));
+		float2 p0 = a + t0 * d;
+		float2 p1 = a + t1 * d;
+		return sector(a, p0) + 0.5f * (p0.x * p1.y - p0.y * p1.x) + sector(p1, b);
+	}
 
-	class PolygonTriangulator
+	void Renderer::render(const Circle &prim, const InstanceView &instance, LiteImage::Image2D<float4> &out) const
 	{
-	public:
-		// Calculate signed area of polygon (positive = counter-clockwise, negative = clockwise)
-		static float signedArea(const std::vector<float2> &points)
-		{
-			float area = 0.0f;
-			size_t n = points.size();
-			for (size_t i = 0; i < n; i++)
-			{
-				size_t j = (i + 1) % n;
-				area += (points[j].x - points[i].x) * (points[j].y + points[i].y);
-			}
-			return area * 0.5f;
-		}
-
-		// Check if point is inside triangle using barycentric coordinates
-		static bool pointInTriangle(const float2 &p, const float2 &a, const float2 &b,
-																const float2 &c, float eps = 1e-10f)
-		{
-			float denom = (b.y - c.y) * (a.x - c.x) + (c.x - b.x) * (a.y - c.y);
-			if (std::abs(denom) < 1e-10f)
-				return false; // Degenerate triangle
-
-			float alpha = ((b.y - c.y) * (p.x - c.x) + (c.x - b.x) * (p.y - c.y)) / denom;
-			float beta = ((c.y - a.y) * (p.x - c.x) + (a.x - c.x) * (p.y - c.y)) / denom;
-			float gamma = 1.0f - alpha - beta;
-
-			return alpha > eps && beta > eps && gamma > eps;
-		}
+		int2 clip0, clip1;
+		visible_span(instance, out, clip0, clip1);
+		if (clip0.x >= clip1.x || clip0.y >= clip1.y)
+			return;
 
-		// Calculate cross product for orientation test
-		static float crossProduct(const float2 &o, const float2 &a, const float2 &b)
-		{
-			return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
-		}
+		// circle is |scale * (p - center)| <= radius, p is the uv_transform of pixel uv.
+		// This is affine in pixel coordinates: v(x, y) = v0 + x*vx + y*vy, an ellipse in general
+		float2 scale = float2(instance.size.x, instance.size.y) / fmax(instance.size.x, instance.size.y);
+		float2 inv_size = float2(1.0f / instance.size.x, 1.0f / instance.size.y);
+		float2 v0 = scale * (to_float2(instance.uv_transform * float3(0.5f * inv_size.x, 0.5f * inv_size.y, 1)) - prim.center);
+		float2 vx = scale * to_float2(instance.uv_transform * float3(inv_size.x, 0, 0));
+		float2 vy = scale * to_float2(instance.uv_transform * float3(0, inv_size.y, 0));
+		float det = vx.x * vy.y - vx.y * vy.x;
+		if (std::abs(det) < 1e-12f)
+			return;
 
-		// Check if triangle formed by three consecutive vertices is an ear
-		static bool isEar(const std::vector<float2> &points, int prev, int curr, int next)
+		// bounding box of the ellipse in pixels, with one pixel for antialiasing
+		float2 center_px = float2(-(vy.y * v0.x - vy.x * v0.y), -(-vx.y * v0.x + vx.x * v0.y)) / det;
+		float2 extent_px = prim.radius * float2(LiteMath::length(float2(vy.y, vy.x)), LiteMath::length(float2(vx.y, vx.x))) / std::abs(det);
+		float aa_margin = std::max(LiteMath::length(vx), LiteMath::length(vy)); // one pixel in v units
+		float outer_radius = prim.radius + aa_margin;
+		int y_begin = std::max(clip0.y, int(floorf(center_px.y - extent_px.y)) - 1);
+		int y_end = std::min(clip1.y, int(ceilf(center_px.y + extent_px.y)) + 2);
+
+		std::vector<float> coverage(clip1.x - clip0.x);
+		float vx_len2 = LiteMath::dot(vx, vx);
+		for (int y = y_begin; y < y_end; y++)
 		{
-			const float2 &a = points[prev];
-			const float2 &b = points[curr];
-			const float2 &c = points[next];
-
-			// Check if triangle is oriented correctly (counter-clockwise)
-			if (crossProduct(a, b, c) <= 0)
-			{
-				return false; // Reflex vertex or degenerate
-			}
-
-			// Check if any other vertex lies inside the triangle
-			for (size_t i = 0; i < points.size(); i++)
+			// solve |a + x*vx| <= outer_radius for x
+			float2 a = v0 + float(y) * vy;
+			float b = LiteMath::dot(a, vx) / vx_len2;
+			float d = b * b - (LiteMath::dot(a, a) - outer_radius * outer_radius) / vx_len2;
+			if (d < 0)
+				continue;
+			int x_begin = std::max(clip0.x, int(floorf(-b - sqrtf(d))));
+			int x_end = std::min(clip1.x, int(ceilf(-b + sqrtf(d))) + 1);
+			if (x_begin >= x_end)
+				continue;
+
+			float2 v = a + float(x_begin) * vx;
+			float *cov = coverage.data();
+			if (samples.count > 0)
 			{
-				if (i == prev || i == curr || i == next)
-					continue;
-				if (pointInTriangle(points[i], a, b, c))
+				float r2 = prim.radius * prim.radius;
+				for (int x = x_begin; x < x_end; x++)
 				{
-					return false;
+					uint32_t mask = 0;
+					for (int s = 0; s < samples.count; s++)
+					{
+						float2 q = v + (samples.offsets[s].x - 0.5f) * vx + (samples.offsets[s].y - 0.5f) * vy;
+						mask |= (q.x * q.x + q.y * q.y <= r2 ? 1u : 0u) << s;
+					}
+					cov[x - x_begin] = samples.resolve(mask);
+					v += vx;
 				}
 			}
-
-			return true;
-		}
-
-		// Find closest point on boundary to connect hole
-		static size_t findClosestVertex(const std::vector<float2> &boundary, const float2 &holeVertex)
-		{
-			size_t closest = 0;
-			float minDist = std::numeric_limits<float>::max();
-
-			for (size_t i = 0; i < boundary.size(); i++)
+			else if (prim.antialiased)
 			{
-				float dx = boundary[i].x - holeVertex.x;
-				float dy = boundary[i].y - holeVertex.y;
-				float dist = dx * dx + dy * dy;
-
-				if (dist < minDist)
+				// coverage is the exact area of the pixel inside the disc. The pixel is a parallelogram
+				// in v space, pixels farther than half of its diagonal from the edge are inside or outside
+				float half_diag = 0.5f * std::max(LiteMath::length(vx + vy), LiteMath::length(vx - vy));
+				float inner2 = std::max(0.0f, prim.radius - half_diag);
+				inner2 *= inner2;
+				float outer2 = (prim.radius + half_diag) * (prim.radius + half_diag);
+				float2 corners[4] = {-0.5f * (vx + vy), 0.5f * (vx - vy), 0.5f * (vx + vy), 0.5f * (vy - vx)};
+				for (int x = x_begin; x < x_end; x++)
 				{
-					minDist = dist;
-					closest = i;
+					float dist2 = v.x * v.x + v.y * v.y;
+					if (dist2 <= inner2)
+						cov[x - x_begin] = 1.0f;
+					else if (dist2 >= outer2)
+						cov[x - x_begin] = 0.0f;
+					else
+					{
+						float area = 0;
+						for (int k = 0; k < 4; k++)
+							area += disc_triangle_area(v + corners[k], v + corners[(k + 1) % 4], prim.radius);
+						cov[x - x_begin] = std::min(1.0f, std::abs(area / det));
+					}
+					v += vx;
 				}
 			}
-
-			return closest;
-		}
-
-		// Connect hole to outer boundary
-		static std::vector<float2> connectHole(const std::vector<float2> &boundary,
-																					 const std::vector<float2> &hole)
-		{
-			if (hole.empty())
-				return boundary;
-
-			// Find rightmost point of hole (good heuristic for connection)
-			size_t rightmostHole = 0;
-			for (size_t i = 1; i < hole.size(); i++)
+			else
 			{
-				if (hole[i].x > hole[rightmostHole].x)
+				for (int x = x_begin; x < x_end; x++)
 				{
-					rightmostHole = i;
+					cov[x - x_begin] = v.x * v.x + v.y * v.y <= prim.radius * prim.radius ? 1.0f : 0.0f;
+					v += vx;
 				}
 			}
 
-			// Find closest boundary vertex
-			size_t closestBoundary = findClosestVertex(boundary, hole[rightmostHole]);
-
-			// Create new polygon with bridge connection
-			std::vector<float2> result;
-
-			// Add boundary points up to connection point
-			for (size_t i = 0; i <= closestBoundary; i++)
-			{
-				result.push_back(boundary[i]);
-			}
-
-			// Add hole points starting from rightmost
-			for (size_t i = 0; i < hole.size(); i++)
-			{
-				size_t idx = (rightmostHole + i) % hole.size();
-				result.push_back(hole[idx]);
-			}
-
-			// Close hole by returning to connection point
-			result.push_back(hole[rightmostHole]);
-			result.push_back(boundary[closestBoundary]);
-
-			// Add remaining boundary points
-			for (size_t i = closestBoundary + 1; i < boundary.size(); i++)
+			for (int x = x_begin; x < x_end; x++)
 			{
-				result.push_back(boundary[i]);
+				if (cov[x - x_begin] <= 0)
+					continue;
+				float4 c = prim.color * float4(1, 1, 1, cov[x - x_begin]);
+				uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
+				out[pixel] = alpha_blend(c, out[pixel]);
 			}
-
-			return result;
 		}
+	}
 
-	public:
-		static std::vector<Triangle> triangulateSimple(std::vector<float2> points)
-		{
-			std::vector<Triangle> triangles;
-
-			if (points.size() < 3)
-				return triangles;
-
-			// Ensure counter-clockwise orientation
-			if (signedArea(points) > 0)
-			{
-				std::reverse(points.begin(), points.end());
-			}
+	// polygon edge in instance-local pixel coordinates, y0 < y1
+	struct ScanEdge
+	{
+		float x0, y0, y1;
+		float dxdy;
+		int winding;
+	};
 
-			// Create vertex index list
-			std::vector<int> vertices;
-			for (int i = 0; i < static_cast<int>(points.size()); i++)
-			{
-				vertices.push_back(i);
-			}
+	// fills area bounded by edges (sorted by y0) according to fill rule. Coverage is exact along x,
+	// antialiased fill additionally takes several sub-scanlines per row
+	void fill_scan_edges(const std::vector<ScanEdge> &edges, FillRule fill_rule, bool antialiased, const float4 &color,
+											 const SamplePattern &pattern, const InstanceView &instance, LiteImage::Image2D<float4> &out)
+	{
+		int2 clip0, clip1;
+		visible_span(instance, out, clip0, clip1);
+		if (edges.empty() || clip0.x >= clip1.x || clip0.y >= clip1.y)
+			return;
 
-			// Ear clipping algorithm
-			while (vertices.size() > 3)
+		float max_y = edges[0].y1;
+		for (const ScanEdge &e : edges)
+			max_y = std::max(max_y, e.y1);
+		int y_begin = std::max(clip0.y, int(floorf(edges[0].y0)));
+		int y_end = std::min(clip1.y, int(ceilf(max_y)));
+
+		// with multisampling sub-scanlines go through the samples and spans set mask bits
+		const bool multisampled = pattern.count > 0;
+		const int samples = multisampled ? pattern.count : (antialiased ? 4 : 1);
+		const float weight = 1.0f / samples;
+		std::vector<float> coverage(clip1.x - clip0.x, 0.0f);
+		std::vector<uint16_t> masks(multisampled ? clip1.x - clip0.x : 0, 0);
+		std::vector<int> active;
+		std::vector<std::pair<float, int>> crossings; // x and winding
+		int next_edge = 0;
+
+		for (int y = y_begin; y < y_end; y++)
+		{
+			int row_min = clip1.x;
+			int row_max = clip0.x;
+			for (int s = 0; s < samples; s++)
 			{
-				bool earFound = false;
-
-				for (size_t i = 0; i < vertices.size(); i++)
+				float sy = multisampled ? y + pattern.offsets[s].y : y + (s + 0.5f) * weight;
+				while (next_edge < edges.size() && edges[next_edge].y0 <= sy)
+					active.push_back(next_edge++);
+
+				// edge crosses scanline if y0 <= sy < y1
+				crossings.clear();
+				int kept = 0;
+				for (int id : active)
 				{
-					int prev = vertices[(i - 1 + vertices.size()) % vertices.size()];
-					int curr = vertices[i];
-					int next = vertices[(i + 1) % vertices.size()];
+					const ScanEdge &e = edges[id];
+					if (e.y1 <= sy)
+						continue;
+					active[kept++] = id;
+					crossings.emplace_back(e.x0 + (sy - e.y0) * e.dxdy, e.winding);
+				}
+				active.resize(kept);
+				std::sort(crossings.begin(), crossings.end());
 
-					if (isEar(points, prev, curr, next))
+				int winding = 0;
+				for (int i = 0; i + 1 < (int)crossings.size(); i++)
+				{
+					winding += fill_rule == FillRule::EvenOdd ? 1 : crossings[i].second;
+					bool inside = fill_rule == FillRule::EvenOdd ? (winding & 1) : winding != 0;
+					float xa = std::max<float>(crossings[i].first, clip0.x);
+					float xb = std::min<float>(crossings[i + 1].first, clip1.x);
+					if (!inside || xa >= xb)
+						continue;
+
+					if (multisampled)
 					{
-						// Create triangle
-						triangles.emplace_back(points[prev], points[curr], points[next]);
-
-						// Remove ear vertex
-						vertices.erase(vertices.begin() + i);
-						earFound = true;
-						break;
+						// pixels whose sample s is inside the span
+						float ox = pattern.offsets[s].x;
+						int ia = int(ceilf(xa - ox));
+						int ib = std::min<int>(clip1.x, ceilf(xb - ox));
+						for (int x = ia; x < ib; x++)
+							masks[x - clip0.x] |= 1u << s;
+						row_min = std::min(row_min, ia);
+						row_max = std::max(row_max, ib);
+					}
+					else if (antialiased)
+					{
+						int ia = int(floorf(xa));
+						int ib = int(floorf(xb));
+						if (ia == ib)
+						{
+							coverage[ia - clip0.x] += (xb - xa) * weight;
+						}
+						else
+						{
+							coverage[ia - clip0.x] += (ia + 1 - xa) * weight;
+							for (int x = ia + 1; x < ib; x++)
+								coverage[x - clip0.x] += weight;
+							if (ib < clip1.x)
+								coverage[ib - clip0.x] += (xb - ib) * weight;
+						}
+						row_min = std::min(row_min, ia);
+						row_max = std::max(row_max, std::min(ib + 1, clip1.x));
+					}
+					else
+					{
+						// pixels with centers inside the span
+						int ia = int(ceilf(xa - 0.5f));
+						int ib = std::min<int>(clip1.x, ceilf(xb - 0.5f));
+						for (int x = ia; x < ib; x++)
+							coverage[x - clip0.x] += 1.0f;
+						row_min = std::min(row_min, ia);
+						row_max = std::max(row_max, ib);
 					}
 				}
+			}
 
-				// Safety check to prevent infinite loops
-				if (!earFound)
+			if (multisampled)
+			{
+				for (int x = row_min; x < row_max; x++)
 				{
-					break;
+					coverage[x - clip0.x] = pattern.resolve(masks[x - clip0.x]);
+					masks[x - clip0.x] = 0;
 				}
 			}
-
-			// Add final triangle
-			if (vertices.size() == 3)
+			for (int x = row_min; x < row_max; x++)
 			{
-				triangles.emplace_back(points[vertices[0]], points[vertices[1]], points[vertices[2]]);
+				float cov = coverage[x - clip0.x];
+				if (cov <= 0)
+					continue;
+				coverage[x - clip0.x] = 0;
+				float4 c = color * float4(1, 1, 1, std::min(1.0f, cov));
+				uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
+				out[pixel] = alpha_blend(c, out[pixel]);
 			}
-
-			return triangles;
 		}
-	};
+	}
 
-	std::vector<Triangle> triangulate(const Polygon &polygon)
+	static float cross(const float2 &a, const float2 &b)
 	{
-		if (polygon.contours.empty())
-		{
-			return {};
-		}
-
-		// Start with outer boundary (first contour)
-		std::vector<float2> combinedPolygon = polygon.contours[0].points;
+		return a.x * b.y - a.y * b.x;
+	}
 
-		// Connect all holes to the boundary
-		for (size_t i = 1; i < polygon.contours.size(); i++)
+	// adds closed polygon to edge list. All polygons are oriented the same way,
+	// so that filling with non-zero rule gives their union
+	void add_scan_polygon(const float2 *points, int count, std::vector<ScanEdge> &edges)
+	{
+		float area = 0;
+		for (int i = 0; i < count; i++)
+			area += cross(points[i], points[(i + 1) % count]);
+		int orientation = area >= 0 ? 1 : -1;
+		for (int i = 0; i < count; i++)
 		{
-			combinedPolygon = PolygonTriangulator::connectHole(combinedPolygon, polygon.contours[i].points);
+			float2 p0 = points[i];
+			float2 p1 = points[(i + 1) % count];
+			if (p0.y == p1.y)
+				continue;
+			int winding = orientation;
+			if (p0.y > p1.y)
+			{
+				std::swap(p0, p1);
+				winding = -winding;
+			}
+			edges.push_back(ScanEdge{p0.x, p0.y, p1.y, (p1.x - p0.x) / (p1.y - p0.y), winding});
 		}
-
-		// Triangulate the resulting simple polygon
-		return PolygonTriangulator::triangulateSimple(combinedPolygon);
 	}
 
-	void render_triangle(const Triangle &tri, const InstanceData &instance,
-											 LiteImage::Image2D<float4> &out, const float4 &color,
-											 int2 size)
+	// converts closed contour (in pixels) to the outline of its stroke: a quad for every segment
+	// and a join piece at every vertex
+	void stroke_contour(const std::vector<float2> &points, float half_width, LineJoin join, std::vector<ScanEdge> &edges)
 	{
-		int w = size.x;
-		int h = size.y;
-
-		// Transform triangle vertices to pixel coordinates
-		float2 p0 = to_float2(instance.uv_transform * float3(tri.p1.x, tri.p1.y, 1));
-		float2 p1 = to_float2(instance.uv_transform * float3(tri.p2.x, tri.p2.y, 1));
-		float2 p2 = to_float2(instance.uv_transform * float3(tri.p3.x, tri.p3.y, 1));
+		constexpr float miter_limit = 4.0f; // max ratio of miter length to half width, as in SVG
+		std::vector<float2> path;
+		for (const float2 &p : points)
+		{
+			if (path.empty() || LiteMath::length(p - path.back()) > 1e-4f)
+				path.push_back(p);
+		}
+		while (path.size() > 1 && LiteMath::length(path.front() - path.back()) <= 1e-4f)
+			path.pop_back();
+		int n = path.size();
+		if (n < 2)
+			return;
 
-		p0 = LiteMath::clamp(p0, float2(0, 0), float2(1, 1));
-		p1 = LiteMath::clamp(p1, float2(0, 0), float2(1, 1));
-		p2 = LiteMath::clamp(p2, float2(0, 0), float2(1, 1));
-
-		int x0 = int(p0.x * w);
-		int y0 = int(p0.y * h);
-		int x1 = int(p1.x * w);
-		int y1 = int(p1.y * h);
-		int x2 = int(p2.x * w);
-		int y2 = int(p2.y * h);
-
-		// Compute bounding box of the triangle
-		int minX = std::max(0, std::min({x0, x1, x2}));
-		int maxX = std::min(w - 1, std::max({x0, x1, x2}) + 1);
-		int minY = std::max(0, std::min({y0, y1, y2}));
-		int maxY = std::min(h - 1, std::max({y0, y1, y2}) + 1);
-
-		// Rasterize triangle using barycentric coordinates
-		for (int y = minY; y <= maxY; y++)
+		for (int i = 0; i < n; i++)
 		{
-			for (int x = minX; x <= maxX; x++)
+			float2 a = path[i];
+			float2 b = path[(i + 1) % n];
+			float2 c = path[(i + 2) % n];
+			float2 d1 = LiteMath::normalize(b - a);
+			float2 d2 = LiteMath::normalize(c - b);
+			float2 n1 = float2(-d1.y, d1.x) * half_width;
+			float2 n2 = float2(-d2.y, d2.x) * half_width;
+
+			float2 quad[4] = {a + n1, b + n1, b - n1, a - n1};
+			add_scan_polygon(quad, 4, edges);
+
+			float turn = cross(d1, d2);
+			if (std::abs(turn) < 1e-6f && LiteMath::dot(d1, d2) > 0)
+				continue; // straight continuation, nothing to join
+
+			float side = turn > 0 ? -1.0f : 1.0f; // outer side of the turn
+			float2 o1 = b + side * n1;
+			float2 o2 = b + side * n2;
+			if (join == LineJoin::Round)
 			{
-				float px = x + 0.5f;
-				float py = y + 0.5f;
-
-				if (PolygonTriangulator::pointInTriangle(float2(px / w, py / h), p0, p1, p2, -1e-6f))
+				int segments = std::clamp(int(half_width), 8, 64);
+				std::vector<float2> circle(segments);
+				for (int j = 0; j < segments; j++)
 				{
-					uint2 pixel = uint2(x + instance.pos.x, y + instance.pos.y);
-					out[pixel] = alpha_blend(color, out[pixel]);
+					float angle = 2 * LiteMath::M_PI * j / segments;
+					circle[j] = b + half_width * float2(cos(angle), sin(angle));
 				}
+				add_scan_polygon(circle.data(), segments, edges);
+				continue;
+			}
+
+			float2 miter = n1 + n2;
+			float cos_half = LiteMath::length(miter) / (2 * half_width);
+			if (join == LineJoin::Miter && cos_half > 1.0f / miter_limit)
+			{
+				float2 tip = b + side * LiteMath::normalize(miter) * (half_width / cos_half);
+				float2 piece[4] = {b, o1, tip, o2};
+				add_scan_polygon(piece, 4, edges);
+			}
+			else
+			{
+				float2 piece[3] = {b, o1, o2};
+				add_scan_polygon(piece, 3, edges);
 			}
 		}
 	}
 
-	void Renderer::render(const Polygon &prim, const InstanceData &instance, LiteImage::Image2D<float4> &out) const
+	void Renderer::render(const Polygon &prim, const InstanceView &instance, LiteImage::Image2D<float4> &out) const
 	{
-		std::vector<Triangle> triangles = triangulate(prim);
-
 		if (prim.outline)
 		{
-			for (const auto &tri : triangles)
+			float half_width = 0.5f * prim.outline_thickness * std::max(instance.size.x, instance.size.y);
+			std::vector<ScanEdge> edges;
+			std::vector<float2> points;
+			for (const Polygon::Contour &contour : prim.contours)
 			{
-				std::pair<float2, float2> edges[3] = {
-						{tri.p1, tri.p2},
-						{tri.p2, tri.p3},
-						{tri.p3, tri.p1}};
-				for (const auto &edge : edges)
-				{
-					Line line;
-					line.start = edge.first;
-					line.end = edge.second;
-					line.thickness = prim.outline_thickness;
-					line.color = prim.color;
-					line.antialiased = prim.outline_antialiased;
-					line.size = prim.size;
-					render(line, instance, out);
-				}
+				points.clear();
+				for (const float2 &p : contour.points)
+					points.push_back(to_float2(instance.uv_transform * float3(p.x, p.y, 1)) * float2(instance.size));
+				stroke_contour(points, half_width, prim.outline_join, edges);
 			}
+			std::sort(edges.begin(), edges.end(), [](const ScanEdge &a, const ScanEdge &b) { return a.y0 < b.y0; });
+			fill_scan_edges(edges, FillRule::NonZero, prim.outline_antialiased, prim.color, samples, instance, out);
 		}
 		else
 		{
-			for (const auto &tri : triangles)
+			// edges are sorted on load, here they are only moved to pixel space
+			std::vector<ScanEdge> edges;
+			edges.reserve(prim.edges.size());
+			bool sorted = true;
+			for (const Polygon::Edge &e : prim.edges)
 			{
-				render_triangle(tri, instance, out, prim.color, prim.size);
+				float2 p0 = to_float2(instance.uv_transform * float3(e.p0.x, e.p0.y, 1)) * float2(instance.size);
+				float2 p1 = to_float2(instance.uv_transform * float3(e.p1.x, e.p1.y, 1)) * float2(instance.size);
+				int winding = e.winding;
+				if (p0.y == p1.y)
+					continue;
+				if (p0.y > p1.y)
+				{
+					std::swap(p0, p1);
+					winding = -winding;
+				}
+				sorted = sorted && (edges.empty() || edges.back().y0 <= p0.y);
+				edges.push_back(ScanEdge{p0.x, p0.y, p1.y, (p1.x - p0.x) / (p1.y - p0.y), winding});
 			}
+			if (!sorted)
+				std::sort(edges.begin(), edges.end(), [](const ScanEdge &a, const ScanEdge &b) { return a.y0 < b.y0; });
+			fill_scan_edges(edges, prim.fill_rule, prim.antialiased, prim.color, samples, instance, out);
 		}
 	}
 }
\ No newline at end of file
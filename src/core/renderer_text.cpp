@@ -34,7 +34,8 @@ namespace LiteFigure
 		x2 = (-b + std::sqrt(d)) / (2 * a);
 	}
 
-	void render_bezier_glyph_bruteforce(int2 pos, int2 size, float4 color,
+	// [clip0, clip1) is the part of the glyph rect that is written, in glyph-local pixels
+	void render_bezier_glyph_bruteforce(int2 pos, int2 size, int2 clip0, int2 clip1, float4 color, const SamplePattern &pattern,
 																			const std::vector<GlyphLine> &lines,
 																			const std::vector<GlyphBezier> &beziers,
 																			LiteImage::Image2D<float4> &out_image)
@@ -52,75 +53,117 @@ namespace LiteFigure
 			bezier_y_limits[i].y = std::max(beziers[i].p0.y, std::max(beziers[i].p1.y, beziers[i].p2.y));
 		}
 
-		for (int y = 0; y < size.y; y++)
+		// even-odd test for point p in normalized glyph coordinates
+		auto inside = [&](float2 p) -> bool
 		{
-			for (int x = 0; x < size.x; x++)
+			int intersections = 0;
+
+			for (int i = 0; i < lines.size(); i++)
 			{
-				float2 p = float2((x + 0.5f) / size.x, (y + 0.5f) / size.y);
-				int intersections = 0;
+				if (p.y < line_y_limits[i].x || p.y >= line_y_limits[i].y)
+					continue;
 
-				for (int i = 0; i < lines.size(); i++)
-				{
-					if (p.y < line_y_limits[i].x || p.y >= line_y_limits[i].y)
-						continue;
+				// intersect ray y = p.y with lines
+				float t = -(lines[i].p0.y - p.y) / (lines[i].p1.y - lines[i].p0.y);
+				float inter_x = lines[i].p0.x + (lines[i].p1.x - lines[i].p0.x) * t;
+				if (t > 0 && t < 1 && inter_x > p.x)
+					intersections++;
+			}
 
-					// intersect ray y = p.y with lines
-					float t = -(lines[i].p0.y - p.y) / (lines[i].p1.y - lines[i].p0.y);
-					float inter_x = lines[i].p0.x + (lines[i].p1.x - lines[i].p0.x) * t;
-					if (t > 0 && t < 1 && inter_x > p.x)
-						intersections++;
-				}
+			for (int i = 0; i < beziers.size(); i++)
+			{
+				if (p.y < bezier_y_limits[i].x || p.y >= bezier_y_limits[i].y)
+					continue;
 
-				for (int i = 0; i < beziers.size(); i++)
+				// intersect ray y = p.y with bezier
+				float a = beziers[i].p0.y - 2 * beziers[i].p1.y + beziers[i].p2.y;
+				float b = 2 * (beziers[i].p1.y - beziers[i].p0.y);
+				float c = beziers[i].p0.y - p.y;
+				float t1 = 1000, t2 = 1000;
+				solve_quadratic(a, b, c, t1, t2);
+				float inter_x1 = quadratic_bezier(beziers[i], t1).x;
+				float inter_x2 = quadratic_bezier(beziers[i], t2).x;
+				if (t1 >= 0 && t1 < 1 && inter_x1 > p.x)
+					intersections++;
+				if (t2 >= 0 && t2 < 1 && inter_x2 > p.x)
+					intersections++;
+			}
+
+			return intersections % 2;
+		};
+
+		for (int y = clip0.y; y < clip1.y; y++)
+		{
+			for (int x = clip0.x; x < clip1.x; x++)
+			{
+				float4 c = color;
+				if (pattern.count > 0)
 				{
-					if (p.y < bezier_y_limits[i].x || p.y >= bezier_y_limits[i].y)
+					uint32_t mask = 0;
+					for (int s = 0; s < pattern.count; s++)
+					{
+						if (inside(float2((x + pattern.offsets[s].x) / size.x, (y + pattern.offsets[s].y) / size.y)))
+							mask |= 1u << s;
+					}
+					if (mask == 0)
 						continue;
-
-					// intersect ray y = p.y with bezier
-					float a = beziers[i].p0.y - 2 * beziers[i].p1.y + beziers[i].p2.y;
-					float b = 2 * (beziers[i].p1.y - beziers[i].p0.y);
-					float c = beziers[i].p0.y - p.y;
-					float t1 = 1000, t2 = 1000;
-					solve_quadratic(a, b, c, t1, t2);
-					float inter_x1 = quadratic_bezier(beziers[i], t1).x;
-					float inter_x2 = quadratic_bezier(beziers[i], t2).x;
-					if (t1 >= 0 && t1 < 1 && inter_x1 > p.x)
-						intersections++;
-					if (t2 >= 0 && t2 < 1 && inter_x2 > p.x)
-						intersections++;
+					c.w *= pattern.resolve(mask);
 				}
-
-				if (intersections % 2)
-					out_image[int2(pos.x + x, pos.y + y)] = alpha_blend(color, out_image[int2(pos.x + x, pos.y + y)]);
+				else if (!inside(float2((x + 0.5f) / size.x, (y + 0.5f) / size.y)))
+				{
+					continue;
+				}
+				out_image[int2(pos.x + x, pos.y + y)] = alpha_blend(c, out_image[int2(pos.x + x, pos.y + y)]);
 			}
 		}
 	}
 
-	void render_glyph_sdf(int2 pos, int2 size, float4 color, const TTFSimpleGlyph &glyph,
-												const GlyphSDF &sdf_image, LiteImage::Image2D<float4> &out_image)
+	void render_glyph_sdf(int2 pos, int2 size, int2 clip0, int2 clip1, float4 color, const SamplePattern &pattern,
+												const TTFSimpleGlyph &glyph, const GlyphSDF &sdf_image, LiteImage::Image2D<float4> &out_image)
 	{
 		float2 s_size = float2(sdf_image.width, sdf_image.height);
-		for (int y = 0; y < size.y; y++)
+		// bilinearly interpolated distance at point (in pixels), positive inside the glyph
+		auto distance = [&](float px, float py) -> float
 		{
-			for (int x = 0; x < size.x; x++)
+			float2 p = s_size*float2(px / size.x, py / size.y);
+			int2 ip = int2(floorf(p.x), floorf(p.y));
+			float2 dp = p - float2(floorf(p.x), floorf(p.y));
+			int off = ip.y * sdf_image.width + ip.x;
+			int2 advance = int2(ip.x < sdf_image.width - 1 ? 1 : 0, ip.y < sdf_image.height - 1 ? sdf_image.width : 0);
+			float sdf00 = sdf_image.data[off];
+			float sdf01 = sdf_image.data[off + advance.x];
+			float sdf10 = sdf_image.data[off + advance.y];
+			float sdf11 = sdf_image.data[off + advance.x + advance.y];
+			return (1 - dp.x) * (1 - dp.y) * sdf00 + dp.x * (1 - dp.y) * sdf01 + (1 - dp.x) * dp.y * sdf10 + dp.x * dp.y * sdf11;
+		};
+
+		for (int y = clip0.y; y < clip1.y; y++)
+		{
+			for (int x = clip0.x; x < clip1.x; x++)
 			{
-				float2 p = s_size*float2((x + 0.5f) / size.x, (y + 0.5f) / size.y);
-				int2 ip = int2(floorf(p.x), floorf(p.y));
-				float2 dp = p - float2(floorf(p.x), floorf(p.y));
-				int off = ip.y * sdf_image.width + ip.x;
-				int2 advance = int2(ip.x < sdf_image.width - 1 ? 1 : 0, ip.y < sdf_image.height - 1 ? sdf_image.width : 0);
-				float sdf00 = sdf_image.data[off];
-				float sdf01 = sdf_image.data[off + advance.x];
-				float sdf10 = sdf_image.data[off + advance.y];
-				float sdf11 = sdf_image.data[off + advance.x + advance.y];
-				float val = (1 - dp.x) * (1 - dp.y) * sdf00 + dp.x * (1 - dp.y) * sdf01 + (1 - dp.x) * dp.y * sdf10 + dp.x * dp.y * sdf11;
-				if (val > 0.0f)
-					out_image[int2(pos.x + x, pos.y + y)] = alpha_blend(color, out_image[int2(pos.x + x, pos.y + y)]);
+				float4 c = color;
+				if (pattern.count > 0)
+				{
+					uint32_t mask = 0;
+					for (int s = 0; s < pattern.count; s++)
+					{
+						if (distance(x + pattern.offsets[s].x, y + pattern.offsets[s].y) > 0.0f)
+							mask |= 1u << s;
+					}
+					if (mask == 0)
+						continue;
+					c.w *= pattern.resolve(mask);
+				}
+				else if (distance(x + 0.5f, y + 0.5f) <= 0.0f)
+				{
+					continue;
+				}
+				out_image[int2(pos.x + x, pos.y + y)] = alpha_blend(c, out_image[int2(pos.x + x, pos.y + y)]);
 			}
 		}
 	}
 
-	void render_glyph_bezier(int2 pos, int2 size, float4 color, const TTFSimpleGlyph &glyph,
+	void render_glyph_bezier(int2 pos, int2 size, int2 clip0, int2 clip1, float4 color, const SamplePattern &pattern, const TTFSimpleGlyph &glyph,
 													 LiteImage::Image2D<float4> &out_image)
 	{
 		float2 sz = float2(glyph.xMax - glyph.xMin, glyph.yMax - glyph.yMin);
@@ -167,7 +210,7 @@ namespace LiteFigure
 
 		// printf("render glyph %s %d, size %dx%d, pos %dx%d\n", prim.font_name.c_str(), prim.glyph_id,
 		// 	data.size.x, data.size.y, data.pos.x, data.pos.y);
-		render_bezier_glyph_bruteforce(pos, size, color, lines, beziers, out_image);
+		render_bezier_glyph_bruteforce(pos, size, clip0, clip1, color, pattern, lines, beziers, out_image);
 	}
 
 	void create_sdf(int base_scale, int radius, LiteImage::Image2D<float4> &in_image, LiteImage::Image2D<float> &out_image)
@@ -217,21 +260,23 @@ namespace LiteFigure
 		int2 glyph_size = base_scale * sdf_size;
 
 		LiteImage::Image2D<float4> glyph_image(glyph_size.x, glyph_size.y);
-		render_glyph_bezier(int2(0, 0), glyph_size, float4(1, 1, 1, 1), glyph, glyph_image);
+		render_glyph_bezier(int2(0, 0), glyph_size, int2(0, 0), glyph_size, float4(1, 1, 1, 1), SamplePattern(), glyph, glyph_image);
 		LiteImage::Image2D<float> sdf_image(sdf_size.x, sdf_size.y);
 		create_sdf(base_scale, radius, glyph_image, sdf_image);
 
 		return sdf_image;
 	}
 
-	void Renderer::render(const Glyph &prim, const InstanceData &data, LiteImage::Image2D<float4> &out) const
+	void Renderer::render(const Glyph &prim, const InstanceView &data, LiteImage::Image2D<float4> &out) const
 	{
 		const Font &font = get_font(prim.font_name);
 		const TTFSimpleGlyph &glyph = font.glyphs[prim.glyph_id];
+		int2 clip0, clip1;
+		visible_span(data, out, clip0, clip1);
 		// if there is no SDF glyph, or the glyph is too big, render it with bezier
-		if (font.glyphs_sdf[prim.glyph_id].height == 0 || prim.size.y > 3*font.glyphs_sdf[prim.glyph_id].height)
-			render_glyph_bezier(data.pos, data.size, prim.color, glyph, out);
+		if (font.glyphs_sdf[prim.glyph_id].height == 0 || data.size.y > 3*font.glyphs_sdf[prim.glyph_id].height)
+			render_glyph_bezier(data.pos, data.size, clip0, clip1, prim.color, samples, glyph, out);
 		else
-			render_glyph_sdf(data.pos, data.size, prim.color, glyph, font.glyphs_sdf[prim.glyph_id], out);
+			render_glyph_sdf(data.pos, data.size, clip0, clip1, prim.color, samples, glyph, font.glyphs_sdf[prim.glyph_id], out);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,575 @@
+#include "figure.h"
+#include "image_writer.h"
+#include "renderer.h"
+#include "ttf_reader.h"
+#include "vector_writer.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace LiteFigure
+{
+  // 1/100 of a pixel, without leading zero
+  static void append_number(std::string &s, float v)
+  {
+    append_number(s, v, 2, false);
+  }
+
+  // #rgb when it is exact, #rrggbb otherwise
+  static void append_color(std::string &s, float4 color)
+  {
+    const uint8_t c[3] = {tonemap_to_byte(color.x, 1.0f), tonemap_to_byte(color.y, 1.0f), tonemap_to_byte(color.z, 1.0f)};
+    char buf[8];
+    if (c[0] % 17 == 0 && c[1] % 17 == 0 && c[2] % 17 == 0)
+      snprintf(buf, sizeof(buf), "#%x%x%x", c[0] / 17, c[1] / 17, c[2] / 17);
+    else
+      snprintf(buf, sizeof(buf), "#%02x%02x%02x", c[0], c[1], c[2]);
+    s += buf;
+  }
+
+  static void append_attribute(std::string &s, const char *name, float v)
+  {
+    s += " ";
+    s += name;
+    s += "=\"";
+    append_number(s, v);
+    s += "\"";
+  }
+
+  // fill or stroke color with its opacity, if it is not opaque
+  static void append_paint(std::string &s, const char *name, float4 color)
+  {
+    float4 c = display_color(color);
+    s += " ";
+    s += name;
+    s += "=\"";
+    append_color(s, c);
+    s += "\"";
+    if (c.w < 1.0f)
+    {
+      s += " ";
+      s += name;
+      s += "-opacity=\"";
+      append_number(s, c.w);
+      s += "\"";
+    }
+  }
+
+  static void append_base64(std::string &s, const std::vector<uint8_t> &data)
+  {
+    static const char *digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < data.size(); i += 3)
+    {
+      uint32_t v = data[i] << 16;
+      if (i + 1 < data.size())
+        v |= data[i + 1] << 8;
+      if (i + 2 < data.size())
+        v |= data[i + 2];
+      s.push_back(digits[(v >> 18) & 63]);
+      s.push_back(digits[(v >> 12) & 63]);
+      s.push_back(i + 1 < data.size() ? digits[(v >> 6) & 63] : '=');
+      s.push_back(i + 2 < data.size() ? digits[v & 63] : '=');
+    }
+  }
+
+  // base 14 fonts are replaced with the usual web fonts, others are embedded with @font-face
+  // under their file name
+  static std::string font_family(const std::string &name)
+  {
+    std::string stem = name.substr(0, name.find_last_of('.'));
+    std::string base = stem.substr(0, stem.find('-'));
+    if (is_default_font(name) && base == "Times")
+      return "Times,'Times New Roman',serif";
+    if (is_default_font(name) && base == "Helvetica")
+      return "Helvetica,Arial,sans-serif";
+    if (is_default_font(name) && base == "Courier")
+      return "Courier,'Courier New',monospace";
+    if (is_default_font(name))
+      return base;
+    std::string family;
+    for (char c : stem)
+      if (isalnum((unsigned char)c) || c == '-' || c == '_')
+        family.push_back(c);
+    return "'" + family + "'";
+  }
+
+  static std::string font_attributes(const std::string &name)
+  {
+    std::string attributes = " font-family=\"" + font_family(name) + "\"";
+    if (is_default_font(name) && name.find("Bold") != std::string::npos)
+      attributes += " font-weight=\"bold\"";
+    if (is_default_font(name) && (name.find("Italic") != std::string::npos || name.find("Oblique") != std::string::npos))
+      attributes += " font-style=\"italic\"";
+    return attributes;
+  }
+
+  // writes svg elements as instances come, the text goes to the file in blocks and the document
+  // is never kept in memory. Consecutive elements with the same style share one element: line
+  // segments a <path>, text runs a <g> with font attributes. Circles and images are defined once
+  // as <symbol> and placed with <use>. Consecutive elements with the same clip rect are put in
+  // a <g> clipped by a <clipPath>, which is defined once for every rect
+  class SvgStream
+  {
+  public:
+    ~SvgStream()
+    {
+      if (file)
+        fclose(file);
+    }
+
+    bool open(const std::string &filename, int width, int height)
+    {
+      file = fopen(filename.c_str(), "wb");
+      if (!file)
+      {
+        printf("[save_figure_to_svg] cannot open file %s\n", filename.c_str());
+        return false;
+      }
+      canvas_size = int2(width, height);
+      // spaces in text are kept, every character has its own x
+      out += "<svg xmlns=\"http://www.w3.org/2000/svg\" xml:space=\"preserve\" width=\"" + std::to_string(width) +
+             "\" height=\"" + std::to_string(height) + "\" viewBox=\"0 0 " + std::to_string(width) + " " +
+             std::to_string(height) + "\">\n";
+      return true;
+    }
+
+    // elements written after it are clipped to the rect, a rect that covers the canvas removes the clip
+    void clip_rect(int2 pos, int2 size)
+    {
+      const bool covers_canvas = pos.x <= 0 && pos.y <= 0 && pos.x + size.x >= canvas_size.x &&
+                                 pos.y + size.y >= canvas_size.y;
+      if (covers_canvas ? !clip_group_open : clip_group_open && equal(pos, clip_pos) && equal(size, clip_size))
+        return;
+      end_elements();
+      if (clip_group_open)
+      {
+        out += "</g>\n";
+        clip_group_open = false;
+      }
+      if (covers_canvas)
+        return;
+      clip_pos = pos;
+      clip_size = size;
+      clip_group_open = true;
+      std::string rect;
+      append_attribute(rect, "x", pos.x);
+      append_attribute(rect, "y", pos.y);
+      append_attribute(rect, "width", size.x);
+      append_attribute(rect, "height", size.y);
+      auto it = clip_paths.find(rect);
+      if (it == clip_paths.end())
+      {
+        it = clip_paths.emplace(rect, clip_paths.size()).first;
+        out += "<clipPath id=\"c" + std::to_string(it->second) + "\"><rect" + rect + "/></clipPath>\n";
+      }
+      out += "<g clip-path=\"url(#c" + std::to_string(it->second) + ")\">\n";
+      flush();
+    }
+
+    void fill_rect(float2 pos, float2 size, float4 color)
+    {
+      end_elements();
+      out += "<rect";
+      attribute("x", pos.x);
+      attribute("y", pos.y);
+      attribute("width", size.x);
+      attribute("height", size.y);
+      paint("fill", color);
+      out += "/>\n";
+      flush();
+    }
+
+    void stroke_rect(float2 pos, float2 size, float line_width, float4 color)
+    {
+      end_elements();
+      out += "<rect";
+      attribute("x", pos.x);
+      attribute("y", pos.y);
+      attribute("width", size.x);
+      attribute("height", size.y);
+      out += " fill=\"none\"";
+      paint("stroke", color);
+      attribute("stroke-width", line_width);
+      out += "/>\n";
+      flush();
+    }
+
+    // round caps and joins as the renderer draws lines, dashes restart at every subpath
+    void line(float2 p0, float2 p1, float line_width, float4 color, float2 dash, float dash_phase)
+    {
+      std::string style = " fill=\"none\"";
+      append_paint(style, "stroke", color);
+      append_attribute(style, "stroke-width", line_width);
+      if (dash.x == 0)
+        style += " stroke-linecap=\"round\"";
+      style += " stroke-linejoin=\"round\"";
+      if (dash.y != 0)
+      {
+        style += " stroke-dasharray=\"";
+        append_number(style, dash.x);
+        style += " ";
+        append_number(style, dash.y);
+        style += "\"";
+        if (dash_phase != 0)
+          append_attribute(style, "stroke-dashoffset", dash_phase);
+      }
+      const bool continues = polyline_open && style == path_style && dash.y == 0 &&
+                             std::abs(p0.x - path_end.x) < 1e-3f && std::abs(p0.y - path_end.y) < 1e-3f;
+      begin_path(style);
+      if (!continues)
+        point('M', p0);
+      point('L', p1);
+      path_end = p1;
+      polyline_open = true;
+      flush();
+    }
+
+    void polygon(const std::vector<std::vector<float2>> &contours, const std::string &style, bool merge)
+    {
+      if (!merge)
+        end_elements();
+      begin_path(style);
+      for (const auto &points : contours)
+      {
+        if (points.size() < 2)
+          continue;
+        point('M', points[0]);
+        for (int i = 1; i < points.size(); i++)
+          point('L', points[i]);
+        out += "Z";
+      }
+      polyline_open = false;
+      if (!merge)
+        end_elements();
+    }
+
+    void circle(float2 center, float radius, float4 color)
+    {
+      end_elements();
+      std::string style;
+      append_attribute(style, "r", radius);
+      append_paint(style, "fill", color);
+      auto it = markers.find(style);
+      if (it == markers.end())
+      {
+        it = markers.emplace(style, markers.size()).first;
+        out += "<symbol id=\"m" + std::to_string(it->second) + "\" overflow=\"visible\"><circle" + style + "/></symbol>\n";
+      }
+      use("#m" + std::to_string(it->second), center);
+    }
+
+    // image is the first of identical images, it is defined when it is used for the first time
+    void image(int image, const EmbeddedImage &pixels, const std::vector<uint8_t> &png)
+    {
+      end_elements();
+      if (defined_images.insert(image).second)
+      {
+        out += "<symbol id=\"i" + std::to_string(image) + "\" overflow=\"visible\"><image";
+        attribute("width", pixels.size.x);
+        attribute("height", pixels.size.y);
+        out += " href=\"data:image/png;base64,";
+        append_base64(out, png);
+        out += "\"/></symbol>\n";
+      }
+      use("#i" + std::to_string(image), float2(pixels.pos));
+    }
+
+    void text(const TextRun &run)
+    {
+      end_path();
+      const std::string &font_name = run.prim->font_name;
+      std::string style = font_attributes(font_name);
+      append_attribute(style, "font-size", run.prim->font_size);
+      append_paint(style, "fill", run.prim->color);
+      if (!text_group_open || style != text_style)
+      {
+        end_elements();
+        out += "<g" + style + ">\n";
+        text_style = style;
+        text_group_open = true;
+      }
+
+      EmbeddedFont *font = nullptr;
+      if (!is_default_font(font_name))
+      {
+        font = &fonts[font_name];
+        font->font = run.font;
+      }
+      out += "<text x=\"";
+      for (int i = 0; i < run.glyphs.size(); i++)
+      {
+        if (i > 0)
+          out += " ";
+        append_number(out, run.glyphs[i].x);
+      }
+      out += "\"";
+      attribute("y", run.baseline);
+      out += ">";
+      for (const RunGlyph &g : run.glyphs)
+      {
+        const unsigned char c = g.character;
+        if (font && c != 0)
+          font->glyphs.emplace(c, g.glyph);
+        if (c == '&')
+          out += "&amp;";
+        else if (c == '<')
+          out += "&lt;";
+        else if (c == '>')
+          out += "&gt;";
+        else if (c >= 32 && c < 127)
+          out.push_back(c);
+        else if (c >= 160)
+          out += "&#" + std::to_string(c) + ";";
+        else
+          out += "&#xFFFD;";
+      }
+      out += "</text>\n";
+      flush();
+    }
+
+    // writes subsets of embedded fonts and finishes the file
+    bool close()
+    {
+      end_elements();
+      clip_rect(int2(0, 0), canvas_size);
+      if (!fonts.empty())
+      {
+        out += "<style>\n";
+        for (const auto &[name, font] : fonts)
+        {
+          std::vector<uint16_t> glyph_ids = {0};
+          std::vector<char> characters = {0};
+          for (const auto &[c, glyph] : font.glyphs)
+          {
+            glyph_ids.push_back(glyph);
+            characters.push_back(c);
+          }
+          out += "@font-face{font-family:" + font_family(name) + ";src:url(data:font/ttf;base64,";
+          append_base64(out, write_ttf_subset(*font.font, glyph_ids, characters));
+          out += ")}\n";
+          flush();
+        }
+        out += "</style>\n";
+      }
+      out += "</svg>\n";
+      flush(true);
+      bool ok = !ferror(file);
+      ok = (fclose(file) == 0) && ok;
+      file = nullptr;
+      return ok;
+    }
+
+  private:
+    struct EmbeddedFont
+    {
+      const Font *font = nullptr;
+      std::map<unsigned char, uint16_t> glyphs; // character -> glyph in font
+    };
+
+    void attribute(const char *name, float v) { append_attribute(out, name, v); }
+    void paint(const char *name, float4 color) { append_paint(out, name, color); }
+
+    void point(char command, float2 p)
+    {
+      out.push_back(command);
+      append_number(out, p.x);
+      // the minus sign separates numbers as well as a space
+      const size_t y_start = out.size();
+      append_number(out, p.y);
+      if (out[y_start] != '-')
+        out.insert(y_start, 1, ' ');
+    }
+
+    void use(const std::string &href, float2 pos)
+    {
+      out += "<use href=\"" + href + "\"";
+      attribute("x", pos.x);
+      attribute("y", pos.y);
+      out += "/>\n";
+      flush();
+    }
+
+    void begin_path(const std::string &style)
+    {
+      if (path_open && style == path_style)
+        return;
+      end_elements();
+      out += "<path" + style + " d=\"";
+      path_style = style;
+      path_open = true;
+      polyline_open = false;
+    }
+
+    void end_path()
+    {
+      if (!path_open)
+        return;
+      out += "\"/>\n";
+      path_open = false;
+      polyline_open = false;
+      flush();
+    }
+
+    void end_elements()
+    {
+      end_path();
+      if (text_group_open)
+      {
+        out += "</g>\n";
+        text_group_open = false;
+      }
+    }
+
+    void flush(bool all = false)
+    {
+      constexpr size_t BLOCK_SIZE = 1 << 16;
+      if (out.size() >= BLOCK_SIZE || (all && !out.empty()))
+      {
+        fwrite(out.data(), 1, out.size(), file);
+        out.clear();
+      }
+    }
+
+    FILE *file = nullptr;
+    std::string out; // not yet written part of the document
+    int2 canvas_size = int2(0, 0);
+
+    bool path_open = false;     // <path> whose d is being written
+    std::string path_style;     // its attributes
+    bool polyline_open = false; // last subpath of the path is a polyline that ends in path_end
+    float2 path_end;
+
+    bool text_group_open = false;
+    std::string text_style;
+
+    bool clip_group_open = false;
+    int2 clip_pos, clip_size;
+    std::map<std::string, int> clip_paths; // rect attributes -> clipPath id
+
+    std::map<std::string, int> markers; // circle attributes -> symbol id
+    std::set<int> defined_images;
+    std::map<std::string, EmbeddedFont> fonts;
+  };
+
+  void save_Line_to_svg(const Line *prim, const InstanceData &inst, SvgStream &svg)
+  {
+    LineGeometry line = line_geometry(prim, inst);
+    svg.line(line.p0, line.p1, line.width, prim->color, line.dash, line.dash_phase);
+  }
+
+  void save_Rectangle_to_svg(const Rectangle *prim, const InstanceData &inst, SvgStream &svg)
+  {
+    float s = prim->thickness_pixel > 0 ? prim->thickness_pixel :
+                                          prim->thickness*std::max(inst.size.x, inst.size.y);
+    int2 p0   = inst.pos + int2(prim->region.x*inst.size.x, prim->region.y*inst.size.y);
+    int2 size = int2((prim->region.z-prim->region.x)*inst.size.x, (prim->region.w-prim->region.y)*inst.size.y);
+    svg.stroke_rect(float2(p0) + float2(s/2, s/2), float2(size) - float2(s, s), s, prim->color);
+  }
+
+  void save_Circle_to_svg(const Circle *prim, const InstanceData &inst, SvgStream &svg)
+  {
+    float2 center = float2(inst.pos) + float2(inst.size)*prim->center;
+    svg.circle(center, prim->radius*std::max(inst.size.x, inst.size.y), prim->color);
+  }
+
+  void save_Polygon_to_svg(const Polygon *prim, const InstanceData &inst, SvgStream &svg)
+  {
+    std::vector<std::vector<float2>> contours;
+    for (const Polygon::Contour &contour : prim->contours)
+    {
+      contours.emplace_back();
+      for (const float2 &p : contour.points)
+        contours.back().push_back(uv_to_pixels(to_uv(p, inst), inst));
+    }
+    std::string style;
+    if (prim->outline)
+    {
+      // the renderer's miter limit is 4, the default of svg
+      static const char *joins[] = {"", " stroke-linejoin=\"round\"", " stroke-linejoin=\"bevel\""};
+      style = " fill=\"none\"";
+      append_paint(style, "stroke", prim->color);
+      append_attribute(style, "stroke-width", prim->outline_thickness*std::max(inst.size.x, inst.size.y));
+      style += joins[int(prim->outline_join)];
+    }
+    else
+    {
+      append_paint(style, "fill", prim->color);
+      if (prim->fill_rule == FillRule::EvenOdd)
+        style += " fill-rule=\"evenodd\"";
+    }
+    // outlines of the same style are merged like lines, fills are not, it would change what is inside them
+    svg.polygon(contours, style, prim->outline);
+  }
+
+  void save_figure_to_svg(FigurePtr fig, const std::string &filename)
+  {
+    std::vector<Instance> instances = prepare_instances(fig);
+    printf("%d instances, figure size %d %d\n", (int)instances.size(), fig->size.x, fig->size.y);
+
+    // images are rendered and encoded in parallel before anything is written
+    std::vector<EmbeddedImage> images;
+    render_embedded_images(instances, fig->size, images);
+    std::vector<int> unique;
+    for (int i = 0; i < images.size(); i++)
+      if (images[i].source == i)
+        unique.push_back(i);
+    std::vector<std::vector<uint8_t>> pngs(images.size());
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    parallel_for(unique.size(), threads, [&](int i)
+                 {
+                   EmbeddedImage &image = images[unique[i]];
+                   encode_png(image.rgb.data(), image.size.x, image.size.y, 3, pngs[unique[i]]);
+                   image.rgb = std::vector<uint8_t>(); });
+
+    SvgStream svg;
+    if (!svg.open(filename, fig->size.x, fig->size.y))
+      return;
+    svg.fill_rect(float2(0, 0), float2(fig->size), float4(0, 0, 0, 1));
+
+    TextRun run;
+    for (int i = 0; i < instances.size(); i++)
+    {
+      const auto &inst = instances[i];
+      int2 clip_p0, clip_p1;
+      canvas_clip(inst.data, fig->size, clip_p0, clip_p1);
+      svg.clip_rect(clip_p0, clip_p1 - clip_p0);
+      switch (inst.prim->getType())
+      {
+      case FigureType::Glyph:
+        i = collect_text_run(instances, i, run) - 1;
+        svg.text(run);
+        break;
+      case FigureType::PrimitiveImage:
+        if (images[i].source >= 0)
+          svg.image(images[i].source, images[i], pngs[images[i].source]);
+        break;
+      case FigureType::PrimitiveFill:
+        svg.fill_rect(float2(inst.data.pos), float2(inst.data.size), dynamic_cast<const PrimitiveFill*>(inst.prim)->color);
+        break;
+      case FigureType::Line:
+        save_Line_to_svg(dynamic_cast<const Line*>(inst.prim), inst.data, svg);
+        break;
+      case FigureType::Circle:
+        save_Circle_to_svg(dynamic_cast<const Circle*>(inst.prim), inst.data, svg);
+        break;
+      case FigureType::Rectangle:
+        save_Rectangle_to_svg(dynamic_cast<const Rectangle*>(inst.prim), inst.data, svg);
+        break;
+      case FigureType::Polygon:
+        save_Polygon_to_svg(dynamic_cast<const Polygon*>(inst.prim), inst.data, svg);
+        break;
+      default:
+        printf("[save_figure_to_svg] Primitive type %d not supported\n", (int)(inst.prim->getType()));
+        break;
+      }
+    }
+
+    if (!svg.close())
+      printf("[save_figure_to_svg] failed to write %s\n", filename.c_str());
+  }
+}
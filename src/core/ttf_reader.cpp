@@ -751,7 +751,7 @@ namespace LiteFigure
       font.glyphs.push_back(empty_glyph);
     }
 
-    for (char c : space_chars)
+    for (unsigned char c : space_chars)
     {
       font.cmap.charGlyphs[c] = space_glyph_id;
       font.cmap.unicodeToGlyph[c] = space_glyph_id;
@@ -1,9 +1,16 @@
 #pragma once
 #include <string>
+#include <vector>
 #include "font.h"
 
 namespace LiteFigure
 {
   Font read_ttf(const std::string &filename);
   bool read_ttf_debug(const std::string &filename);
+  // builds a TrueType file with glyphs glyph_ids of font, glyph i of the result is font.glyphs[glyph_ids[i]].
+  // Outlines and metrics come from the parsed font, there are no hints. The cmap maps characters[i]
+  // (Latin-1, 0 for none) to glyph i; it is empty without characters, which is enough for a font
+  // embedded in pdf and addressed by glyph index
+  std::vector<uint8_t> write_ttf_subset(const Font &font, const std::vector<uint16_t> &glyph_ids,
+                                        const std::vector<char> &characters = {});
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "ttf_reader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace LiteFigure
+{
+  static void put_u16(std::vector<uint8_t> &out, uint32_t v)
+  {
+    out.push_back((v >> 8) & 0xFF);
+    out.push_back(v & 0xFF);
+  }
+
+  static void put_u32(std::vector<uint8_t> &out, uint32_t v)
+  {
+    put_u16(out, v >> 16);
+    put_u16(out, v & 0xFFFF);
+  }
+
+  static uint32_t table_checksum(const std::vector<uint8_t> &data, size_t begin, size_t size)
+  {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < size; i += 4)
+    {
+      uint32_t v = 0;
+      for (int j = 0; j < 4; j++)
+        v = (v << 8) | (i + j < size ? data[begin + i + j] : 0);
+      sum += v;
+    }
+    return sum;
+  }
+
+  // https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6glyf.html
+  // points are written as they are, implied on-curve points added by the reader stay explicit
+  static void write_simple_glyph(const TTFSimpleGlyph &glyph, std::vector<uint8_t> &out)
+  {
+    if (glyph.contours.empty())
+      return;
+    put_u16(out, glyph.contours.size());
+    put_u16(out, uint16_t(glyph.xMin));
+    put_u16(out, uint16_t(glyph.yMin));
+    put_u16(out, uint16_t(glyph.xMax));
+    put_u16(out, uint16_t(glyph.yMax));
+    int end_point = -1;
+    for (const auto &contour : glyph.contours)
+    {
+      end_point += contour.points.size();
+      put_u16(out, end_point);
+    }
+    put_u16(out, 0); // no instructions
+
+    constexpr uint8_t ON_CURVE = 1, X_SHORT = 2, Y_SHORT = 4, X_SAME = 16, Y_SAME = 32;
+    std::vector<uint8_t> flags, xs, ys;
+    int16_t prev_x = 0, prev_y = 0;
+    for (const auto &contour : glyph.contours)
+      for (const auto &p : contour.points)
+      {
+        uint8_t flag = p.flags.on_curve ? ON_CURVE : 0;
+        int dx = p.x - prev_x;
+        int dy = p.y - prev_y;
+        if (dx == 0)
+          flag |= X_SAME;
+        else if (std::abs(dx) < 256)
+        {
+          flag |= X_SHORT | (dx > 0 ? X_SAME : 0);
+          xs.push_back(std::abs(dx));
+        }
+        else
+          put_u16(xs, uint16_t(int16_t(dx)));
+        if (dy == 0)
+          flag |= Y_SAME;
+        else if (std::abs(dy) < 256)
+        {
+          flag |= Y_SHORT | (dy > 0 ? Y_SAME : 0);
+          ys.push_back(std::abs(dy));
+        }
+        else
+          put_u16(ys, uint16_t(int16_t(dy)));
+        flags.push_back(flag);
+        prev_x = p.x;
+        prev_y = p.y;
+      }
+    out.insert(out.end(), flags.begin(), flags.end());
+    out.insert(out.end(), xs.begin(), xs.end());
+    out.insert(out.end(), ys.begin(), ys.end());
+    while (out.size() % 4 != 0)
+      out.push_back(0);
+  }
+
+  // https://learn.microsoft.com/en-us/typography/opentype/spec/cmap#format-4-segment-mapping-to-delta-values
+  // every character is a segment of its own, mapped by idDelta
+  static void write_cmap_format4(const std::vector<char> &characters, std::vector<uint8_t> &out)
+  {
+    std::vector<std::pair<uint16_t, uint16_t>> mapping; // character, glyph
+    for (int i = 0; i < characters.size(); i++)
+      if (characters[i] != 0)
+        mapping.emplace_back((unsigned char)characters[i], i);
+    std::sort(mapping.begin(), mapping.end());
+    mapping.erase(std::unique(mapping.begin(), mapping.end(), [](const auto &a, const auto &b)
+                              { return a.first == b.first; }),
+                  mapping.end());
+    mapping.emplace_back(0xFFFF, 0); // required last segment
+
+    const int seg_count = mapping.size();
+    int entry_selector = 0;
+    while ((2 << entry_selector) <= seg_count)
+      entry_selector++;
+    const int search_range = 2 << entry_selector;
+    put_u16(out, 4);
+    put_u16(out, 16 + 8 * seg_count); // length
+    put_u16(out, 0);                  // language
+    put_u16(out, 2 * seg_count);
+    put_u16(out, search_range);
+    put_u16(out, entry_selector);
+    put_u16(out, 2 * seg_count - search_range);
+    for (const auto &[c, glyph] : mapping)
+      put_u16(out, c); // endCode
+    put_u16(out, 0);   // reservedPad
+    for (const auto &[c, glyph] : mapping)
+      put_u16(out, c); // startCode
+    for (const auto &[c, glyph] : mapping)
+      put_u16(out, c == 0xFFFF ? 1 : uint16_t(glyph - c)); // idDelta
+    for (int i = 0; i < seg_count; i++)
+      put_u16(out, 0); // idRangeOffset
+  }
+
+  std::vector<uint8_t> write_ttf_subset(const Font &font, const std::vector<uint16_t> &glyph_ids,
+                                        const std::vector<char> &characters)
+  {
+    const int num_glyphs = glyph_ids.size();
+    const uint16_t units_per_em = uint16_t(std::lround(1.0f / font.scale));
+
+    std::vector<uint8_t> glyf, loca;
+    int16_t x_min = INT16_MAX, y_min = INT16_MAX, x_max = INT16_MIN, y_max = INT16_MIN;
+    uint16_t max_advance = 0, max_points = 0, max_contours = 0;
+    for (uint16_t id : glyph_ids)
+    {
+      const TTFSimpleGlyph &glyph = font.glyphs[id];
+      put_u32(loca, glyf.size());
+      write_simple_glyph(glyph, glyf);
+      max_advance = std::max(max_advance, glyph.advance.advanceWidth);
+      if (glyph.contours.empty())
+        continue;
+      x_min = std::min(x_min, glyph.xMin);
+      y_min = std::min(y_min, glyph.yMin);
+      x_max = std::max(x_max, glyph.xMax);
+      y_max = std::max(y_max, glyph.yMax);
+      uint16_t points = 0;
+      for (const auto &contour : glyph.contours)
+        points += contour.points.size();
+      max_points = std::max(max_points, points);
+      max_contours = std::max<uint16_t>(max_contours, glyph.contours.size());
+    }
+    put_u32(loca, glyf.size());
+    if (x_min > x_max)
+      x_min = y_min = x_max = y_max = 0;
+
+    std::vector<uint8_t> head;
+    put_u32(head, 0x00010000); // version
+    put_u32(head, 0x00010000); // fontRevision
+    put_u32(head, 0);          // checkSumAdjustment, set below
+    put_u32(head, 0x5F0F3CF5); // magicNumber
+    put_u16(head, 1);          // flags: baseline at y=0
+    put_u16(head, units_per_em);
+    for (int i = 0; i < 4; i++)
+      put_u32(head, 0); // created, modified
+    put_u16(head, uint16_t(x_min));
+    put_u16(head, uint16_t(y_min));
+    put_u16(head, uint16_t(x_max));
+    put_u16(head, uint16_t(y_max));
+    put_u16(head, 0); // macStyle
+    put_u16(head, 8); // lowestRecPPEM
+    put_u16(head, 2); // fontDirectionHint
+    put_u16(head, 1); // indexToLocFormat: 32-bit offsets
+    put_u16(head, 0); // glyphDataFormat
+
+    std::vector<uint8_t> hhea;
+    put_u32(hhea, 0x00010000);
+    put_u16(hhea, uint16_t(font.ascent));
+    put_u16(hhea, uint16_t(font.descent));
+    put_u16(hhea, 0); // lineGap, already in descent
+    put_u16(hhea, max_advance);
+    put_u16(hhea, uint16_t(x_min)); // minLeftSideBearing
+    put_u16(hhea, 0);               // minRightSideBearing
+    put_u16(hhea, uint16_t(x_max)); // xMaxExtent
+    put_u16(hhea, 1);               // caretSlopeRise
+    for (int i = 0; i < 6; i++)
+      put_u16(hhea, 0); // caretSlopeRun, caretOffset, reserved
+    put_u16(hhea, 0);   // metricDataFormat
+    put_u16(hhea, num_glyphs);
+
+    std::vector<uint8_t> hmtx;
+    for (uint16_t id : glyph_ids)
+    {
+      put_u16(hmtx, font.glyphs[id].advance.advanceWidth);
+      put_u16(hmtx, uint16_t(font.glyphs[id].xMin));
+    }
+
+    std::vector<uint8_t> maxp;
+    put_u32(maxp, 0x00010000);
+    put_u16(maxp, num_glyphs);
+    put_u16(maxp, max_points);
+    put_u16(maxp, max_contours);
+    put_u16(maxp, 0); // maxCompositePoints
+    put_u16(maxp, 0); // maxCompositeContours
+    put_u16(maxp, 2); // maxZones
+    for (int i = 0; i < 8; i++)
+      put_u16(maxp, 0); // no hinting, no components
+
+    std::vector<uint8_t> cmap;
+    put_u16(cmap, 0); // version
+    put_u16(cmap, 1); // numberSubtables
+    put_u16(cmap, 0); // Unicode
+    put_u16(cmap, 3); // BMP
+    put_u32(cmap, 12);
+    write_cmap_format4(characters, cmap);
+
+    std::vector<uint8_t> post;
+    put_u32(post, 0x00030000); // no glyph names
+    for (int i = 0; i < 7; i++)
+      put_u32(post, 0);
+
+    // tables sorted by tag
+    const std::pair<const char *, const std::vector<uint8_t> *> tables[] = {
+        {"cmap", &cmap}, {"glyf", &glyf}, {"head", &head}, {"hhea", &hhea},
+        {"hmtx", &hmtx}, {"loca", &loca}, {"maxp", &maxp}, {"post", &post}};
+    const int num_tables = sizeof(tables) / sizeof(tables[0]);
+    int entry_selector = 0;
+    while ((2 << entry_selector) <= num_tables)
+      entry_selector++;
+    const int search_range = 16 << entry_selector;
+
+    std::vector<uint8_t> out;
+    put_u32(out, 0x00010000);
+    put_u16(out, num_tables);
+    put_u16(out, search_range);
+    put_u16(out, entry_selector);
+    put_u16(out, num_tables * 16 - search_range);
+    size_t offset = 12 + 16 * num_tables;
+    size_t head_offset = 0;
+    for (const auto &[tag, data] : tables)
+    {
+      out.insert(out.end(), tag, tag + 4);
+      put_u32(out, table_checksum(*data, 0, data->size()));
+      put_u32(out, offset);
+      put_u32(out, data->size());
+      if (data == &head)
+        head_offset = offset;
+      offset += (data->size() + 3) & ~size_t(3);
+    }
+    for (const auto &[tag, data] : tables)
+    {
+      out.insert(out.end(), data->begin(), data->end());
+      while (out.size() % 4 != 0)
+        out.push_back(0);
+    }
+    const uint32_t adjustment = 0xB1B0AFBA - table_checksum(out, 0, out.size());
+    for (int i = 0; i < 4; i++)
+      out[head_offset + 8 + i] = (adjustment >> (24 - 8 * i)) & 0xFF;
+    return out;
+  }
+}
@@ -0,0 +1,225 @@
+#include "vector_writer.h"
+#include "image_writer.h"
+#include "renderer.h"
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+
+namespace LiteFigure
+{
+  float4 display_color(float4 color)
+  {
+    return float4(std::pow(color.x, 1.0f/2.2f), std::pow(color.y, 1.0f/2.2f), std::pow(color.z, 1.0f/2.2f), color.w);
+  }
+
+  bool is_default_font(const std::string &name)
+  {
+    static const char *default_fonts[] = {
+      "Times-Roman", "Times-Bold", "Times-Italic", "Times-BoldItalic",
+      "Helvetica", "Helvetica-Bold", "Helvetica-Oblique", "Helvetica-BoldOblique",
+      "Courier", "Courier-Bold", "Courier-Oblique", "Courier-BoldOblique",
+      "Symbol", "ZapfDingbats",
+    };
+    for(int i=0; i<14; i++)
+      if (name == default_fonts[i])
+        return true;
+    return false;
+  }
+
+  void append_number(std::string &s, float v, int max_digits, bool leading_zero)
+  {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%.*f", max_digits, v);
+    while (max_digits > 0 && len > 0 && buf[len - 1] == '0')
+      len--;
+    if (len > 0 && buf[len - 1] == '.')
+      len--;
+    const char *p = buf;
+    if (len == 2 && buf[0] == '-' && buf[1] == '0')
+    {
+      p = "0";
+      len = 1;
+    }
+    else if (!leading_zero && len > 1 && buf[0] == '0' && buf[1] == '.')
+    {
+      p++;
+      len--;
+    }
+    else if (!leading_zero && len > 2 && buf[0] == '-' && buf[1] == '0' && buf[2] == '.')
+    {
+      buf[1] = '-';
+      p++;
+      len--;
+    }
+    s.append(p, len);
+  }
+
+  float2 to_uv(float2 p, const InstanceData &inst)
+  {
+    return to_float2(inst.uv_transform * float3(p.x, p.y, 1));
+  }
+
+  float2 uv_to_pixels(float2 uv, const InstanceData &inst)
+  {
+    return float2(inst.pos) + uv*float2(inst.size);
+  }
+
+  LineGeometry line_geometry(const Line *prim, const InstanceData &inst)
+  {
+    LineGeometry line;
+    line.width = prim->thickness_pixel > 0 ? prim->thickness_pixel :
+                                             prim->thickness*std::max(inst.size.x, inst.size.y);
+    line.p0 = uv_to_pixels(clamp(to_uv(prim->start, inst), float2(0,0), float2(1,1)), inst);
+    line.p1 = uv_to_pixels(clamp(to_uv(prim->end, inst), float2(0,0), float2(1,1)), inst);
+
+    // dash and gap lengths are whole pixels in the renderer, dots are as wide as the line
+    const int max_size = std::max(inst.size.x, inst.size.y);
+    const int gap = prim->style_pattern.y*max_size;
+    if (prim->style == LineStyle::Dashed)
+      line.dash = float2(int(prim->style_pattern.x*max_size), gap);
+    else if (prim->style == LineStyle::Dotted)
+    {
+      line.dash = float2(0, int(line.width) + gap);
+      line.dash_phase = line.dash.y - 0.5f*int(line.width);
+    }
+    return line;
+  }
+
+  void canvas_clip(const InstanceData &inst, int2 canvas_size, int2 &p0, int2 &p1)
+  {
+    p0 = max(inst.clip_min, int2(0, 0));
+    p1 = max(min(inst.clip_max, canvas_size), p0);
+  }
+
+  // FNV-1a
+  static uint64_t hash_pixels(const std::vector<uint8_t> &data, int2 size)
+  {
+    uint64_t h = 14695981039346656037ull;
+    auto add = [&h](uint8_t b) { h = (h ^ b) * 1099511628211ull; };
+    for (int i = 0; i < 4; i++)
+    {
+      add((size.x >> (8 * i)) & 0xFF);
+      add((size.y >> (8 * i)) & 0xFF);
+    }
+    for (uint8_t b : data)
+      add(b);
+    return h;
+  }
+
+  // renders the visible part of image instance, alpha is dropped
+  static void render_embedded_image(const Instance &inst, int2 canvas_size, EmbeddedImage &out)
+  {
+    int2 p0 = max(max(inst.data.pos, inst.data.clip_min), int2(0, 0));
+    int2 p1 = min(min(inst.data.pos + inst.data.size, inst.data.clip_max), canvas_size);
+    out.pos = p0;
+    out.size = p1 - p0;
+    if (out.size.x <= 0 || out.size.y <= 0)
+      return;
+
+    Instance local_inst = inst;
+    local_inst.data.pos -= p0;
+    local_inst.data.clip_min = max(inst.data.clip_min, p0) - p0;
+    local_inst.data.clip_max = min(inst.data.clip_max, p1) - p0;
+    LiteImage::Image2D<float4> image(out.size.x, out.size.y);
+    Renderer renderer;
+    renderer.render_instance(local_inst, image);
+    out.rgb.resize(3 * size_t(out.size.x) * out.size.y);
+    const float4 *pixels = image.data();
+    for (size_t i = 0; i < size_t(out.size.x) * out.size.y; i++)
+    {
+      out.rgb[3 * i + 0] = tonemap_to_byte(pixels[i].x, 1.0f/2.2f);
+      out.rgb[3 * i + 1] = tonemap_to_byte(pixels[i].y, 1.0f/2.2f);
+      out.rgb[3 * i + 2] = tonemap_to_byte(pixels[i].z, 1.0f/2.2f);
+    }
+  }
+
+  void render_embedded_images(const std::vector<Instance> &instances, int2 canvas_size,
+                              std::vector<EmbeddedImage> &images)
+  {
+    std::vector<int> image_instances;
+    for (int i = 0; i < instances.size(); i++)
+      if (instances[i].prim->getType() == FigureType::PrimitiveImage)
+        image_instances.push_back(i);
+    images.clear();
+    images.resize(instances.size());
+    std::vector<uint64_t> hashes(instances.size(), 0);
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    parallel_for(image_instances.size(), threads, [&](int i)
+                 {
+                   int id = image_instances[i];
+                   render_embedded_image(instances[id], canvas_size, images[id]);
+                   hashes[id] = hash_pixels(images[id].rgb, images[id].size); });
+
+    // duplicates are compared byte by byte, so a hash collision can not merge different images
+    std::unordered_map<uint64_t, std::vector<int>> by_hash;
+    for (int i : image_instances)
+    {
+      EmbeddedImage &image = images[i];
+      if (image.rgb.empty())
+        continue;
+      std::vector<int> &same_hash = by_hash[hashes[i]];
+      for (int j : same_hash)
+        if (equal(images[j].size, image.size) && images[j].rgb == image.rgb)
+        {
+          image.source = j;
+          image.rgb = std::vector<uint8_t>();
+          break;
+        }
+      if (image.source < 0)
+      {
+        image.source = i;
+        same_hash.push_back(i);
+      }
+    }
+  }
+
+  static inline bool equal_color(float4 a, float4 b)
+  {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+  }
+
+  // start of glyph on the baseline, for glyph instance placed by its bounding box
+  static float2 glyph_origin(const Glyph *prim, const InstanceData &inst, const Font &font)
+  {
+    const TTFSimpleGlyph &glyph = font.glyphs[prim->glyph_id];
+    float sz = prim->font_size;
+    return float2(inst.pos.x - font.scale*glyph.xMin*sz, inst.pos.y + font.scale*glyph.yMax*sz);
+  }
+
+  int collect_text_run(const std::vector<Instance> &instances, int first, TextRun &run)
+  {
+    const Glyph *prim = dynamic_cast<const Glyph*>(instances[first].prim);
+    const Font &font = get_font(prim->font_name);
+    const float sz = prim->font_size;
+    const float2 origin = glyph_origin(prim, instances[first].data, font);
+    const uint16_t space = font.cmap.charGlyphs[' '];
+    const float space_width = font.glyphs[space].advance.advanceWidth*font.scale*sz;
+    run.prim = prim;
+    run.font = &font;
+    run.baseline = origin.y;
+    run.glyphs.clear();
+    run.glyphs.push_back({uint16_t(prim->glyph_id), prim->character, origin.x});
+
+    int end = first + 1;
+    for (; end < instances.size() && instances[end].prim->getType() == FigureType::Glyph; end++)
+    {
+      const Glyph *next = dynamic_cast<const Glyph*>(instances[end].prim);
+      if (next->font_name != prim->font_name || next->font_size != prim->font_size ||
+          !equal_color(next->color, prim->color) || !equal(instances[end].data.clip_min, instances[first].data.clip_min) ||
+          !equal(instances[end].data.clip_max, instances[first].data.clip_max))
+        break;
+      // glyph boxes are snapped to pixels, so baselines of one line differ by a couple of pixels,
+      // lines are much further apart
+      float2 next_origin = glyph_origin(next, instances[end].data, font);
+      const RunGlyph &last = run.glyphs.back();
+      float pen = last.x + font.glyphs[last.glyph].advance.advanceWidth*font.scale*sz;
+      if (std::abs(next_origin.y - origin.y) > 0.25f*sz || next_origin.x < last.x)
+        break;
+      // spaces are put back for text selection and search
+      if (next_origin.x - pen >= 0.5f*space_width)
+        run.glyphs.push_back({space, ' ', pen});
+      run.glyphs.push_back({uint16_t(next->glyph_id), next->character, next_origin.x});
+    }
+    return end;
+  }
+}
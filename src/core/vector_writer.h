@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "figure.h"
+#include "font.h"
+
+// parts of pdf and svg export, where instances are written as shapes, text and embedded images
+namespace LiteFigure
+{
+  // gamma-encoded color with linear opacity, as vector formats take it
+  float4 display_color(float4 color);
+  // one of the 14 fonts every pdf viewer has
+  bool is_default_font(const std::string &name);
+  // shortest decimal with at most max_digits after the point, "-0" is written as "0".
+  // Without leading zero 0.5 is written as .5
+  void append_number(std::string &s, float v, int max_digits, bool leading_zero = true);
+
+  // point of primitive in normalized coordinates to instance uv and to pixels, as the renderer places it
+  float2 to_uv(float2 p, const InstanceData &inst);
+  float2 uv_to_pixels(float2 uv, const InstanceData &inst);
+
+  // line instance as the renderer draws it, in pixels. dash is (dash length, gap), solid if
+  // the gap is 0, zero dash length is a dot drawn with round caps
+  struct LineGeometry
+  {
+    float2 p0, p1;
+    float width;
+    float2 dash = float2(0, 0);
+    float dash_phase = 0;
+  };
+  LineGeometry line_geometry(const Line *prim, const InstanceData &inst);
+
+  // part of the canvas the instance is clipped to, [p0, p1), empty if p0 == p1
+  void canvas_clip(const InstanceData &inst, int2 canvas_size, int2 &p0, int2 &p1);
+
+  // visible part of image instance (it can be cropped, rotated, etc.) rendered to RGB8
+  struct EmbeddedImage
+  {
+    int2 pos, size;
+    std::vector<uint8_t> rgb; // kept only by the first of identical images
+    int source = -1;          // instance that keeps the pixels, -1 if nothing is visible
+  };
+  // renders all image instances in parallel, images[i] is for instance i. Identical images
+  // are found by hash and compared byte by byte, their source is the first of them
+  void render_embedded_images(const std::vector<Instance> &instances, int2 canvas_size,
+                              std::vector<EmbeddedImage> &images);
+
+  struct RunGlyph
+  {
+    uint16_t glyph; // index in font.glyphs
+    char character;
+    float x;        // start of the glyph on the baseline
+  };
+  // glyph instances of one line with the same font, size, color and clip, in pixels
+  struct TextRun
+  {
+    const Glyph *prim = nullptr; // first glyph, font and color of the run are its
+    const Font *font = nullptr;
+    float baseline = 0;
+    std::vector<RunGlyph> glyphs; // spaces, which are not instances, are put back
+  };
+  // collects the run that starts with instances[first], returns index of the first instance after it
+  int collect_text_run(const std::vector<Instance> &instances, int first, TextRun &run);
+}
@@ -0,0 +1,256 @@
+#include "csv_tests.h"
+#include "figure.h"
+#include "csv/csv.h"
+
+#include <filesystem>
+#include <fstream>
+#include <cmath>
+
+namespace LiteFigure
+{
+  static const std::string csv_tests_dir = "saves/csv_tests";
+
+  static void write_text(const std::string &filename, const std::string &text, bool append = false)
+  {
+    std::ofstream fs(filename, append ? std::ios::binary | std::ios::app : std::ios::binary);
+    fs << text;
+  }
+
+  // modification time has a coarse resolution on some file systems, a rewritten
+  // file is moved forward in time so that the cache always sees the change
+  static void touch_later(const std::string &filename)
+  {
+    std::filesystem::last_write_time(filename, std::filesystem::last_write_time(filename) + std::chrono::seconds(1));
+  }
+
+  static std::string test_cache_hit()
+  {
+    std::string path = csv_tests_dir + "/cache.csv";
+    write_text(path, "name,x,y\na,1,10\nb,2,20\n");
+    csv::clear_csv_cache();
+
+    std::shared_ptr<const csv::Table> table = csv::load_csv_cached(path);
+    if (!table || table->row_count != 2)
+      return "table is not loaded";
+    if (csv::load_csv_cached(path) != table)
+      return "unchanged file is parsed again";
+
+    // slices with different filters share the table
+    Block filter_a, filter_b;
+    load_block_from_string("{ path:s = \"" + path + "\" filter { column:s = \"name\" value:s = \"a\" } }", filter_a);
+    load_block_from_string("{ path:s = \"" + path + "\" filter { column:s = \"name\" value:s = \"a\" exclude:b = true } }", filter_b);
+    csv::Slice slice_a = csv::load_csv_slice(&filter_a);
+    csv::Slice slice_b = csv::load_csv_slice(&filter_b);
+    if (slice_a.data != table || slice_b.data != table)
+      return "slices do not share the cached table";
+    if (slice_a.getRowIndices() != std::vector<int>{0} || slice_b.getRowIndices() != std::vector<int>{1})
+      return "filtered rows are wrong";
+
+    // a file rewritten with the same size is loaded again
+    write_text(path, "name,x,y\na,1,10\nb,3,20\n");
+    touch_later(path);
+    std::shared_ptr<const csv::Table> rewritten = csv::load_csv_cached(path);
+    if (rewritten == table || !rewritten || (*rewritten)["x"][1] != "3" || (*table)["x"][1] != "2")
+      return "rewritten file is not reloaded";
+
+    csv::clear_csv_cache();
+    if (csv::load_csv_cached(path) == rewritten)
+      return "cache is not cleared";
+    return "";
+  }
+
+  static std::string test_append()
+  {
+    std::string path = csv_tests_dir + "/append.csv";
+    write_text(path, "name,x,y\na,1,10\nb,2,20\n");
+    csv::clear_csv_cache();
+
+    std::shared_ptr<const csv::Table> table = csv::load_csv_cached(path);
+    uint32_t code_a = table->coded(0).codes[0];
+    write_text(path, "a,3,30\nc,4,40\n", true);
+    std::shared_ptr<const csv::Table> appended = csv::load_csv_cached(path);
+    if (!appended || appended->row_count != 4)
+      return "appended rows are not loaded";
+    if (appended->value(0, 0) != "a" || appended->value(0, 2) != "a" || appended->value(0, 3) != "c" ||
+        appended->encoded[2].numbers()[3] != 40.0)
+      return "appended rows have wrong values";
+    if (appended->coded(0).codes[0] != code_a || appended->coded(0).codes[2] != code_a)
+      return "codes of existing values have changed";
+    // tables handed out before are not modified, the appended one continues their lineage
+    if (appended == table || table->row_count != 2 || table->columns[0].size() != 2 || appended->lineage != table->lineage)
+      return "appended rows have changed the old table";
+
+    // a slice from the first new row holds only appended rows
+    csv::Slice tail(appended, 2);
+    if (tail.getRowIndices() != std::vector<int>{2, 3})
+      return "slice of appended rows is wrong";
+
+    // line without newline at the end is parsed, but nothing can be appended to it
+    write_text(path, "d,5,50", true);
+    appended = csv::load_csv_cached(path);
+    write_text(path, "\ne,6,60\n", true);
+    appended = csv::load_csv_cached(path);
+    if (!appended || appended->row_count != 6 || appended->value(0, 4) != "d" || appended->value(0, 5) != "e")
+      return "rows after incomplete line are wrong";
+
+    // a file rewritten with more bytes is parsed from the start, not from the old size
+    std::shared_ptr<const csv::Table> before_rewrite = appended;
+    write_text(path, "name,x,y\na,9,10\nb,2,20\na,3,30\nc,4,40\nd,5,50\ne,6,60\nf,7,70\n");
+    touch_later(path);
+    appended = csv::load_csv_cached(path);
+    if (!appended || appended->row_count != 7 || appended->value(1, 0) != "9" || appended->value(0, 6) != "f" ||
+        appended->lineage == before_rewrite->lineage || before_rewrite->value(1, 0) != "1")
+      return "file rewritten with more bytes is not reloaded";
+    return "";
+  }
+
+  static bool same_images(const LiteImage::Image2D<float4> &a, const LiteImage::Image2D<float4> &b)
+  {
+    if (a.width() != b.width() || a.height() != b.height())
+      return false;
+    for (int i = 0; i < a.vector().size(); i++)
+      if (LiteMath::length(a.vector()[i] - b.vector()[i]) > 1e-6f)
+        return false;
+    return true;
+  }
+
+  static std::string test_line_plot_update()
+  {
+    std::string path = csv_tests_dir + "/plot.csv";
+    write_text(path, "name,x,y\na,1,10\nb,1,15\na,2,20\nb,2,5\n");
+    csv::clear_csv_cache();
+
+    Block blk;
+    load_block_from_string("{ type:e_FigureType = LinePlot size:i2 = 320, 240\n"
+                           "  graphs { data { path:s = \"" + path + "\" } group_by:s = \"name\" names:s = \"name\"\n"
+                           "           x_values:s = \"x\" y_values:s = \"y\" } }", blk);
+    FigurePtr fig = create_figure_from_blk(&blk);
+    render_figure_to_image(fig);
+    if (fig->update())
+      return "figure without new data is updated";
+
+    // points inside of the value range, then points that extend it, then a new graph
+    const char *appends[] = {"a,1.5,12\nb,1.5,8\n", "a,3,25\nb,3,2\n", "c,1,1\nc,3,30\n"};
+    for (const char *rows : appends)
+    {
+      write_text(path, rows, true);
+      if (!fig->update())
+        return std::string("figure is not updated after rows ") + rows;
+      LiteImage::Image2D<float4> updated = render_figure_to_image(fig);
+      LiteImage::Image2D<float4> loaded = render_figure_to_image(create_figure_from_blk(&blk));
+      if (!same_images(updated, loaded))
+        return std::string("updated figure differs from the loaded one after rows ") + rows;
+    }
+    return "";
+  }
+
+  static std::string test_columnar_equivalence()
+  {
+    std::string csv_path = "images/render.csv";
+    std::string lfc_path = csv_tests_dir + "/render.lfc";
+    std::shared_ptr<csv::Table> text_table = csv::load_csv(csv_path);
+    if (!csv::save_columnar(lfc_path, *text_table))
+      return "columnar file is not written";
+    std::shared_ptr<csv::Table> columnar_table = csv::load_columnar(lfc_path);
+    if (!columnar_table || columnar_table->header != text_table->header || columnar_table->row_count != text_table->row_count)
+      return "columnar table has different columns or rows";
+
+    const csv::Table &a = *text_table, &b = *columnar_table;
+    for (int col = 0; col < a.header.size(); col++)
+      for (int row = 0; row < a.row_count; row++)
+      {
+        double x = a.encoded[col].numbers()[row], y = b.encoded[col].numbers()[row];
+        if (!(x == y || (std::isnan(x) && std::isnan(y))))
+          return "value of " + a.header[col] + " in row " + std::to_string(row) + " differs";
+        if (a.value(col, row) != b.value(col, row))
+          return "text of " + a.header[col] + " in row " + std::to_string(row) + " differs";
+      }
+
+    // the same filters select the same rows
+    std::vector<std::string> filters = {
+        "filter { column:s = \"model_name\" value:s = \"drago\" }",
+        "filter { column:s = \"type\" value:s = \"MESH\" exclude:b = true }",
+        "filter { column:s = \"model_name\" regex:s = \"b.*\" }",
+        "filter { column:s = \"model_size(Mb)\" range:p2 = 10, 100 }",
+        "filter { column:s = \"time(ms)\" range:p2 = 3, 4 exclude:b = true }",
+        "filter { column:s = \"psnr_average\" value:s = \"0.0\" }"};
+    csv::clear_csv_cache();
+    for (const std::string &filter : filters)
+    {
+      Block text_blk, columnar_blk;
+      load_block_from_string("{ path:s = \"" + csv_path + "\" " + filter + " }", text_blk);
+      load_block_from_string("{ path:s = \"" + lfc_path + "\" " + filter + " }", columnar_blk);
+      std::vector<int> text_rows = csv::load_csv_slice(&text_blk).getRowIndices();
+      if (text_rows.empty() || text_rows.size() == a.row_count)
+        return "filter " + filter + " does not filter";
+      if (text_rows != csv::load_csv_slice(&columnar_blk).getRowIndices())
+        return "filter " + filter + " selects different rows";
+    }
+    return "";
+  }
+
+  static std::string test_columnar_number_text()
+  {
+    std::string csv_path = csv_tests_dir + "/numbers.csv";
+    std::string lfc_path = csv_tests_dir + "/numbers.lfc";
+    write_text(csv_path, "name,value,count\na,1.50,1\nb,1.5,2.5\nc,2,3\n");
+    std::shared_ptr<csv::Table> text_table = csv::load_csv(csv_path);
+    if (!csv::save_columnar(lfc_path, *text_table))
+      return "columnar file is not written";
+    std::shared_ptr<csv::Table> columnar_table = csv::load_columnar(lfc_path);
+    if (!columnar_table || columnar_table->row_count != 3)
+      return "columnar table is not loaded";
+
+    // "1.50" is not printed back from a number, its column keeps text. Other numbers are stored as numbers
+    const csv::Table &b = *columnar_table;
+    if (b.value(1, 0) != "1.50" || b.value(1, 1) != "1.5" || b.encoded[1].numbers()[0] != 1.5)
+      return "text of numbers is changed";
+    if (!b.encoded[2].mapped_numbers || b.value(2, 1) != "2.5")
+      return "numeric column is not stored as numbers";
+
+    std::vector<std::pair<std::string, std::vector<int>>> filters = {
+        {"filter { column:s = \"value\" value:s = \"1.50\" }", {0}},
+        {"filter { column:s = \"value\" regex:s = \".*0\" }", {0}},
+        {"filter { column:s = \"value\" value:s = \"1.5\" }", {1}},
+        {"filter { column:s = \"count\" value:s = \"2.5\" }", {1}}};
+    csv::clear_csv_cache();
+    for (const auto &[filter, rows] : filters)
+    {
+      Block text_blk, columnar_blk;
+      load_block_from_string("{ path:s = \"" + csv_path + "\" " + filter + " }", text_blk);
+      load_block_from_string("{ path:s = \"" + lfc_path + "\" " + filter + " }", columnar_blk);
+      if (csv::load_csv_slice(&text_blk).getRowIndices() != rows || csv::load_csv_slice(&columnar_blk).getRowIndices() != rows)
+        return "filter " + filter + " selects wrong rows";
+    }
+    return "";
+  }
+
+  int perform_csv_tests()
+  {
+    struct CsvTest
+    {
+      const char *name;
+      std::string (*run)();
+    };
+    const CsvTest tests[] = {
+        {"cache hit", test_cache_hit},
+        {"append", test_append},
+        {"line plot update", test_line_plot_update},
+        {"columnar equivalence", test_columnar_equivalence},
+        {"columnar number text", test_columnar_number_text}};
+
+    std::filesystem::create_directories(csv_tests_dir);
+    int failed_tests = 0;
+    for (const CsvTest &test : tests)
+    {
+      std::string message = test.run();
+      printf("[csv %s] %s\n", test.name, message.empty() ? "PASSED" : ("FAILED (" + message + ")").c_str());
+      failed_tests += !message.empty();
+    }
+    csv::clear_csv_cache();
+    std::filesystem::remove_all(csv_tests_dir);
+
+    printf("%d/%d csv tests failed\n", failed_tests, (int)(sizeof(tests) / sizeof(tests[0])));
+    return failed_tests;
+  }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace LiteFigure
+{
+  // tests of csv tables shared through the cache, appended rows and columnar files,
+  // files are written to a temporary directory in saves. Returns number of failed tests
+  int perform_csv_tests();
+}
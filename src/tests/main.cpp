@@ -1,12 +1,13 @@
 #include <cstdio>
 #include "regression.h"
+#include "csv_tests.h"
 
 
 int main(int argc, char *argv[]) 
 {
   if (argc == 1 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
   {
-    printf("Run all tests:             ./test run\n");
+    printf("Run all tests:             ./test run (csv tests run only with all tests)\n");
     printf("Run specific tests:        ./test run [test_number_1] [test_number_2] ... [test_number_n]\n");
     printf("Recreate reference images: ./test rebuild [test_number_1] [test_number_2] ... [test_number_n]\n");
   }
@@ -33,6 +34,8 @@ int main(int argc, char *argv[])
       test_numbers.push_back(std::stoi(argv[i]));
     }
     LiteFigure::perform_regression_tests(test_numbers, recreate_reference_images);
+    if (!recreate_reference_images && test_numbers.empty())
+      LiteFigure::perform_csv_tests();
   }
   return 0;
 }
\ No newline at end of file
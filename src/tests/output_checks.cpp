@@ -0,0 +1,587 @@
+#include "output_checks.h"
+#include "image_writer.h"
+#include "renderer.h"
+#include "ttf_reader.h"
+#include "stb_image.h"
+#include "tinyexr.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+namespace LiteFigure
+{
+  static std::string read_file(const std::string &filename)
+  {
+    std::ifstream fs(filename, std::ios::binary);
+    std::stringstream ss;
+    ss << fs.rdbuf();
+    return ss.str();
+  }
+
+  // checks count against the expected one from the block, if the block has it
+  static bool count_matches(const Block *blk, const std::string &name, int count, std::string &message)
+  {
+    if (blk->get_type(name) != Block::ValueType::INT || blk->get_int(name) == count)
+      return true;
+    message = name + " = " + std::to_string(count) + ", expected " + std::to_string(blk->get_int(name));
+    return false;
+  }
+
+  static std::string check_culling(FigurePtr fig, const Block *blk, const RenderSettings &settings,
+                                   const LiteImage::Image2D<float4> &image)
+  {
+    std::vector<Instance> instances = prepare_instances(fig);
+    std::vector<Instance> culled = instances;
+    CullStats stats = cull_instances(culled, fig->size);
+    std::string message;
+    if (!count_matches(blk, "total", stats.total, message) ||
+        !count_matches(blk, "off_canvas", stats.off_canvas, message) ||
+        !count_matches(blk, "occluded", stats.occluded, message) ||
+        !count_matches(blk, "clipped", stats.clipped, message))
+      return "culling: " + message;
+    if (culled.size() != stats.total - stats.off_canvas - stats.occluded)
+      return "culling: " + std::to_string(culled.size()) + " instances left of " + std::to_string(stats.total);
+
+    // removed instances are not visible, the figure looks the same with all of them rendered
+    Renderer renderer(settings);
+    InstanceBuffer buffer;
+    buffer.build(instances);
+    LiteImage::Image2D<float4> full(fig->size.x, fig->size.y);
+    renderer.render_instances(buffer, full);
+    int mismatches = 0;
+    for (int i = 0; i < full.vector().size(); i++)
+      mismatches += LiteMath::length(full.vector()[i] - image.vector()[i]) > 1e-6f;
+    if (mismatches > 0)
+      return "culling: " + std::to_string(mismatches) + " pixels differ from the render without culling";
+    return "";
+  }
+
+  // decodes QOI file to RGBA8, returns false if it is malformed
+  static bool decode_qoi(const std::string &data, int &width, int &height, std::vector<uint8_t> &rgba)
+  {
+    const uint8_t *bytes = (const uint8_t *)data.data();
+    if (data.size() < 22 || memcmp(bytes, "qoif", 4) != 0)
+      return false;
+    auto be32 = [&](int offset)
+    { return (uint32_t(bytes[offset]) << 24) | (bytes[offset + 1] << 16) | (bytes[offset + 2] << 8) | bytes[offset + 3]; };
+    width = be32(4);
+    height = be32(8);
+    const uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    if (memcmp(bytes + data.size() - 8, end_marker, 8) != 0)
+      return false;
+
+    rgba.resize(size_t(width) * height * 4);
+    uint8_t index[64][4] = {};
+    uint8_t px[4] = {0, 0, 0, 255};
+    size_t pos = 14, end = data.size() - 8;
+    int run = 0;
+    for (size_t i = 0; i < rgba.size(); i += 4)
+    {
+      if (run > 0)
+        run--;
+      else if (pos < end)
+      {
+        uint8_t b = bytes[pos++];
+        if (b == 0xFE)
+        {
+          memcpy(px, bytes + pos, 3);
+          pos += 3;
+        }
+        else if (b == 0xFF)
+        {
+          memcpy(px, bytes + pos, 4);
+          pos += 4;
+        }
+        else if ((b & 0xC0) == 0x00)
+          memcpy(px, index[b], 4);
+        else if ((b & 0xC0) == 0x40)
+        {
+          px[0] += ((b >> 4) & 3) - 2;
+          px[1] += ((b >> 2) & 3) - 2;
+          px[2] += (b & 3) - 2;
+        }
+        else if ((b & 0xC0) == 0x80)
+        {
+          int dg = (b & 0x3F) - 32;
+          uint8_t b2 = bytes[pos++];
+          px[0] += dg - 8 + ((b2 >> 4) & 0x0F);
+          px[1] += dg;
+          px[2] += dg - 8 + (b2 & 0x0F);
+        }
+        else
+          run = b & 0x3F;
+        memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+      }
+      else
+        return false;
+      memcpy(rgba.data() + i, px, 4);
+    }
+    return pos == end;
+  }
+
+  static bool save_with_encoder(const LiteImage::Image2D<float4> &image, const std::string &filename,
+                                const RenderSettings &settings)
+  {
+    std::string ext = filename.substr(filename.find_last_of(".") + 1);
+    std::unique_ptr<ImageEncoder> encoder = create_image_encoder(ext, settings);
+    if (!encoder || !encoder->open(filename, image.width(), image.height()))
+      return false;
+    write_image_rows(*encoder, image, 0, image.height());
+    return encoder->close();
+  }
+
+  static std::string check_formats(const Block *blk, const RenderSettings &settings,
+                                   const LiteImage::Image2D<float4> &image, const std::string &base)
+  {
+    for (const char *ext : {"png", "qoi", "jpg", "exr"})
+      if (!save_with_encoder(image, base + "." + ext, settings))
+        return std::string("formats: failed to write ") + ext;
+
+    int width = 0, height = 0, channels = 0;
+    uint8_t *png = stbi_load((base + ".png").c_str(), &width, &height, &channels, 4);
+    if (!png || width != image.width() || height != image.height())
+    {
+      stbi_image_free(png);
+      return "formats: png is not readable";
+    }
+    std::vector<uint8_t> expected(png, png + size_t(width) * height * 4);
+    stbi_image_free(png);
+
+    // QOI is lossless
+    int qoi_width = 0, qoi_height = 0;
+    std::vector<uint8_t> qoi;
+    if (!decode_qoi(read_file(base + ".qoi"), qoi_width, qoi_height, qoi) || qoi_width != width || qoi_height != height)
+      return "formats: qoi is malformed";
+    if (qoi != expected)
+      return "formats: qoi pixels differ from png";
+
+    // EXR keeps linear floats, they are tonemapped to the same bytes
+    float *exr = nullptr;
+    const char *err = nullptr;
+    int exr_width = 0, exr_height = 0;
+    if (LoadEXR(&exr, &exr_width, &exr_height, (base + ".exr").c_str(), &err) != TINYEXR_SUCCESS)
+    {
+      std::string message = std::string("formats: exr is not readable: ") + (err ? err : "");
+      FreeEXRErrorMessage(err);
+      return message;
+    }
+    int exr_mismatches = 0;
+    if (exr_width == width && exr_height == height)
+    {
+      for (size_t i = 0; i < expected.size(); i++)
+        exr_mismatches += i % 4 != 3 && tonemap_to_byte(exr[i], 1.0f / 2.2f) != expected[i];
+    }
+    free(exr);
+    if (exr_width != width || exr_height != height || exr_mismatches > 0)
+      return "formats: exr differs from png in " + std::to_string(exr_mismatches) + " values";
+
+    // JPEG is lossy, it is compared by PSNR of RGB bytes
+    uint8_t *jpg = stbi_load((base + ".jpg").c_str(), &width, &height, &channels, 4);
+    if (!jpg || width != image.width() || height != image.height())
+    {
+      stbi_image_free(jpg);
+      return "formats: jpg is not readable";
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < expected.size(); i++)
+      if (i % 4 != 3)
+        sum += (double(jpg[i]) - expected[i]) * (double(jpg[i]) - expected[i]);
+    stbi_image_free(jpg);
+    double mse = sum / (3.0 * width * height);
+    double psnr = 10 * log10(255.0 * 255.0 / std::max(1e-10, mse));
+    if (psnr < blk->get_double("jpeg_psnr", 30.0))
+      return "formats: jpg PSNR = " + std::to_string(psnr);
+    return "";
+  }
+
+  static std::string check_dzi(FigurePtr fig, const Block *blk, const RenderSettings &settings, const std::string &base)
+  {
+    namespace fs = std::filesystem;
+    if (!save_figure_to_dzi(fig, base + ".dzi", settings))
+      return "dzi: export failed";
+
+    std::string descriptor = read_file(base + ".dzi");
+    int tile_size = 0, overlap = -1, width = 0, height = 0;
+    auto attribute = [&](const std::string &name)
+    {
+      size_t pos = descriptor.find(" " + name + "=\"");
+      return pos == std::string::npos ? -1 : atoi(descriptor.c_str() + pos + name.size() + 3);
+    };
+    tile_size = attribute("TileSize");
+    overlap = attribute("Overlap");
+    width = attribute("Width");
+    height = attribute("Height");
+    if (tile_size <= 0 || overlap != 0 || width != fig->size.x || height != fig->size.y)
+      return "dzi: descriptor " + std::to_string(width) + "x" + std::to_string(height) + ", tile size " +
+             std::to_string(tile_size) + ", overlap " + std::to_string(overlap);
+
+    // level l is the image downscaled 2^(max_level-l) times, rounding up, level 0 is 1x1
+    int max_level = 0;
+    while ((1 << max_level) < std::max(width, height))
+      max_level++;
+    std::string message;
+    if (!count_matches(blk, "levels", max_level + 1, message))
+      return "dzi: " + message;
+
+    int tiles = 0;
+    std::set<int> levels;
+    for (const fs::directory_entry &level_dir : fs::directory_iterator(base + "_files"))
+    {
+      int level = atoi(level_dir.path().filename().string().c_str());
+      if (level < 0 || level > max_level)
+        return "dzi: unexpected level " + level_dir.path().filename().string();
+      levels.insert(level);
+      int level_width = (width + (1 << (max_level - level)) - 1) >> (max_level - level);
+      int level_height = (height + (1 << (max_level - level)) - 1) >> (max_level - level);
+      for (const fs::directory_entry &tile : fs::directory_iterator(level_dir.path()))
+      {
+        int col = -1, row = -1;
+        sscanf(tile.path().stem().string().c_str(), "%d_%d", &col, &row);
+        int tile_width = std::min(tile_size, level_width - col * tile_size);
+        int tile_height = std::min(tile_size, level_height - row * tile_size);
+        int file_width = 0, file_height = 0, channels = 0;
+        if (col < 0 || row < 0 || tile_width <= 0 || tile_height <= 0 ||
+            !stbi_info(tile.path().string().c_str(), &file_width, &file_height, &channels) ||
+            file_width != tile_width || file_height != tile_height)
+          return "dzi: tile " + tile.path().string() + " is " + std::to_string(file_width) + "x" +
+                 std::to_string(file_height) + ", expected " + std::to_string(tile_width) + "x" + std::to_string(tile_height);
+        tiles++;
+      }
+    }
+    if (levels.size() != max_level + 1)
+      return "dzi: " + std::to_string(levels.size()) + " levels have tiles of " + std::to_string(max_level + 1);
+    if (!count_matches(blk, "tiles", tiles, message))
+      return "dzi: " + message;
+    return "";
+  }
+
+  static bool inflate_stream(const std::string &in, std::string &out)
+  {
+    int length = 0;
+    char *decoded = stbi_zlib_decode_malloc(in.data(), in.size(), &length);
+    if (!decoded)
+      return false;
+    out.assign(decoded, length);
+    free(decoded);
+    return true;
+  }
+
+  struct PdfObject
+  {
+    std::string dict;
+    std::string stream; // decoded
+    bool has_stream = false;
+  };
+
+  // integer after key in dict, -1 if there is no such key. References ("key N 0 R" or "key [N 0 R]")
+  // give their object number
+  static int pdf_int(const std::string &dict, const std::string &key)
+  {
+    size_t pos = dict.find(key + " ");
+    if (pos == std::string::npos)
+      return -1;
+    pos += key.size() + 1;
+    if (dict[pos] == '[')
+      pos++;
+    return isdigit((unsigned char)dict[pos]) ? atoi(dict.c_str() + pos) : -1;
+  }
+
+  // splits content stream into tokens, strings, arrays brackets and dictionaries are tokens of their own
+  static std::vector<std::string> pdf_tokens(const std::string &content)
+  {
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < content.size())
+    {
+      char c = content[i];
+      if (isspace((unsigned char)c))
+        i++;
+      else if (c == '(')
+      {
+        size_t start = i++;
+        for (int depth = 1; i < content.size() && depth > 0; i++)
+        {
+          if (content[i] == '\\')
+            i++;
+          else
+            depth += content[i] == '(' ? 1 : content[i] == ')' ? -1 : 0;
+        }
+        tokens.push_back(content.substr(start, i - start));
+      }
+      else if (c == '<' && i + 1 < content.size() && content[i + 1] != '<')
+      {
+        size_t end = content.find('>', i);
+        end = end == std::string::npos ? content.size() : end + 1;
+        tokens.push_back(content.substr(i, end - i));
+        i = end;
+      }
+      else if (c == '[' || c == ']')
+        tokens.push_back(std::string(1, content[i++]));
+      else
+      {
+        size_t start = i++;
+        while (i < content.size() && !isspace((unsigned char)content[i]) && !strchr("()<>[]/", content[i]))
+          i++;
+        tokens.push_back(content.substr(start, i - start));
+      }
+    }
+    return tokens;
+  }
+
+  static std::string check_pdf(FigurePtr fig, const Block *blk, const std::string &base)
+  {
+    save_figure_to_pdf(fig, base + ".pdf");
+    std::string data = read_file(base + ".pdf");
+    if (data.compare(0, 5, "%PDF-") != 0)
+      return "pdf: no header";
+
+    // cross-reference table: every object has to start exactly at its offset
+    size_t startxref = data.rfind("startxref");
+    if (startxref == std::string::npos)
+      return "pdf: no startxref";
+    size_t xref = atoll(data.c_str() + startxref + 9);
+    int first = 0, count = 0, header_size = 0;
+    if (xref >= data.size() || sscanf(data.c_str() + xref, "xref %d %d%n", &first, &count, &header_size) != 2 || first != 0)
+      return "pdf: startxref does not point to xref table";
+    size_t entries = data.find_first_not_of(" \r\n", xref + header_size);
+    std::map<int, PdfObject> objects;
+    for (int id = 1; id < count; id++)
+    {
+      const char *entry = data.c_str() + entries + 20 * id;
+      if (entries + 20 * (id + 1) > data.size() || entry[17] != 'n')
+        return "pdf: object " + std::to_string(id) + " has no xref entry";
+      size_t offset = atoll(entry);
+      std::string object_header = std::to_string(id) + " 0 obj";
+      if (data.compare(offset, object_header.size(), object_header) != 0)
+        return "pdf: xref offset of object " + std::to_string(id) + " is wrong";
+
+      // the dictionary ends where the stream or the object ends, stream length has to be exact
+      size_t end = data.find("endobj", offset);
+      size_t stream = data.find("stream", offset);
+      PdfObject &object = objects[id];
+      object.has_stream = stream < end && data.compare(stream - 3, 3, "end") != 0;
+      object.dict = data.substr(offset, (object.has_stream ? stream : end) - offset);
+      if (!object.has_stream)
+        continue;
+      int length = pdf_int(object.dict, "/Length");
+      size_t begin = stream + 6 + (data[stream + 6] == '\r') + 1;
+      size_t stream_end = begin + length;
+      if (length < 0 || stream_end > end || data.compare(stream_end, 10, "\nendstream") != 0)
+        return "pdf: /Length of object " + std::to_string(id) + " does not end at endstream";
+      object.stream = data.substr(begin, length);
+      if (object.dict.find("/FlateDecode") != std::string::npos)
+      {
+        std::string decoded;
+        if (!inflate_stream(object.stream, decoded))
+          return "pdf: stream of object " + std::to_string(id) + " is not valid zlib";
+        object.stream = decoded;
+      }
+    }
+
+    // single page, its content stream and resources
+    int page = 0;
+    for (auto &[id, object] : objects)
+      if (object.dict.find("/Type /Page ") != std::string::npos)
+        page = id;
+    int contents = page ? pdf_int(objects[page].dict, "/Contents") : -1;
+    if (!objects.count(contents) || !objects[contents].has_stream)
+      return "pdf: page has no content stream";
+
+    int images = 0, fonts = 0;
+    std::map<int, int> font_glyphs; // Type0 font object to glyph count of its embedded subset
+    for (auto &[id, object] : objects)
+    {
+      images += object.dict.find("/Subtype /Image") != std::string::npos;
+      if (object.dict.find("/Subtype /Type0") == std::string::npos)
+        continue;
+      int descendant = pdf_int(object.dict, "/DescendantFonts");
+      int descriptor = objects.count(descendant) ? pdf_int(objects[descendant].dict, "/FontDescriptor") : -1;
+      int file = objects.count(descriptor) ? pdf_int(objects[descriptor].dict, "/FontFile2") : -1;
+      if (!objects.count(file) || !objects[file].has_stream)
+        return "pdf: font " + std::to_string(id) + " has no embedded font file";
+      if (objects[file].stream.size() != pdf_int(objects[file].dict, "/Length1"))
+        return "pdf: font file " + std::to_string(file) + " size differs from /Length1";
+      std::string font_path = base + "_font_" + std::to_string(fonts++) + ".ttf";
+      std::ofstream(font_path, std::ios::binary) << objects[file].stream;
+      Font font = read_ttf(font_path);
+      if (font.glyphs.empty())
+        return "pdf: font file " + std::to_string(file) + " has no glyphs";
+      font_glyphs[id] = font.glyphs.size();
+    }
+
+    // glyphs of embedded fonts are addressed by index in subset, it has to be there
+    std::map<std::string, int> font_resources;
+    const std::string &page_dict = objects[page].dict;
+    for (size_t pos = page_dict.find("/F"); pos != std::string::npos; pos = page_dict.find("/F", pos + 1))
+    {
+      int ref = 0, name_length = 0;
+      char name[32];
+      if (sscanf(page_dict.c_str() + pos, "/%31s %d 0 R%n", name, &ref, &name_length) == 2 && name_length > 0)
+        font_resources[name] = ref;
+    }
+    if (blk->get_bool("compressed_content") && objects[contents].dict.find("/FlateDecode") == std::string::npos)
+      return "pdf: content stream is not compressed";
+    int image_draws = 0, paints = 0, current_font = -1;
+    std::vector<std::string> tokens = pdf_tokens(objects[contents].stream);
+    for (int i = 0; i < tokens.size(); i++)
+    {
+      const std::string &token = tokens[i];
+      image_draws += token == "Do";
+      paints += token == "S" || token == "s" || token == "f" || token == "f*" || token == "F" ||
+                token == "B" || token == "B*" || token == "b" || token == "b*";
+      if (token == "Tf" && i >= 2 && tokens[i - 2][0] == '/')
+        current_font = font_resources.count(tokens[i - 2].substr(1)) ? font_resources[tokens[i - 2].substr(1)] : -1;
+      if (token[0] == '<' && font_glyphs.count(current_font))
+        for (size_t j = 1; j + 4 < token.size(); j += 4)
+          if (std::stoi(token.substr(j, 4), nullptr, 16) >= font_glyphs[current_font])
+            return "pdf: glyph " + token.substr(j, 4) + " is not in font subset";
+    }
+
+    std::string message;
+    if (!count_matches(blk, "objects", count - 1, message) ||
+        !count_matches(blk, "images", images, message) ||
+        !count_matches(blk, "image_draws", image_draws, message) ||
+        !count_matches(blk, "fonts", fonts, message) ||
+        !count_matches(blk, "paints", paints, message))
+      return "pdf: " + message;
+    return "";
+  }
+
+  static std::string check_svg(FigurePtr fig, const Block *blk, const std::string &base)
+  {
+    save_figure_to_svg(fig, base + ".svg");
+    std::string data = read_file(base + ".svg");
+
+    // xml parser just good enough to tell that the document is well-formed
+    std::vector<std::string> open_elements;
+    std::map<std::string, int> counts;
+    int elements = 0, roots = 0;
+    auto valid_text = [](const std::string &text)
+    {
+      for (size_t pos = text.find('&'); pos != std::string::npos; pos = text.find('&', pos + 1))
+      {
+        size_t end = text.find(';', pos);
+        std::string entity = end == std::string::npos ? "" : text.substr(pos + 1, end - pos - 1);
+        if (entity != "amp" && entity != "lt" && entity != "gt" && entity != "quot" && entity != "apos" &&
+            (entity.size() < 2 || entity[0] != '#'))
+          return false;
+      }
+      return text.find('<') == std::string::npos;
+    };
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+      size_t tag = data.find('<', pos);
+      if (tag == std::string::npos)
+        tag = data.size();
+      std::string text = data.substr(pos, tag - pos);
+      if (!valid_text(text))
+        return "svg: invalid character data at " + std::to_string(pos);
+      if (open_elements.empty() && text.find_first_not_of(" \r\n\t") != std::string::npos)
+        return "svg: text outside of root element at " + std::to_string(pos);
+      if (tag == data.size())
+        break;
+
+      if (data.compare(tag, 4, "<!--") == 0 || data.compare(tag, 9, "<![CDATA[") == 0 || data.compare(tag, 2, "<?") == 0)
+      {
+        const char *terminator = data[tag + 1] == '?' ? "?>" : data[tag + 2] == '-' ? "-->" : "]]>";
+        size_t end = data.find(terminator, tag);
+        if (end == std::string::npos)
+          return "svg: unterminated markup at " + std::to_string(tag);
+        pos = end + strlen(terminator);
+        continue;
+      }
+      size_t end = tag + 1;
+      char quote = 0;
+      for (; end < data.size() && (quote || data[end] != '>'); end++)
+        if (data[end] == '"' || data[end] == '\'')
+          quote = quote == data[end] ? 0 : quote ? quote : data[end];
+      if (end == data.size())
+        return "svg: unterminated tag at " + std::to_string(tag);
+      std::string content = data.substr(tag + 1, end - tag - 1);
+      pos = end + 1;
+
+      if (content[0] == '/')
+      {
+        if (open_elements.empty() || open_elements.back() != content.substr(1))
+          return "svg: </" + content.substr(1) + "> does not close an open element";
+        open_elements.pop_back();
+        continue;
+      }
+      bool self_closing = content.back() == '/';
+      if (self_closing)
+        content.pop_back();
+      size_t name_end = content.find_first_of(" \r\n\t");
+      std::string name = content.substr(0, name_end);
+      if (name.empty() || !isalpha((unsigned char)name[0]))
+        return "svg: invalid element name at " + std::to_string(tag);
+
+      // attributes are name="value" with unique names
+      std::set<std::string> attributes;
+      size_t a = name_end;
+      while (a != std::string::npos && (a = content.find_first_not_of(" \r\n\t", a)) != std::string::npos)
+      {
+        size_t eq = content.find('=', a);
+        if (eq == std::string::npos || (content[eq + 1] != '"' && content[eq + 1] != '\''))
+          return "svg: malformed attribute in <" + name + ">";
+        size_t value_end = content.find(content[eq + 1], eq + 2);
+        if (!attributes.insert(content.substr(a, eq - a)).second || !valid_text(content.substr(eq + 2, value_end - eq - 2)))
+          return "svg: invalid attribute " + content.substr(a, eq - a) + " in <" + name + ">";
+        a = value_end + 1;
+      }
+
+      roots += open_elements.empty();
+      elements++;
+      counts[name]++;
+      if (!self_closing)
+        open_elements.push_back(name);
+    }
+    if (!open_elements.empty())
+      return "svg: <" + open_elements.back() + "> is not closed";
+    if (roots != 1 || data.compare(0, 4, "<svg") != 0)
+      return "svg: document has to have a single svg root";
+
+    std::string message;
+    if (!count_matches(blk, "elements", elements, message))
+      return "svg: " + message;
+    for (int i = 0; i < blk->size(); i++)
+      if (blk->get_name(i) != "elements" && !count_matches(blk, blk->get_name(i), counts[blk->get_name(i)], message))
+        return "svg: " + message;
+    return "";
+  }
+
+  std::string perform_output_checks(FigurePtr fig, const Block *checks, const RenderSettings &settings,
+                                    const LiteImage::Image2D<float4> &image, const std::string &dir,
+                                    const std::string &name)
+  {
+    std::string base = dir + "/" + name;
+    for (int i = 0; i < checks->size(); i++)
+    {
+      const Block *blk = checks->get_block(i);
+      const std::string check = checks->get_name(i);
+      std::string message;
+      if (!blk)
+        message = "check " + check + " is not a block";
+      else if (check == "culling")
+        message = check_culling(fig, blk, settings, image);
+      else if (check == "formats")
+        message = check_formats(blk, settings, image, base);
+      else if (check == "dzi")
+        message = check_dzi(fig, blk, settings, base);
+      else if (check == "pdf")
+        message = check_pdf(fig, blk, base);
+      else if (check == "svg")
+        message = check_svg(fig, blk, base);
+      else
+        message = "unknown check " + check;
+      if (!message.empty())
+        return message;
+    }
+    return "";
+  }
+}
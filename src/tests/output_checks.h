@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include "figure.h"
+
+namespace LiteFigure
+{
+  // structural checks of a test figure, every sub-block of checks is one check:
+  //   culling { total:i off_canvas:i occluded:i clipped:i }  - counters of cull_instances
+  //   formats { jpeg_psnr:r }                                 - qoi and exr decode to the pixels of png,
+  //                                                             jpeg is at least jpeg_psnr dB close to it
+  //   dzi { levels:i tiles:i }                                - descriptor, level count and tile sizes
+  //   pdf { objects:i images:i image_draws:i fonts:i paints:i compressed_content:b }
+  //                                                           - xref offsets, stream lengths, embedded fonts
+  //                                                             and counts of what the page holds
+  //   svg { elements:i <tag>:i ... }                          - well-formed xml and element counts
+  // Files are written to dir with names starting with name. Returns an empty string if all checks
+  // passed, otherwise the description of the first failed one
+  std::string perform_output_checks(FigurePtr fig, const Block *checks, const RenderSettings &settings,
+                                    const LiteImage::Image2D<float4> &image, const std::string &dir,
+                                    const std::string &name);
+}
@@ -1,5 +1,7 @@
 #include "regression.h"
 #include "figure.h"
+#include "image_writer.h"
+#include "output_checks.h"
 
 #include "LiteMath/LiteMath.h"
 #include "LiteMath/Image2d.h"
@@ -31,6 +33,26 @@ namespace LiteFigure
     return -10 * log10(std::max<double>(1e-10, mse));
   }
 
+  // writes scaled outputs of the test (output blocks of its blk) from the rendered image with the
+  // writer figures are saved with. They are always png, output k goes to paths[k]
+  static bool write_scaled_outputs(const LiteImage::Image2D<float4> &image, const RenderSettings &settings,
+                                   const std::string &main_path, const std::vector<std::string> &paths)
+  {
+    MultiResolutionWriter writer(create_image_encoder("png", settings));
+    for (int k = 0; k < settings.scaled_outputs.size(); k++)
+    {
+      ScaledOutput output = settings.scaled_outputs[k];
+      output.path = paths[k];
+      writer.add_output(output, create_image_encoder("png", settings));
+    }
+    if (!writer.open(main_path, image.width(), image.height()))
+      return false;
+    write_image_rows(writer, image, 0, image.height());
+    bool ok = writer.close();
+    std::filesystem::remove(main_path);
+    return ok;
+  }
+
   int perform_regression_tests(std::vector<int> test_numbers, bool recreate_reference_images)
   {
     constexpr int PSNR_THR = 50.0f; // no visual difference, perfect match with a few pixels difference
@@ -112,13 +134,23 @@ namespace LiteFigure
       const Block *blk = test_blks[test_i];
 
       FigurePtr fig = create_figure_from_blk(blk);
-      LiteImage::Image2D<float4> out = render_figure_to_image(fig);
+      RenderSettings settings = load_render_settings(blk);
+      LiteImage::Image2D<float4> out = render_figure_to_image(fig, settings);
 
-      delete blk;
+      // scaled output k is compared with reference image fNN_k.png
+      std::string ref_stem = ref_image_paths[test_i].substr(0, ref_image_paths[test_i].find_last_of("."));
+      std::vector<std::string> scaled_ref_paths, scaled_paths;
+      for (int k = 0; k < settings.scaled_outputs.size(); k++)
+      {
+        scaled_ref_paths.push_back(ref_stem + "_" + std::to_string(k) + ".png");
+        scaled_paths.push_back(failed_tests_dir + "/" + std::to_string(test_num) + "_" + std::to_string(k) + ".png");
+      }
 
       if (recreate_reference_images)
       {
         bool saved = LiteImage::SaveImage(ref_image_paths[test_i].c_str(), out);
+        if (!scaled_ref_paths.empty())
+          saved = write_scaled_outputs(out, settings, failed_tests_dir + "/full.png", scaled_ref_paths) && saved;
         result_msg = saved ? "Reference image recreated" : "Failed to save reference image!";
         failed_tests += !saved;
       }
@@ -139,8 +171,51 @@ namespace LiteFigure
           result_msg = "FAILED (PSNR = " + std::to_string(psnr) + ")";
           failed_tests++;
         }
+
+        // failed scaled outputs are left in failed tests directory
+        if (psnr >= PSNR_THR && !scaled_paths.empty())
+        {
+          bool written = write_scaled_outputs(out, settings, failed_tests_dir + "/full.png", scaled_paths);
+          bool outputs_passed = written;
+          for (int k = 0; k < scaled_paths.size() && written; k++)
+          {
+            LiteImage::Image2D<float4> scaled = LiteImage::LoadImage<float4>(scaled_paths[k].c_str());
+            LiteImage::Image2D<float4> scaled_ref = LiteImage::LoadImage<float4>(scaled_ref_paths[k].c_str());
+            float scaled_psnr = scaled.width() == scaled_ref.width() && scaled.height() == scaled_ref.height() ?
+                                PSNR(scaled, scaled_ref) : 0.0f;
+            if (scaled_psnr >= PSNR_THR)
+              std::filesystem::remove(scaled_paths[k]);
+            else
+            {
+              result_msg = "FAILED (output " + std::to_string(k) + " PSNR = " + std::to_string(scaled_psnr) + ")";
+              outputs_passed = false;
+            }
+          }
+          if (!written)
+            result_msg = "FAILED (scaled outputs are not written)";
+          failed_tests += !outputs_passed;
+        }
+
+        // files of failed checks are left in failed tests directory
+        const Block *checks = blk->get_block("checks");
+        if (psnr >= PSNR_THR && checks && result_msg == "PASSED")
+        {
+          std::string checks_dir = failed_tests_dir + "/" + std::to_string(test_num);
+          std::string name = std::filesystem::path(ref_image_paths[test_i]).stem().string();
+          std::filesystem::create_directories(checks_dir);
+          std::string check_msg = perform_output_checks(fig, checks, settings, out, checks_dir, name);
+          if (check_msg.empty())
+            std::filesystem::remove_all(checks_dir);
+          else
+          {
+            result_msg = "FAILED (" + check_msg + ")";
+            failed_tests++;
+          }
+        }
       }
 
+      delete blk;
+
       printf("[%02d] %s\n", test_num, result_msg.c_str());
     }
     